@@ -0,0 +1,81 @@
+#include "ADRC.h"
+
+#include <cmath>
+
+bool ADRC::configure(const Settings& s)
+{
+	if (!(s.b0 > 0) || !(s.bandwidth > 0) || !(s.observer > 0))
+		return false;
+
+	settings = s;
+	kp = s.bandwidth * s.bandwidth;
+	kd = 2 * s.bandwidth;
+	gains[0] = 3 * s.observer;
+	gains[1] = 3 * s.observer * s.observer;
+	gains[2] = s.observer * s.observer * s.observer;
+	return true;
+}
+
+void ADRC::reset(float speed, float lever)
+{
+	// at rest, f^ balances the lever
+	z[0] = speed;
+	z[1] = 0;
+	z[2] = -settings.b0 * lever;
+	out = lever;
+}
+
+int ADRC::substeps(float dt, float& h) const
+{
+	// after a long frame (pause, load) only its last hundred substeps are integrated
+	int steps = static_cast<int>(std::ceil(dt * settings.observer / 0.2f));
+	h = dt / steps;
+	if (steps > 100)
+	{
+		steps = 100;
+		h = 0.2f / settings.observer;
+	}
+	return steps;
+}
+
+float ADRC::control(float reference, float limMin, float limMax)
+{
+	float u = (kp * (reference - z[0]) - kd * z[1] - z[2]) / settings.b0;
+	out = u > limMax ? limMax : (u < limMin ? limMin : u);
+	return out;
+}
+
+float ADRC::update(float reference, float speed, float lever, float limMin, float limMax, float dt)
+{
+	if (dt > 0 && std::isfinite(speed) && std::isfinite(lever))
+	{
+		float h;
+		int steps = substeps(dt, h);
+		for (int i = 0; i < steps; ++i)
+		{
+			float e = speed - z[0];
+			z[0] += h * (z[1] + gains[0] * e);
+			z[1] += h * (z[2] + settings.b0 * lever + gains[1] * e);
+			z[2] += h * gains[2] * e;
+		}
+	}
+	return control(reference, limMin, limMax);
+}
+
+float ADRC::update(float reference, float speed, float rate, float lever, float limMin, float limMax, float dt)
+{
+	if (dt > 0 && std::isfinite(speed) && std::isfinite(rate) && std::isfinite(lever))
+	{
+		float h;
+		int steps = substeps(dt, h);
+		float observer = settings.observer;
+		for (int i = 0; i < steps; ++i)
+		{
+			float e = rate - z[1];
+			z[1] += h * (z[2] + settings.b0 * lever + 2 * observer * e);
+			z[2] += h * observer * observer * e;
+		}
+		z[0] = speed;
+	}
+	return control(reference, limMin, limMax);
+}
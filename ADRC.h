@@ -0,0 +1,72 @@
+#ifndef ADRC_CONTROLLER_H
+#define ADRC_CONTROLLER_H
+
+/*
+* Active disturbance rejection speed controller, an alternative to PID and
+* MPC. From the lever u to the speed v the aircraft is taken as
+*
+*   d2v/dt2 = b0 * u + f
+*
+* b0 [kts/s^2 per lever] being the only model knowledge, gain / spoolTau of
+* the MPC model; f lumps drag, spool dynamics, gusts, gear and flaps. An
+* extended state observer tracks v, dv/dt and f from the measured speed
+* and the levers applied, and the control law cancels f and places the
+* rest as a PD:
+*
+*   u = (kp * (r - v^) - kd * dv^/dt - f^) / b0
+*
+* With the bandwidth parameterisation the loop has a double pole at
+* -bandwidth (kp = bandwidth^2, kd = 2 bandwidth) and the observer a triple
+* pole at -observer. A disturbance shows up in f^ within a few 1/observer
+* seconds and is cancelled directly, instead of waiting for an integrator to
+* wind up to it. The observer runs on the levers applied, limited, so there
+* is nothing to wind up against the lever limits.
+*
+* The observer is integrated in substeps of at most 0.2 / observer seconds,
+* a handful per tick at the usual loop rates; nothing is allocated.
+*/
+class ADRC
+{
+public:
+	struct Settings
+	{
+		float b0 = 2.6f;			/* kts/s^2 per lever unit */
+		float bandwidth = 0.5f;		/* rad/s, closed loop */
+		float observer = 2;			/* rad/s, several times the bandwidth */
+	};
+
+	/* false if the settings are unusable */
+	bool configure(const Settings& s);
+	const Settings& configuration() const { return settings; }
+
+	/* engaging at 'speed' [kts] with 'lever' applied, steady: the first output is 'lever' */
+	void reset(float speed, float lever);
+
+	/* speed [kts] measured now, 'lever' the output applied over the last dt; returns the lever */
+	float update(float reference, float speed, float lever, float limMin, float limMax, float dt);
+	/*
+	* with the speed rate [kts/s] from an estimator: the observer runs on the
+	* rate instead of differentiating the speed (a reduced order observer of
+	* rate and disturbance, double pole at -observer) and the speed is taken
+	* as measured
+	*/
+	float update(float reference, float speed, float rate, float lever, float limMin, float limMax, float dt);
+
+	float output() const { return out; }
+	/* observed total disturbance, kts/s^2 */
+	float disturbance() const { return z[2]; }
+
+private:
+	Settings settings;
+	float kp = 0;
+	float kd = 0;
+	float gains[3] = {};	/* observer */
+	float z[3] = {};		/* speed, rate, total disturbance */
+	float out = 0;
+
+	/* substeps of the observer for dt */
+	int substeps(float dt, float& h) const;
+	float control(float reference, float limMin, float limMax);
+};
+
+#endif
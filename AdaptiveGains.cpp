@@ -0,0 +1,71 @@
+#include "AdaptiveGains.h"
+
+#include <cmath>
+
+bool AdaptiveGains::configure(const Settings& s)
+{
+	if (!(s.lambda > 0) || !(s.deadTime >= 0) || !(s.confidence > 0) || !(s.rate > 0) || !(s.range >= 1))
+		return false;
+	settings = s;
+	reset();
+	return true;
+}
+
+void AdaptiveGains::reset()
+{
+	for (float& f : factors)
+		f = 1;
+	trusted = false;
+}
+
+void AdaptiveGains::update(const PIDController& base, float gain, float gainSd, float damping, float spoolTau, float dt)
+{
+	if (!(dt > 0))
+		return;
+
+	float target[3] = { 1, 1, 1 };
+	trusted = gain > 0 && std::isfinite(gain) && std::isfinite(damping) && gainSd < settings.confidence * gain;
+	if (trusted)
+	{
+		float closedLoop = settings.lambda + settings.deadTime;
+		float Kc = 1.0f / (gain * closedLoop);
+		float Ti = 4 * closedLoop;
+		if (damping * Ti > 1)
+			Ti = 1.0f / damping;
+		float Td = spoolTau > 0 ? spoolTau : 0.0f;
+
+		const float gains[3] = { Kc * (1 + Td / Ti), Kc / Ti, Kc * Td };
+		const float current[3] = { base.Kp, base.Ki, base.Kd };
+		for (int i = 0; i < 3; ++i)
+		{
+			// a gain the ini leaves at 0 stays off
+			if (current[i] > 0)
+			{
+				target[i] = gains[i] / current[i];
+				if (target[i] > settings.range)
+					target[i] = settings.range;
+				else if (target[i] < 1.0f / settings.range)
+					target[i] = 1.0f / settings.range;
+			}
+		}
+	}
+
+	// relative rate limit: at most a factor of e^(rate dt) per update
+	float up = std::exp(settings.rate * dt);
+	for (int i = 0; i < 3; ++i)
+	{
+		float step = target[i] / factors[i];
+		if (step > up)
+			step = up;
+		else if (step * up < 1)
+			step = 1.0f / up;
+		factors[i] *= step;
+	}
+}
+
+void AdaptiveGains::apply(PIDController& block) const
+{
+	block.Kp *= factors[0];
+	block.Ki *= factors[1];
+	block.Kd *= factors[2];
+}
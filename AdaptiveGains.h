@@ -0,0 +1,68 @@
+#ifndef ADAPTIVE_GAINS_H
+#define ADAPTIVE_GAINS_H
+
+#include "PID.h"
+
+/*
+* PID gains retuned from the online plant estimate (PlantEstimator) by the
+* SIMC rule, Skogestad's IMC/lambda tuning for the speed model
+*
+*   v / u = gain / ((s + damping) (spoolTau s + 1)) e^(-deadTime s)
+*
+* taken as K = gain / damping, tau1 = 1 / damping, tau2 = spoolTau:
+*
+*   Kc = 1 / (gain (lambda + deadTime))
+*   Ti = min(1 / damping, 4 (lambda + deadTime))
+*   Td = spoolTau
+*
+* in parallel form Kp = Kc (1 + Td / Ti), Ki = Kc / Ti, Kd = Kc Td. Kc does
+* not depend on the damping, and the min() keeps Ti finite as the damping
+* goes to zero or below, so a poor damping estimate does little harm. lambda
+* is the closed loop time constant asked for.
+*
+* The result is kept as a factor on each of the gains the controller would
+* run otherwise (ini, flight phase block, schedule), so phases and the
+* schedule carry through. The factors are bounded to [1/range, range]: a
+* gain that is 0 in the ini stays 0. They move at most by 'rate' (relative,
+* per second) towards the target; when the relative standard deviation of
+* the estimated gain is above 'confidence' (or the gain is not positive)
+* the target is 1, i.e. they walk back to the ini gains.
+*/
+class AdaptiveGains
+{
+public:
+	struct Settings
+	{
+		float lambda = 1.5f;		/* s, closed loop time constant */
+		float deadTime = 0.5f;		/* s, delay of the loop the model has no term for */
+		float confidence = 0.1f;	/* relative standard deviation of the gain estimate above which the ini gains apply */
+		float rate = 0.02f;			/* relative gain change per second */
+		float range = 3;			/* gains stay within the ini gains divided and multiplied by this */
+	};
+
+	bool configure(const Settings& s);
+	const Settings& configuration() const { return settings; }
+
+	/* back to the ini gains */
+	void reset();
+
+	/*
+	* base: the gains that run without adaptation, in knots. gain [kts/s per
+	* lever], gainSd and damping [1/s] from the estimator, spoolTau [s] of its model
+	*/
+	void update(const PIDController& base, float gain, float gainSd, float damping, float spoolTau, float dt);
+
+	/* scales Kp, Ki and Kd of block by the current factors */
+	void apply(PIDController& block) const;
+
+	/* the estimate was trusted on the last update */
+	bool confident() const { return trusted; }
+	float factor(int gain) const { return factors[gain]; }
+
+private:
+	Settings settings;
+	float factors[3] = { 1, 1, 1 };	/* Kp, Ki, Kd */
+	bool trusted = false;
+};
+
+#endif
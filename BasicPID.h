@@ -0,0 +1,320 @@
+#ifndef BASIC_PID_H
+#define BASIC_PID_H
+
+#include <type_traits>
+
+#include "PID.h"
+
+/*
+* Compile-time specialised PID controller.
+*
+* Terms selects which parts of the controller exist at all: a term that is not
+* selected has neither gains, state nor branches in the generated code. The
+* arithmetic of the remaining terms is the same as PID::update, PID itself
+* dispatches into this template (see PID.cpp).
+*
+* The discretisation coefficients (0.5*Ki*T for the integrator, the two
+* Tustin factors of the differentiator) are kept precomputed and only
+* refreshed when Ki, Kd, tau or T change, so the update has no division.
+* With a non-zero time tolerance a new T within that relative band of the
+* one the coefficients were made for does not trigger a refresh either.
+*/
+namespace PIDTerms
+{
+	enum : unsigned
+	{
+		P = 1,
+		I = 2,
+		D = 4,
+
+		PI = P | I,
+		PD = P | D,
+		PID = P | I | D
+	};
+}
+
+template <typename Scalar>
+struct BasicPIDIntegral
+{
+	Scalar Ki;
+
+	/* Integrator limits */
+	Scalar limMinInt;
+	Scalar limMaxInt;
+
+	Scalar integrator;
+	Scalar prevError;			/* Required for integrator */
+};
+
+template <typename Scalar>
+struct BasicPIDDerivative
+{
+	Scalar Kd;
+
+	/* Derivative low-pass filter time constant */
+	Scalar tau;
+
+	Scalar differentiator;
+	Scalar prevMeasurement;		/* Required for differentiator */
+};
+
+template <int N>
+struct BasicPIDNoTerm
+{
+};
+
+template <unsigned Terms, typename Scalar>
+struct BasicPIDController
+	: std::conditional_t<(Terms & PIDTerms::I) != 0, BasicPIDIntegral<Scalar>, BasicPIDNoTerm<0>>
+	, std::conditional_t<(Terms & PIDTerms::D) != 0, BasicPIDDerivative<Scalar>, BasicPIDNoTerm<1>>
+{
+	Scalar Kp;
+
+	/* Output limits */
+	Scalar limMin;
+	Scalar limMax;
+
+	/* Sample time (in seconds) */
+	Scalar T;
+
+	/* Controller output */
+	Scalar out;
+};
+
+template <typename Scalar>
+struct BasicPIDIntegralCoefficients
+{
+	Scalar Ki;					/* gain the coefficient was computed from */
+
+	Scalar integral;			/* 0.5 * Ki * T */
+};
+
+template <typename Scalar>
+struct BasicPIDDerivativeCoefficients
+{
+	Scalar Kd;					/* gain and filter constant the coefficients */
+	Scalar tau;					/* were computed from */
+
+	Scalar derivative;			/* 2 * Kd / (2 * tau + T) */
+	Scalar derivativeDecay;		/* (2 * tau - T) / (2 * tau + T) */
+};
+
+template <unsigned Terms, typename Scalar>
+struct BasicPIDCoefficients
+	: std::conditional_t<(Terms & PIDTerms::I) != 0, BasicPIDIntegralCoefficients<Scalar>, BasicPIDNoTerm<0>>
+	, std::conditional_t<(Terms & PIDTerms::D) != 0, BasicPIDDerivativeCoefficients<Scalar>, BasicPIDNoTerm<1>>
+{
+	Scalar T;					/* sample time the coefficients were computed for */
+	bool valid;
+};
+
+template <unsigned Terms, typename Scalar = float>
+class BasicPID
+{
+	static_assert((Terms & PIDTerms::P) != 0, "every variant has a proportional term");
+	static_assert((Terms & ~PIDTerms::PID) == 0, "unknown PID term");
+	static_assert(std::is_floating_point<Scalar>::value, "Scalar must be float or double");
+
+public:
+	static constexpr bool hasIntegral = (Terms & PIDTerms::I) != 0;
+	static constexpr bool hasDerivative = (Terms & PIDTerms::D) != 0;
+
+	using Controller = BasicPIDController<Terms, Scalar>;
+	using Coefficients = BasicPIDCoefficients<Terms, Scalar>;
+
+	BasicPID() : pid{}, coef{} {}
+	explicit BasicPID(const Controller& ctrl) : pid(ctrl), coef{} {}
+	explicit BasicPID(const PIDController& ctrl) : pid{}, coef{} { updateConfig(ctrl); }
+
+	/* Returns the error like PID::update, the output is in data().out */
+	Scalar update(Scalar setpoint, Scalar measurement)
+	{
+		refresh(coef, pid, timeTolerance);
+		return step(pid, coef, setpoint, measurement);
+	}
+
+	void updateConfig(const PIDController& ctrl);
+	void reset();
+	Controller& data() { return pid; }
+	Scalar out() const { return pid.out; }
+	void setTime(Scalar t) { pid.T = t; }
+	void setLimits(Scalar lower, Scalar upper) { pid.limMax = upper, pid.limMin = lower; }
+	/* relative change of T tolerated before the coefficients are recomputed, 0 = any change */
+	void setTimeTolerance(Scalar relative) { timeTolerance = relative; }
+
+	/*
+	* Recompute k from c if the gains or tau changed or T left the tolerance
+	* band. Returns true if the coefficients were recomputed.
+	*/
+	template <class Ctrl, class Coef>
+	static bool refresh(Coef& k, const Ctrl& c, Scalar tolerance);
+
+	/*
+	* The update itself. Works on any controller/coefficient structs that have
+	* the members of the selected terms, which is how PID runs it on its
+	* PIDController.
+	*/
+	template <class Ctrl, class Coef>
+	static Scalar step(Ctrl& c, const Coef& k, Scalar setpoint, Scalar measurement);
+
+private:
+	Controller pid;
+	Coefficients coef;
+	Scalar timeTolerance = 0;
+};
+
+template <unsigned Terms, typename Scalar>
+template <class Ctrl, class Coef>
+inline bool BasicPID<Terms, Scalar>::refresh(Coef& k, const Ctrl& c, Scalar tolerance)
+{
+	if (k.valid)
+	{
+		Scalar dT = c.T - k.T;
+		if (dT < 0)
+			dT = -dT;
+
+		bool stale = dT > tolerance * k.T;
+		if constexpr (hasIntegral)
+			stale = stale || c.Ki != k.Ki;
+		if constexpr (hasDerivative)
+			stale = stale || c.Kd != k.Kd || c.tau != k.tau;
+
+		if (!stale)
+			return false;
+	}
+
+	k.T = c.T;
+
+	if constexpr (hasIntegral)
+	{
+		k.Ki = c.Ki;
+		k.integral = Scalar(0.5) * c.Ki * c.T;
+	}
+
+	if constexpr (hasDerivative)
+	{
+		k.Kd = c.Kd;
+		k.tau = c.tau;
+		k.derivative = Scalar(2) * c.Kd / (Scalar(2) * c.tau + c.T);
+		k.derivativeDecay = (Scalar(2) * c.tau - c.T) / (Scalar(2) * c.tau + c.T);
+	}
+
+	k.valid = true;
+	return true;
+}
+
+template <unsigned Terms, typename Scalar>
+template <class Ctrl, class Coef>
+inline Scalar BasicPID<Terms, Scalar>::step(Ctrl& c, const Coef& k, Scalar setpoint, Scalar measurement)
+{
+	/*
+	* Error signal
+	*/
+	Scalar error = setpoint - measurement;
+
+
+	/*
+	* Proportional
+	*/
+	Scalar out = c.Kp * error;
+
+
+	/*
+	* Integral
+	*/
+	if constexpr (hasIntegral)
+	{
+		c.integrator = c.integrator + k.integral * (error + c.prevError);
+
+		/* Anti-wind-up via integrator clamping */
+		if (c.integrator > c.limMaxInt)
+		{
+			c.integrator = c.limMaxInt;
+
+		} else if (c.integrator < c.limMinInt)
+		{
+			c.integrator = c.limMinInt;
+
+		}
+
+		out = out + c.integrator;
+		c.prevError = error;
+	}
+
+
+	/*
+	* Derivative (band-limited differentiator)
+	*/
+	if constexpr (hasDerivative)
+	{
+		c.differentiator = -(k.derivative * (measurement - c.prevMeasurement)	/* Note: derivative on measurement, therefore minus sign in front of equation! */
+							 + k.derivativeDecay * c.differentiator);
+
+		out = out + c.differentiator;
+		c.prevMeasurement = measurement;
+	}
+
+
+	/*
+	* Apply output limits
+	*/
+	if (out > c.limMax)
+	{
+		out = c.limMax;
+
+	} else if (out < c.limMin)
+	{
+		out = c.limMin;
+
+	}
+	c.out = out;
+
+	return error;
+}
+
+template <unsigned Terms, typename Scalar>
+void BasicPID<Terms, Scalar>::updateConfig(const PIDController& ctrl)
+{
+	pid.Kp = static_cast<Scalar>(ctrl.Kp);
+	pid.limMin = static_cast<Scalar>(ctrl.limMin);
+	pid.limMax = static_cast<Scalar>(ctrl.limMax);
+	pid.T = static_cast<Scalar>(ctrl.T);
+	pid.out = static_cast<Scalar>(ctrl.out);
+
+	if constexpr (hasIntegral)
+	{
+		pid.Ki = static_cast<Scalar>(ctrl.Ki);
+		pid.limMinInt = static_cast<Scalar>(ctrl.limMinInt);
+		pid.limMaxInt = static_cast<Scalar>(ctrl.limMaxInt);
+		pid.integrator = static_cast<Scalar>(ctrl.integrator);
+		pid.prevError = static_cast<Scalar>(ctrl.prevError);
+	}
+
+	if constexpr (hasDerivative)
+	{
+		pid.Kd = static_cast<Scalar>(ctrl.Kd);
+		pid.tau = static_cast<Scalar>(ctrl.tau);
+		pid.differentiator = static_cast<Scalar>(ctrl.differentiator);
+		pid.prevMeasurement = static_cast<Scalar>(ctrl.prevMeasurement);
+	}
+}
+
+template <unsigned Terms, typename Scalar>
+void BasicPID<Terms, Scalar>::reset()
+{
+	pid.out = 0;
+
+	if constexpr (hasIntegral)
+	{
+		pid.integrator = 0;
+		pid.prevError = 0;
+	}
+
+	if constexpr (hasDerivative)
+	{
+		pid.differentiator = 0;
+		pid.prevMeasurement = 0;
+	}
+}
+
+#endif
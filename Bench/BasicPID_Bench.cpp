@@ -0,0 +1,98 @@
+// BasicPID_Bench.cpp : cost of the compile-time PID variants against the PID class.
+//
+// Build:
+//   g++ -std=c++17 -O2 -ffp-contract=off -I.. BasicPID_Bench.cpp ../PID.cpp
+//   cl /std:c++17 /O2 /EHsc /I.. BasicPID_Bench.cpp ..\PID.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "PID.h"
+#include "BasicPID.h"
+
+#define CONTROLLERS 1024
+#define STEPS 4000
+#define FRAMES 16
+
+static std::vector<float> setpoints, measurements;
+
+static PIDController makeConfig(unsigned terms)
+{
+	PIDController ctrl{ 0 };
+
+	ctrl.Kp = 0.17f;
+	ctrl.Ki = (terms & PIDTerms::I) ? 0.1f : 0.0f;
+	ctrl.Kd = (terms & PIDTerms::D) ? 0.06f : 0.0f;
+	ctrl.tau = 0.008f;
+	ctrl.limMin = 0.05f;
+	ctrl.limMax = 0.765f;
+	ctrl.limMinInt = 0.05f;
+	ctrl.limMaxInt = 0.555f;
+	ctrl.T = 0.05f;
+	return ctrl;
+}
+
+static void makeInputs()
+{
+	setpoints.resize(FRAMES * CONTROLLERS);
+	measurements.resize(FRAMES * CONTROLLERS);
+	for (int frame = 0; frame < FRAMES; ++frame)
+	{
+		for (int i = 0; i < CONTROLLERS; ++i)
+		{
+			setpoints[frame * CONTROLLERS + i] = 180.0f;
+			measurements[frame * CONTROLLERS + i] = 170.0f + 0.5f * frame + 0.01f * (i % 37);
+		}
+	}
+}
+
+/* ns per update for CONTROLLERS independent instances of Ctrl */
+template <class Ctrl>
+static double run(unsigned terms, float& checksum)
+{
+	std::vector<Ctrl> ctrls(CONTROLLERS, Ctrl{ makeConfig(terms) });
+
+	auto start = std::chrono::steady_clock::now();
+	for (int step = 0; step < STEPS; ++step)
+	{
+		const float* sp = &setpoints[(step % FRAMES) * CONTROLLERS];
+		const float* m = &measurements[(step % FRAMES) * CONTROLLERS];
+		for (int i = 0; i < CONTROLLERS; ++i)
+			ctrls[i].update(sp[i], m[i]);
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	checksum = 0;
+	for (auto& c : ctrls)
+		checksum += static_cast<float>(c.data().out);
+
+	return std::chrono::duration<double, std::nano>(stop - start).count() / (double(CONTROLLERS) * STEPS);
+}
+
+template <unsigned Terms>
+static void compare(const char* name)
+{
+	float refSum = 0, fSum = 0, dSum = 0;
+	double ref = run<PID>(Terms, refSum);
+	double f = run<BasicPID<Terms, float>>(Terms, fSum);
+	double d = run<BasicPID<Terms, double>>(Terms, dSum);
+
+	printf("%-4s %9.2f %9.2f (%2zu B) %9.2f (%2zu B)   %s\n", name, ref, f, sizeof(BasicPIDController<Terms, float>),
+		d, sizeof(BasicPIDController<Terms, double>), refSum == fSum ? "same output" : "OUTPUT DIFFERS");
+}
+
+int main()
+{
+	makeInputs();
+
+	printf("%d controllers x %d steps, ns per update (state size)\n", CONTROLLERS, STEPS);
+	printf("%-4s %9s %16s %16s\n", "", "PID", "BasicPID<float>", "BasicPID<double>");
+	compare<PIDTerms::P>("P");
+	compare<PIDTerms::PI>("PI");
+	compare<PIDTerms::PD>("PD");
+	compare<PIDTerms::PID>("PID");
+	printf("PID state size: %zu B\n", sizeof(PIDController));
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Denormal_Bench.cpp : cost of a long steady-state run with and without denormal protection.
+//
+// The measurement steps once and then holds, so the differentiator decays and,
+// with tau much larger than T, stays in the subnormal range for good.
+//
+// Build (PID.c must be compiled as C):
+//   gcc -O2 -c -I.. ../PID.c -o PID_c.o
+//   g++ -std=c++17 -O2 -I.. Denormal_Bench.cpp ../PID.cpp PID_c.o
+//   cl /std:c++17 /O2 /EHsc /I.. Denormal_Bench.cpp ..\PID.cpp ..\PID.c
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "PID.h"
+
+#define CONTROLLERS 64
+#define STEPS 200000
+
+static PIDController makeConfig(int mode)
+{
+	PIDController ctrl{ 0 };
+
+	ctrl.Kp = 0.17f;
+	ctrl.Ki = 0.1f;
+	ctrl.Kd = 0.06f;
+	ctrl.tau = 0.5f;		/* decay factor (2tau - T) / (2tau + T) close to 1 */
+	ctrl.limMin = -1.0f;
+	ctrl.limMax = 1.0f;
+	ctrl.limMinInt = -0.5f;
+	ctrl.limMaxInt = 0.5f;
+	ctrl.T = 0.01f;
+	ctrl.denormalMode = mode;
+	return ctrl;
+}
+
+static bool isSubnormal(float x)
+{
+	return x != 0.0f && std::fabs(x) < FLT_MIN;
+}
+
+struct Result
+{
+	double ns;
+	int subnormalSteps;		/* steps of controller 0 with a subnormal differentiator */
+};
+
+static float differentiator(PID& p) { return p.data().differentiator; }
+static float differentiator(PIDController& c) { return c.differentiator; }
+
+template <class Ctrl, class Update>
+static Result run(std::vector<Ctrl>& ctrls, Update update)
+{
+	Result r{ 0, 0 };
+
+	auto start = std::chrono::steady_clock::now();
+	for (int step = 0; step < STEPS; ++step)
+	{
+		/* one step of the measurement, then cruise exactly on the setpoint */
+		float measurement = step < 1 ? 170.0f : 180.0f;
+		for (auto& c : ctrls)
+			update(c, 180.0f, measurement);
+
+		if (isSubnormal(differentiator(ctrls[0])))
+			++r.subnormalSteps;
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	r.ns = std::chrono::duration<double, std::nano>(stop - start).count() / (double(CONTROLLERS) * STEPS);
+	return r;
+}
+
+int main()
+{
+	const char* names[] = { "off", "flush", "ftz/daz" };
+
+	printf("%d controllers x %d steady-state steps, ns per update\n", CONTROLLERS, STEPS);
+	printf("%-8s %14s %14s\n", "mode", "PID", "PIDController");
+
+	for (int mode = PID_DENORMAL_OFF; mode <= PID_DENORMAL_FTZ_DAZ; ++mode)
+	{
+		std::vector<PID> pids(CONTROLLERS, PID{ makeConfig(mode) });
+		Result cpp = run(pids, [](PID& p, float sp, float m) { p.update(sp, m); });
+
+		std::vector<PIDController> ctrls(CONTROLLERS, makeConfig(mode));
+		Result c = run(ctrls, [](PIDController& pc, float sp, float m) { PIDController_Update(&pc, sp, m); });
+
+		printf("%-8s %8.2f (%6d) %8.2f (%6d)   (steps with subnormal state)\n",
+			names[mode], cpp.ns, cpp.subnormalSteps, c.ns, c.subnormalSteps);
+	}
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+// PIDBank_Bench.cpp : throughput of PIDBank kernels against an array of PID objects.
+//
+// Build (release, no FMA contraction so all paths agree bit-for-bit):
+//   g++ -O2 -ffp-contract=off -I.. PIDBank_Bench.cpp ../PIDBank.cpp ../PID.cpp
+//   cl /O2 /EHsc /I.. PIDBank_Bench.cpp ..\PIDBank.cpp ..\PID.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "PID.h"
+#include "PIDBank.h"
+
+#define CHANNELS 4099	/* deliberately not a multiple of 8 to exercise the tail */
+#define STEPS 2000
+#define FRAMES 16		/* precomputed input frames, cycled so input generation is not timed */
+
+static PIDController makeChannel(int ch)
+{
+	PIDController ctrl{ 0 };
+
+	/* spread the gains so every branch of the update is taken */
+	ctrl.Kp = 0.1f + 0.001f * (ch % 97);
+	ctrl.Ki = (ch % 5 == 0) ? 0.0f : 0.05f + 0.0005f * (ch % 89);
+	ctrl.Kd = (ch % 7 == 0) ? 0.0f : 0.01f + 0.002f * (ch % 83);
+	ctrl.tau = 0.005f + 0.0001f * (ch % 31);
+	ctrl.limMin = 0.05f;
+	ctrl.limMax = 0.9f;
+	ctrl.limMinInt = 0.05f;
+	ctrl.limMaxInt = 0.7f;
+	ctrl.T = 0.05f;
+	return ctrl;
+}
+
+/* deterministic airspeed-like measurements around the setpoint */
+static void makeInputs(std::vector<float>& sp, std::vector<float>& meas)
+{
+	for (int frame = 0; frame < FRAMES; ++frame)
+	{
+		for (int ch = 0; ch < CHANNELS; ++ch)
+		{
+			sp[frame * CHANNELS + ch] = 180.0f + (ch % 13);
+			meas[frame * CHANNELS + ch] = 160.0f + (ch % 13) + 1.3f * frame + 0.37f * ((frame * 31 + ch * 17) % 11);
+		}
+	}
+}
+
+int main()
+{
+	std::vector<float> sp(FRAMES * CHANNELS), meas(FRAMES * CHANNELS);
+	std::vector<PID> reference;
+	std::vector<float> refOut(CHANNELS);
+
+	makeInputs(sp, meas);
+
+	reference.reserve(CHANNELS);
+	for (int ch = 0; ch < CHANNELS; ++ch)
+		reference.emplace_back(makeChannel(ch));
+
+	/* reference run, also timed */
+	auto start = std::chrono::steady_clock::now();
+	for (int step = 0; step < STEPS; ++step)
+	{
+		const float* s = &sp[(step % FRAMES) * CHANNELS];
+		const float* m = &meas[(step % FRAMES) * CHANNELS];
+		for (int ch = 0; ch < CHANNELS; ++ch)
+			reference[ch].update(s[ch], m[ch]);
+	}
+	auto stop = std::chrono::steady_clock::now();
+	double refNs = std::chrono::duration<double, std::nano>(stop - start).count();
+
+	for (int ch = 0; ch < CHANNELS; ++ch)
+		refOut[ch] = reference[ch].data().out;
+
+	printf("channels: %d, steps: %d\n", CHANNELS, STEPS);
+	printf("%-8s %10.2f ns/channel-update\n", "PID", refNs / (double(CHANNELS) * STEPS));
+
+	int failures = 0;
+	const PIDBank::Kernel kernels[] = { PIDBank::Kernel::Scalar, PIDBank::Kernel::SSE, PIDBank::Kernel::AVX };
+	for (auto k : kernels)
+	{
+		if (!PIDBank::kernelSupported(k))
+		{
+			printf("%-8s not supported on this CPU\n", PIDBank::kernelName(k));
+			continue;
+		}
+
+		PIDBank bank{ CHANNELS, k };
+		for (int ch = 0; ch < CHANNELS; ++ch)
+			bank.setChannel(ch, makeChannel(ch));
+
+		start = std::chrono::steady_clock::now();
+		for (int step = 0; step < STEPS; ++step)
+		{
+			int frame = step % FRAMES;
+			bank.update(&sp[frame * CHANNELS], &meas[frame * CHANNELS]);
+		}
+		stop = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+		/* results must match PID::update bit-for-bit */
+		int mismatches = 0;
+		for (int ch = 0; ch < CHANNELS; ++ch)
+		{
+			PIDController a = reference[ch].data();
+			PIDController b = bank.channel(ch);
+			if (memcmp(&refOut[ch], &b.out, sizeof(float)) != 0
+				|| memcmp(&a.integrator, &b.integrator, sizeof(float)) != 0
+				|| memcmp(&a.differentiator, &b.differentiator, sizeof(float)) != 0)
+				++mismatches;
+		}
+		failures += mismatches;
+
+		printf("%-8s %10.2f ns/channel-update  speedup %5.2fx  mismatches: %d\n",
+			PIDBank::kernelName(k), ns / (double(CHANNELS) * STEPS), refNs / ns, mismatches);
+	}
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,278 @@
+#include "BinaryLog.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char BinaryLogMagic[8] = { 'A', 'T', 'L', 'O', 'G', '\r', '\n', '\x1a' };
+static const std::uint32_t BinaryLogChunkMagic = 0x4B4E4843;		/* "CHNK" */
+
+static std::uint32_t fnv1a(std::uint32_t hash, const void* data, std::size_t bytes)
+{
+	auto p = static_cast<const unsigned char*>(data);
+	for (std::size_t i = 0; i < bytes; ++i)
+		hash = (hash ^ p[i]) * 16777619u;
+	return hash;
+}
+
+static std::uint32_t chunkChecksum(std::uint32_t kind, std::uint32_t rows, const void* payload, std::size_t bytes)
+{
+	std::uint32_t hash = 2166136261u;
+	hash = fnv1a(hash, &kind, sizeof(kind));
+	hash = fnv1a(hash, &rows, sizeof(rows));
+	return fnv1a(hash, payload, bytes);
+}
+
+static std::size_t payloadBytes(std::uint32_t kind, std::uint32_t rows, std::uint32_t columns)
+{
+	if (BinaryLogChunkHeader::Samples == kind)
+		return static_cast<std::size_t>(rows) * columns * sizeof(float);
+	return sizeof(float);
+}
+
+BinaryLogFileHeader BinaryLog_MakeHeader(const std::string& airframe)
+{
+	BinaryLogFileHeader h;
+	std::memset(&h, 0, sizeof(h));
+
+	std::memcpy(h.magic, BinaryLogMagic, sizeof(h.magic));
+	h.version = BINARY_LOG_VERSION;
+	h.headerSize = sizeof(BinaryLogFileHeader);
+	h.columns = BINARY_LOG_COLUMNS;
+	h.chunkRows = BINARY_LOG_CHUNK_ROWS;
+	std::strncpy(h.airframe, airframe.c_str(), sizeof(h.airframe) - 1);
+
+	return h;
+}
+
+bool BinaryLogWriter::open(const std::string& path, const BinaryLogFileHeader& header)
+{
+	close();
+
+	file.clear();
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	columns.assign(static_cast<std::size_t>(BINARY_LOG_COLUMNS) * BINARY_LOG_CHUNK_ROWS, 0.0f);
+	rows = 0;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.flush();
+	return file.good();
+}
+
+void BinaryLogWriter::close()
+{
+	if (!file.is_open())
+		return;
+
+	flush();
+	file.close();
+}
+
+void BinaryLogWriter::writeChunk(std::uint32_t kind, std::uint32_t chunkRows, const float* payload, std::size_t count)
+{
+	BinaryLogChunkHeader h{ BinaryLogChunkMagic, kind, chunkRows, 0 };
+	h.checksum = chunkChecksum(kind, chunkRows, payload, count * sizeof(float));
+
+	file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	file.write(reinterpret_cast<const char*>(payload), count * sizeof(float));
+	file.flush();
+}
+
+void BinaryLogWriter::append(const float* row)
+{
+	for (int c = 0; c < BINARY_LOG_COLUMNS; ++c)
+		columns[static_cast<std::size_t>(c) * BINARY_LOG_CHUNK_ROWS + rows] = row[c];
+
+	if (++rows == BINARY_LOG_CHUNK_ROWS)
+		flush();
+}
+
+void BinaryLogWriter::run(float setpoint)
+{
+	flush();
+	writeChunk(BinaryLogChunkHeader::Run, 0, &setpoint, 1);
+}
+
+void BinaryLogWriter::flush()
+{
+	if (0 == rows)
+		return;
+
+	/* a short chunk is stored packed: column stride == rows */
+	if (rows < BINARY_LOG_CHUNK_ROWS)
+	{
+		for (int c = 1; c < BINARY_LOG_COLUMNS; ++c)
+			std::memmove(&columns[static_cast<std::size_t>(c) * rows], &columns[static_cast<std::size_t>(c) * BINARY_LOG_CHUNK_ROWS], rows * sizeof(float));
+	}
+
+	writeChunk(BinaryLogChunkHeader::Samples, rows, columns.data(), static_cast<std::size_t>(rows) * BINARY_LOG_COLUMNS);
+	rows = 0;
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+	close();
+}
+
+bool BinaryLogReader::open(const std::string& path)
+{
+	close();
+	if (!map(path))
+		return false;
+
+	if (size < sizeof(BinaryLogFileHeader))
+	{
+		close();
+		return false;
+	}
+
+	fileHeader = reinterpret_cast<const BinaryLogFileHeader*>(base);
+	if (0 != std::memcmp(fileHeader->magic, BinaryLogMagic, sizeof(BinaryLogMagic))
+		|| fileHeader->version > BINARY_LOG_VERSION
+		|| fileHeader->headerSize < sizeof(BinaryLogFileHeader) || fileHeader->headerSize > size
+		|| 0 != fileHeader->headerSize % 4
+		|| (1 == fileHeader->version ? BINARY_LOG_COLUMNS_V1 : BINARY_LOG_COLUMNS) != fileHeader->columns)
+	{
+		close();
+		return false;
+	}
+
+	index();
+	return true;
+}
+
+void BinaryLogReader::index()
+{
+	std::size_t pos = fileHeader->headerSize;
+
+	while (pos + sizeof(BinaryLogChunkHeader) <= size)
+	{
+		auto h = reinterpret_cast<const BinaryLogChunkHeader*>(base + pos);
+		if (BinaryLogChunkMagic != h->magic)
+			break;
+		if (BinaryLogChunkHeader::Samples != h->kind && BinaryLogChunkHeader::Run != h->kind)
+			break;
+		if (BinaryLogChunkHeader::Samples == h->kind && (0 == h->rows || h->rows > fileHeader->chunkRows))
+			break;
+
+		std::size_t bytes = payloadBytes(h->kind, h->rows, fileHeader->columns);
+		const unsigned char* payload = base + pos + sizeof(BinaryLogChunkHeader);
+		if (bytes > size - pos - sizeof(BinaryLogChunkHeader))
+			break;
+		if (h->checksum != chunkChecksum(h->kind, h->rows, payload, bytes))
+			break;
+
+		Chunk c{ h->kind, h->rows, reinterpret_cast<const float*>(payload), 0.0f };
+		if (BinaryLogChunkHeader::Run == h->kind)
+			c.setpoint = c.data[0];
+		chunkList.push_back(c);
+
+		pos += sizeof(BinaryLogChunkHeader) + bytes;
+	}
+
+	trailing = pos != size;
+}
+
+#ifdef _WIN32
+
+bool BinaryLogReader::map(const std::string& path)
+{
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == f)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || 0 == fileSize.QuadPart)
+	{
+		CloseHandle(f);
+		return false;
+	}
+
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (nullptr == m)
+	{
+		CloseHandle(f);
+		return false;
+	}
+
+	base = static_cast<const unsigned char*>(MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0));
+	if (nullptr == base)
+	{
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+
+	fileHandle = f;
+	mapHandle = m;
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void BinaryLogReader::close()
+{
+	if (nullptr != base)
+		UnmapViewOfFile(base);
+	if (nullptr != mapHandle)
+		CloseHandle(mapHandle);
+	if (nullptr != fileHandle)
+		CloseHandle(fileHandle);
+
+	base = nullptr;
+	mapHandle = nullptr;
+	fileHandle = nullptr;
+	size = 0;
+	fileHeader = nullptr;
+	chunkList.clear();
+	trailing = false;
+}
+
+#else
+
+bool BinaryLogReader::map(const std::string& path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (0 != fstat(fd, &st) || 0 == st.st_size)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (MAP_FAILED == p)
+		return false;
+
+	base = static_cast<const unsigned char*>(p);
+	size = static_cast<std::size_t>(st.st_size);
+	return true;
+}
+
+void BinaryLogReader::close()
+{
+	if (nullptr != base)
+		munmap(const_cast<unsigned char*>(base), size);
+
+	base = nullptr;
+	size = 0;
+	fileHeader = nullptr;
+	chunkList.clear();
+	trailing = false;
+}
+
+#endif
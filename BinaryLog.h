@@ -0,0 +1,133 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+* Binary flight log, the compact alternative to <plane>_logN.csv.
+*
+* Layout (native little endian, every field 4 byte aligned):
+*   BinaryLogFileHeader                       airframe, gains, limits, T
+*   { BinaryLogChunkHeader, payload }...      appended, never rewritten
+*
+* A Samples chunk holds up to chunkRows rows stored column by column
+* (rows x t, rows x error, ...), a Run chunk marks a new controller run and
+* holds its setpoint. Every chunk is written in one piece with a checksum,
+* so a log cut short by a crash reads back up to the last complete chunk.
+*
+* Version 1 logs have the first BINARY_LOG_COLUMNS_V1 columns only; the
+* reader takes them, header().columns tells which layout a log has.
+*/
+
+#define BINARY_LOG_VERSION 2
+#define BINARY_LOG_COLUMNS 9		/* t;error;speed;out;setpoint;Int;Diff;alt;weight */
+#define BINARY_LOG_COLUMNS_V1 7
+#define BINARY_LOG_CHUNK_ROWS 256
+
+struct BinaryLogFileHeader
+{
+	char magic[8];				/* "ATLOG\r\n\x1a", catches text mode transfers */
+	std::uint32_t version;
+	std::uint32_t headerSize;	/* offset of the first chunk */
+	std::uint32_t columns;
+	std::uint32_t chunkRows;
+	char airframe[64];
+	float Kp, Ki, Kd, tau;
+	float limMin, limMax, limMinInt, limMaxInt;
+	float holdSpeed;
+	float T;
+};
+
+struct BinaryLogChunkHeader
+{
+	enum Kind : std::uint32_t
+	{
+		Samples = 1,
+		Run = 2
+	};
+
+	std::uint32_t magic;		/* BinaryLogChunkMagic */
+	std::uint32_t kind;
+	std::uint32_t rows;			/* Samples: rows in the chunk, Run: 0 */
+	std::uint32_t checksum;		/* FNV-1a over kind, rows and payload */
+};
+
+static_assert(sizeof(BinaryLogFileHeader) == 128, "BinaryLogFileHeader is part of the file format");
+static_assert(sizeof(BinaryLogChunkHeader) == 16, "BinaryLogChunkHeader is part of the file format");
+
+BinaryLogFileHeader BinaryLog_MakeHeader(const std::string& airframe);
+
+/* append-only writer, buffers one chunk of rows */
+class BinaryLogWriter
+{
+	std::ofstream file;
+	std::vector<float> columns;		/* BINARY_LOG_COLUMNS x BINARY_LOG_CHUNK_ROWS */
+	std::uint32_t rows = 0;
+
+	void writeChunk(std::uint32_t kind, std::uint32_t rows, const float* payload, std::size_t count);
+
+public:
+	/* truncates path and writes the file header */
+	bool open(const std::string& path, const BinaryLogFileHeader& header);
+	void close();
+	bool isOpen() const { return file.is_open(); }
+
+	/* one row of BINARY_LOG_COLUMNS values, the chunk is written when full */
+	void append(const float* row);
+	/* ends the current chunk and marks a new run */
+	void run(float setpoint);
+	/* writes the rows buffered so far as a (short) chunk */
+	void flush();
+
+	std::uint32_t pendingRows() const { return rows; }
+};
+
+/* read-only view of a binary log, memory mapped */
+class BinaryLogReader
+{
+public:
+	struct Chunk
+	{
+		std::uint32_t kind;
+		std::uint32_t rows;
+		const float* data;			/* Samples: column c starts at data + c * rows */
+		float setpoint;				/* Run */
+
+		const float* column(int c) const { return data + static_cast<std::size_t>(c) * rows; }
+	};
+
+	BinaryLogReader() = default;
+	~BinaryLogReader();
+
+	BinaryLogReader(const BinaryLogReader&) = delete;
+	BinaryLogReader& operator=(const BinaryLogReader&) = delete;
+
+	/* false if the file is missing, not a binary log or a newer version */
+	bool open(const std::string& path);
+	void close();
+
+	const BinaryLogFileHeader& header() const { return *fileHeader; }
+	const std::vector<Chunk>& chunks() const { return chunkList; }
+	/* bytes after the last complete chunk, e.g. from a crash while writing */
+	bool truncated() const { return trailing; }
+
+private:
+	const unsigned char* base = nullptr;
+	std::size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mapHandle = nullptr;
+#endif
+	const BinaryLogFileHeader* fileHeader = nullptr;
+	std::vector<Chunk> chunkList;
+	bool trailing = false;
+
+	bool map(const std::string& path);
+	void index();
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "EngineSync.h"
+
+/* below this mean the engines are considered shut down and the trims are held */
+#define ENGINE_SYNC_MIN_MEAN 1e-3f
+
+EngineSync::EngineSync()
+	: bank(ENGINE_SYNC_MAX_ENGINES)
+{
+}
+
+void EngineSync::configure(int engines, Parameter p, float Kp, float Ki, float authority)
+{
+	engineCount = engines < 0 ? 0 : (engines > ENGINE_SYNC_MAX_ENGINES ? ENGINE_SYNC_MAX_ENGINES : engines);
+	param = p;
+
+	channel = PIDController{ 0 };
+	channel.Kp = Kp;
+	channel.Ki = Ki;
+	channel.tau = 0.02f;
+	channel.limMin = -authority;
+	channel.limMax = authority;
+	channel.limMinInt = -authority;
+	channel.limMaxInt = authority;
+	channel.T = 0.05f;
+
+	for (std::size_t ch = 0; ch < bank.size(); ++ch)
+		bank.setChannel(ch, channel);
+}
+
+void EngineSync::start(const float* throttle)
+{
+	float mean = 0;
+	for (int i = 0; i < engineCount; ++i)
+		mean += throttle[i];
+	mean /= engineCount > 0 ? engineCount : 1;
+
+	for (int i = 0; i < ENGINE_SYNC_MAX_ENGINES; ++i)
+	{
+		PIDController c = channel;
+		if (i < engineCount)
+		{
+			float offset = throttle[i] - mean;
+			offset = offset < c.limMinInt ? c.limMinInt : (offset > c.limMaxInt ? c.limMaxInt : offset);
+			c.integrator = offset;
+			c.out = offset;
+		}
+		c.prevMeasurement = 1.0f;
+		bank.setChannel(i, c);
+	}
+}
+
+void EngineSync::update(float command, const float* n1, const float* torque, float* throttle, float dt)
+{
+	const float* power = Parameter::Torque == param ? torque : n1;
+
+	float mean = 0;
+	for (int i = 0; i < engineCount; ++i)
+		mean += power[i];
+	mean /= engineCount > 0 ? engineCount : 1;
+
+	if (enabled() && mean > ENGINE_SYNC_MIN_MEAN)
+	{
+		float setpoint[ENGINE_SYNC_MAX_ENGINES];
+		float relative[ENGINE_SYNC_MAX_ENGINES];
+
+		/* unused channels sit at zero error */
+		for (int i = 0; i < ENGINE_SYNC_MAX_ENGINES; ++i)
+		{
+			setpoint[i] = 1.0f;
+			relative[i] = i < engineCount ? power[i] / mean : 1.0f;
+		}
+
+		bank.setTime(dt);
+		bank.update(setpoint, relative);
+	}
+
+	for (int i = 0; i < engineCount; ++i)
+	{
+		float t = command + (enabled() ? bank.out(i) : 0.0f);
+		throttle[i] = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	}
+}
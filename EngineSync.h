@@ -0,0 +1,52 @@
+#ifndef ENGINE_SYNC_H
+#define ENGINE_SYNC_H
+
+#include "PIDBank.h"
+
+/* X-Plane's per-engine arrays hold 8 entries */
+#define ENGINE_SYNC_MAX_ENGINES 8
+
+/*
+* Per-engine throttle trim on top of the collective command of the speed loop.
+* One PIDBank channel per engine drives that engine's power parameter (N1 or
+* torque) towards the mean of all engines; the channel output is a throttle
+* offset limited to +-authority. The channels see the parameter relative to the
+* mean, so the gains do not depend on its unit. The speed loop keeps handling
+* the common mode, the trims only remove asymmetry.
+*/
+class EngineSync
+{
+public:
+	enum class Parameter
+	{
+		Off = 0,
+		N1 = 1,
+		Torque = 2
+	};
+
+	EngineSync();
+
+	void configure(int engines, Parameter p, float Kp, float Ki, float authority);
+	bool enabled() const { return Parameter::Off != param && engineCount > 1; }
+	int engines() const { return engineCount; }
+	Parameter parameter() const { return param; }
+
+	/* bumpless start: the current offsets of the levers from their mean become the trims */
+	void start(const float* throttle);
+
+	/*
+	* command: collective throttle, n1 / torque: ENGINE_SYNC_MAX_ENGINES values,
+	* throttle: receives the per-engine commands, clamped to 0..1
+	*/
+	void update(float command, const float* n1, const float* torque, float* throttle, float dt);
+
+	float trim(int engine) const { return bank.out(engine); }
+
+private:
+	PIDBank bank;
+	PIDController channel{ 0 };
+	Parameter param = Parameter::Off;
+	int engineCount = 0;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "EnvelopeLimiter.h"
+
+/* time constant of the rate filter, s */
+#define ENVELOPE_RATE_TAU 0.5f
+
+void EnvelopeLimiter::configure(const float (&redlines)[Count], float lookaheadTime, float limitGain)
+{
+	for (int p = 0; p < Count; ++p)
+		redline[p] = redlines[p];
+	lookahead = lookaheadTime;
+	gain = limitGain;
+
+	reset();
+}
+
+bool EnvelopeLimiter::enabled() const
+{
+	for (int p = 0; p < Count; ++p)
+	{
+		if (redline[p] > 0)
+			return true;
+	}
+	return false;
+}
+
+void EnvelopeLimiter::reset()
+{
+	for (int p = 0; p < Count; ++p)
+	{
+		previous[p] = 0;
+		rates[p] = 0;
+	}
+	primed = false;
+	currentLimit = 1.0f;
+	binding = Count;
+}
+
+float EnvelopeLimiter::update(const float (&values)[Count], float command, float dt)
+{
+	currentLimit = 1.0f;
+	binding = Count;
+
+	if (dt <= 0)
+		return currentLimit;
+
+	/* no rates yet and the command may be stale: the first call does not limit */
+	if (!primed)
+	{
+		for (int p = 0; p < Count; ++p)
+			previous[p] = values[p];
+		primed = true;
+		return currentLimit;
+	}
+
+	for (int p = 0; p < Count; ++p)
+	{
+		/* first order filtered derivative, the raw difference is too noisy to extrapolate */
+		float raw = (values[p] - previous[p]) / dt;
+		rates[p] += (raw - rates[p]) * dt / (ENVELOPE_RATE_TAU + dt);
+		previous[p] = values[p];
+
+		if (redline[p] <= 0)
+			continue;
+
+		float rising = rates[p] > 0 ? rates[p] : 0.0f;
+		float predicted = values[p] + rising * lookahead;
+		float limit = command + gain * (redline[p] - predicted) / redline[p];
+
+		if (limit < currentLimit)
+		{
+			currentLimit = limit;
+			binding = static_cast<Parameter>(p);
+		}
+	}
+
+	if (currentLimit < 0.0f)
+		currentLimit = 0.0f;
+	return currentLimit;
+}
+
+float EnvelopeLimiter::highest(const float* values, int count)
+{
+	float h = count > 0 ? values[0] : 0.0f;
+	for (int i = 1; i < count; ++i)
+	{
+		if (values[i] > h)
+			h = values[i];
+	}
+	return h;
+}
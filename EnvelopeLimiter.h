@@ -0,0 +1,56 @@
+#ifndef ENVELOPE_LIMITER_H
+#define ENVELOPE_LIMITER_H
+
+/*
+* Engine envelope protection: the highest throttle that keeps ITT, torque and
+* N1 below their redlines. Per parameter the value is predicted 'lookahead'
+* seconds ahead from its (filtered) rate of rise; the relative headroom to the
+* redline then moves the permitted throttle away from the current command:
+*
+*   limit = command + gain * (redline - predicted) / redline
+*
+* Far from a redline this is well above the command and does not bind. Close
+* to it the limit follows the command, and since the controller output rides
+* the limit, the engine settles exactly at the redline. Above it the limit
+* pulls the throttle back. The smallest limit over all parameters wins.
+*/
+class EnvelopeLimiter
+{
+public:
+	enum Parameter
+	{
+		ITT,
+		Torque,
+		N1,
+		Count		/* also: no parameter is limiting */
+	};
+
+	/* redlines, <= 0 leaves that parameter unlimited */
+	void configure(const float (&redlines)[Count], float lookahead, float gain);
+	bool enabled() const;
+	void reset();
+
+	/* values: highest engine per parameter, command: last throttle command; returns the limit */
+	float update(const float (&values)[Count], float command, float dt);
+
+	float limit() const { return currentLimit; }
+	Parameter limiting() const { return binding; }
+	float rate(Parameter p) const { return rates[p]; }
+
+	/* largest of count values, for picking the hottest engine */
+	static float highest(const float* values, int count);
+
+private:
+	float redline[Count] = {};
+	float lookahead = 0;
+	float gain = 0;
+
+	float previous[Count] = {};
+	float rates[Count] = {};
+	bool primed = false;
+
+	float currentLimit = 1.0f;
+	Parameter binding = Count;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "FlightLog.h"
+
+#include <chrono>
+
+/* how long the writer sleeps when the ring is empty */
+static const auto WriterIdle = std::chrono::milliseconds(20);
+/* longest a partial binary chunk stays in memory, i.e. what a crash can lose */
+static const auto BinaryFlush = std::chrono::seconds(1);
+
+FlightLog::FlightLog()
+{
+}
+
+FlightLog::~FlightLog()
+{
+	shutdown();
+}
+
+bool FlightLog::open(const std::string& path, const FlightLogHeader& header, FlightLogFormat format)
+{
+	if (!running)
+	{
+		stopping = false;
+		writer = std::thread(&FlightLog::writerLoop, this);
+		running = true;
+	}
+
+	opened = request(path, header, format);
+	return opened;
+}
+
+void FlightLog::close()
+{
+	if (running)
+		request(std::string(), FlightLogHeader{}, FlightLogFormat::Csv);
+	opened = false;
+}
+
+void FlightLog::shutdown()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard{ requestLock };
+		stopping = true;
+	}
+	requestCv.notify_all();
+	writer.join();
+
+	running = false;
+	opened = false;
+}
+
+bool FlightLog::enqueue(const Record& rec)
+{
+	if (ring.push(rec))
+		return true;
+
+	droppedCnt.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool FlightLog::beginRun(float setpoint)
+{
+	Record rec{ Record::Run, FlightLogSample{} };
+	rec.sample.setpoint = setpoint;
+	return enqueue(rec);
+}
+
+bool FlightLog::push(const FlightLogSample& sample)
+{
+	return enqueue(Record{ Record::Sample, sample });
+}
+
+bool FlightLog::request(const std::string& path, const FlightLogHeader& header, FlightLogFormat fmt)
+{
+	std::unique_lock<std::mutex> guard{ requestLock };
+	requestPath = path;
+	requestHeader = header;
+	requestFormat = fmt;
+	requestPending = true;
+	requestDone = false;
+	requestCv.notify_all();
+
+	requestCv.wait(guard, [this]() { return requestDone; });
+	return requestOk;
+}
+
+void FlightLog::writeCsvHeader(std::ostream& out, const FlightLogHeader& h)
+{
+	out << "Airframe: " << h.airframe << "\n";
+	out << "Kp: " << h.Kp << "\n";
+	out << "Ki: " << h.Ki << "\n";
+	out << "Kd: " << h.Kd << "\n";
+	out << "tau: " << h.tau << "\n";
+	out << "limMin: " << h.limMin << "\n";
+	out << "limMax: " << h.limMax << "\n";
+	out << "intLimMin: " << h.limMinInt << "\n";
+	out << "intLimMax: " << h.limMaxInt << "\n";
+	out << "holdSpeed: " << h.holdSpeed << "\n";
+	out << "T: " << h.T << "\n";
+}
+
+void FlightLog::writeCsvRun(std::ostream& out, float setpoint)
+{
+	out << "setpoint: " << setpoint << "\n";
+	out << "t;error;speed;out;setpoint;Int;Diff;alt;weight" << "\n";
+}
+
+void FlightLog::writeCsvSample(std::ostream& out, const FlightLogSample& s)
+{
+	out << s.t << ";";
+	out << s.error << ";";
+	out << s.speed << ";";
+	out << s.out << ";";
+	out << s.setpoint << ";";
+	out << s.integrator << ";";
+	out << s.differentiator << ";";
+	out << s.altitude << ";";
+	out << s.weight << "\n";
+}
+
+/* writer thread */
+bool FlightLog::openFile()
+{
+	format = requestFormat;
+	if (FlightLogFormat::Binary == format)
+	{
+		const FlightLogHeader& h = requestHeader;
+		BinaryLogFileHeader bh = BinaryLog_MakeHeader(h.airframe);
+		bh.Kp = h.Kp, bh.Ki = h.Ki, bh.Kd = h.Kd, bh.tau = h.tau;
+		bh.limMin = h.limMin, bh.limMax = h.limMax, bh.limMinInt = h.limMinInt, bh.limMaxInt = h.limMaxInt;
+		bh.holdSpeed = h.holdSpeed;
+		bh.T = h.T;
+		return binary.open(requestPath, bh);
+	}
+
+	file.clear();
+	file.open(requestPath);
+	if (!file.is_open())
+		return false;
+
+	writeCsvHeader(file, requestHeader);
+	file.flush();
+	return true;
+}
+
+/* writer thread */
+void FlightLog::closeFile()
+{
+	file.close();
+	binary.close();
+}
+
+/* writer thread: formats everything queued, true if anything was written */
+bool FlightLog::drain()
+{
+	Record rec;
+	bool any = false;
+
+	while (ring.pop(rec))
+	{
+		any = true;
+		const FlightLogSample& s = rec.sample;
+
+		if (FlightLogFormat::Binary == format)
+		{
+			if (!binary.isOpen())
+				continue;
+
+			if (Record::Run == rec.kind)
+				binary.run(s.setpoint);
+			else
+			{
+				const float row[BINARY_LOG_COLUMNS] = { s.t, s.error, s.speed, s.out, s.setpoint, s.integrator, s.differentiator, s.altitude, s.weight };
+				binary.append(row);
+				writtenCnt.fetch_add(1, std::memory_order_relaxed);
+			}
+			continue;
+		}
+
+		if (!file.is_open())
+			continue;
+
+		if (Record::Run == rec.kind)
+			writeCsvRun(file, s.setpoint);
+		else
+		{
+			writeCsvSample(file, s);
+			writtenCnt.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	return any;
+}
+
+void FlightLog::writerLoop()
+{
+	std::unique_lock<std::mutex> guard{ requestLock };
+
+	auto lastFlush = std::chrono::steady_clock::now();
+
+	for (;;)
+	{
+		guard.unlock();
+		if (drain())
+			file.flush();
+		/* binary rows are kept for a full chunk, but not longer than BinaryFlush */
+		if (binary.pendingRows() > 0 && std::chrono::steady_clock::now() - lastFlush >= BinaryFlush)
+		{
+			binary.flush();
+			lastFlush = std::chrono::steady_clock::now();
+		}
+		guard.lock();
+
+		if (requestPending)
+		{
+			/* records pushed before the request belong to the old file */
+			guard.unlock();
+			drain();
+			guard.lock();
+
+			closeFile();
+			requestOk = requestPath.empty() || openFile();
+
+			requestPending = false;
+			requestDone = true;
+			requestCv.notify_all();
+			continue;
+		}
+
+		if (stopping)
+			break;
+
+		requestCv.wait_for(guard, WriterIdle, [this]() { return requestPending || stopping; });
+	}
+
+	guard.unlock();
+	drain();
+	closeFile();
+}
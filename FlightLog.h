@@ -0,0 +1,131 @@
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "BinaryLog.h"
+#include "SpscRing.h"
+
+/* one line of the <plane>_logN.csv table */
+struct FlightLogSample
+{
+	float t;
+	float error;
+	float speed;
+	float out;
+	float setpoint;
+	float integrator;
+	float differentiator;
+	float altitude;		/* pressure altitude, ft */
+	float weight;		/* gross weight, kg */
+};
+
+/* the "Airframe: ..." block at the top of every log */
+struct FlightLogHeader
+{
+	std::string airframe;
+	float Kp, Ki, Kd, tau;
+	float limMin, limMax, limMinInt, limMaxInt;
+	float holdSpeed;
+	float T;
+};
+
+enum class FlightLogFormat
+{
+	Csv,		/* <plane>_logN.csv, semicolon separated text */
+	Binary		/* <plane>_logN.atlog, see BinaryLog.h */
+};
+
+/*
+* Flight log written by a background thread. The flight loop only copies
+* records into a lock-free ring (push/beginRun), formatting and file I/O
+* happen on the writer thread. When the ring is full the record is dropped
+* and counted instead of blocking the frame.
+*
+* push/beginRun must be called from one thread (the flight loop), open/close
+* from the thread that owns the log (the X-Plane main thread, same one).
+* The writer thread starts with the first open() and ends in shutdown(), not
+* in the constructor/destructor: a global FlightLog in a DLL would otherwise
+* create and join threads under the loader lock.
+*/
+class FlightLog
+{
+public:
+	FlightLog();
+	~FlightLog();
+
+	FlightLog(const FlightLog&) = delete;
+	FlightLog& operator=(const FlightLog&) = delete;
+
+	/* finishes the current file and starts path with header, blocks until the swap is done */
+	bool open(const std::string& path, const FlightLogHeader& header, FlightLogFormat format = FlightLogFormat::Csv);
+	/* writes everything queued so far and closes the file */
+	void close();
+	/* close() and stop the writer thread, open() restarts it */
+	void shutdown();
+	bool isOpen() const { return opened; }
+
+	/* "setpoint: ..." line and column header of a new controller run */
+	bool beginRun(float setpoint);
+	bool push(const FlightLogSample& sample);
+
+	/* records lost to a full ring since construction */
+	std::uint64_t dropped() const { return droppedCnt.load(std::memory_order_relaxed); }
+	std::uint64_t written() const { return writtenCnt.load(std::memory_order_relaxed); }
+
+	/* the CSV layout, shared with the binary log converter */
+	static void writeCsvHeader(std::ostream& out, const FlightLogHeader& header);
+	static void writeCsvRun(std::ostream& out, float setpoint);
+	static void writeCsvSample(std::ostream& out, const FlightLogSample& sample);
+
+private:
+	struct Record
+	{
+		enum Kind : std::uint32_t
+		{
+			Sample,
+			Run
+		} kind;
+		FlightLogSample sample;
+	};
+
+	/* ~100 s of samples at the 0.1 s log interval */
+	SpscRing<Record, 1024> ring;
+
+	std::atomic<std::uint64_t> droppedCnt{ 0 };
+	std::atomic<std::uint64_t> writtenCnt{ 0 };
+	bool opened = false;
+
+	/* open/close requests handed to the writer */
+	std::mutex requestLock;
+	std::condition_variable requestCv;
+	bool requestPending = false;
+	bool requestDone = false;
+	std::string requestPath;
+	FlightLogHeader requestHeader{};
+	FlightLogFormat requestFormat = FlightLogFormat::Csv;
+	bool requestOk = false;
+	bool stopping = false;
+	bool running = false;
+
+	FlightLogFormat format = FlightLogFormat::Csv;
+	std::ofstream file;
+	BinaryLogWriter binary;
+	std::thread writer;
+
+	void writerLoop();
+	bool drain();
+	bool enqueue(const Record& rec);
+	bool request(const std::string& path, const FlightLogHeader& header, FlightLogFormat format);
+	bool openFile();
+	void closeFile();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "FlightPhase.h"
+
+FlightPhase::Phase FlightPhase::reset(const Inputs& in)
+{
+	current = Cruise; // not Retard, re-enabling on the ground starts a takeoff
+	current = candidate = classify(in);
+	candidateTime = 0;
+	switched = false;
+	return current;
+}
+
+FlightPhase::Phase FlightPhase::update(const Inputs& in, float dt)
+{
+	switched = false;
+
+	Phase next = classify(in);
+	if (next == current)
+	{
+		candidate = current;
+		candidateTime = 0;
+		return current;
+	}
+
+	if (next != candidate)
+	{
+		candidate = next;
+		candidateTime = 0;
+	}
+	candidateTime += dt;
+
+	if (Retard == next || candidateTime >= thresholds.dwell)
+	{
+		current = next;
+		candidateTime = 0;
+		switched = true;
+	}
+	return current;
+}
+
+FlightPhase::Phase FlightPhase::classify(const Inputs& in) const
+{
+	// after the retard the aircraft stays at idle through the landing roll
+	if (in.onGround)
+		return Retard == current ? Retard : Takeoff;
+
+	bool climbing = in.vs > thresholds.climbVs;
+
+	if ((Approach == current || Retard == current) && in.agl < thresholds.retardAgl && !climbing)
+		return Retard;
+
+	// go-around: out of the retard only with a positive climb
+	if (Retard == current && !climbing)
+		return Retard;
+
+	if (Takeoff == current && in.agl < thresholds.takeoffAgl)
+		return Takeoff;
+
+	if (in.gearDown && in.agl < thresholds.approachAgl && !climbing)
+		return Approach;
+
+	if (climbing)
+		return Climb;
+	if (in.vs < -thresholds.climbVs)
+		return Descent;
+	return Cruise;
+}
+
+const char* FlightPhase::name(Phase p)
+{
+	switch (p)
+	{
+		case Takeoff: return "takeoff";
+		case Climb: return "climb";
+		case Cruise: return "cruise";
+		case Descent: return "descent";
+		case Approach: return "approach";
+		case Retard: return "retard";
+		default: return "";
+	}
+}
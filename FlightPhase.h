@@ -0,0 +1,73 @@
+#ifndef FLIGHT_PHASE_H
+#define FLIGHT_PHASE_H
+
+/*
+* Flight phase from height above ground, vertical speed, the ground contact
+* and the gear handle. The phase picks the gain and limit block the speed
+* controller runs with:
+*
+*   Takeoff   on the ground, and after lift-off up to 'takeoffAgl'
+*   Climb     vertical speed above +climbVs
+*   Cruise    vertical speed within +-climbVs
+*   Descent   vertical speed below -climbVs
+*   Approach  below 'approachAgl' with the gear down, not climbing
+*   Retard    below 'retardAgl' out of the approach, idle until the next takeoff
+*
+* A new phase has to be seen for 'dwell' seconds before it is taken, so a
+* bump in vertical speed does not toggle gains. Retard is taken at once.
+*/
+class FlightPhase
+{
+public:
+	enum Phase
+	{
+		Takeoff,
+		Climb,
+		Cruise,
+		Descent,
+		Approach,
+		Retard,
+		Count
+	};
+
+	struct Inputs
+	{
+		float agl;			/* ft */
+		float vs;			/* ft/min */
+		bool onGround;
+		bool gearDown;
+	};
+
+	struct Thresholds
+	{
+		float climbVs = 300;		/* ft/min */
+		float takeoffAgl = 1000;	/* ft */
+		float approachAgl = 2500;	/* ft */
+		float retardAgl = 100;		/* ft */
+		float dwell = 3;			/* s */
+	};
+
+	void configure(const Thresholds& t) { thresholds = t; }
+
+	/* phase straight from the inputs, no dwell; on enabling the auto throttle */
+	Phase reset(const Inputs& in);
+	/* returns the current phase, changed() tells if it switched in this call */
+	Phase update(const Inputs& in, float dt);
+
+	Phase phase() const { return current; }
+	bool changed() const { return switched; }
+
+	/* lower case name, also the prefix of the phase's keys in the aircraft ini */
+	static const char* name(Phase p);
+
+private:
+	Phase classify(const Inputs& in) const;
+
+	Thresholds thresholds;
+	Phase current = Cruise;
+	Phase candidate = Cruise;
+	float candidateTime = 0;
+	bool switched = false;
+};
+
+#endif
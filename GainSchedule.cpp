@@ -0,0 +1,72 @@
+#include "GainSchedule.h"
+
+void GainSchedule::clear()
+{
+	grid.clear();
+	for (int g = 0; g < Gains; ++g)
+		table[g].clear();
+	active = false;
+}
+
+bool GainSchedule::configure(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<float> (&values)[Gains])
+{
+	clear();
+
+	if (!grid.configure(breakpoints))
+	{
+		lastError = grid.error();
+		clear();
+		return false;
+	}
+
+	bool any = false;
+	for (int g = 0; g < Gains; ++g)
+	{
+		if (values[g].empty())
+			continue;
+		if (static_cast<int>(values[g].size()) != grid.size())
+		{
+			lastError = "number of gain values does not match the breakpoints";
+			clear();
+			return false;
+		}
+		table[g] = values[g];
+		any = true;
+	}
+
+	if (!any)
+	{
+		lastError = "no gains";
+		clear();
+		return false;
+	}
+
+	lastError = "";
+	active = true;
+	return true;
+}
+
+float GainSchedule::gain(Gain g, const float (&point)[OperatingGrid::Axes]) const
+{
+	int offset[OperatingGrid::Corners];
+	float weight[OperatingGrid::Corners];
+	int count = grid.corners(point, offset, weight);
+	return OperatingGrid::blend(table[g].data(), offset, weight, count);
+}
+
+void GainSchedule::apply(PIDController& ctrl, const float (&point)[OperatingGrid::Axes]) const
+{
+	if (!active)
+		return;
+
+	int offset[OperatingGrid::Corners];
+	float weight[OperatingGrid::Corners];
+	int count = grid.corners(point, offset, weight);
+
+	if (schedules(Kp))
+		ctrl.Kp = OperatingGrid::blend(table[Kp].data(), offset, weight, count);
+	if (schedules(Ki))
+		ctrl.Ki = OperatingGrid::blend(table[Ki].data(), offset, weight, count);
+	if (schedules(Kd))
+		ctrl.Kd = OperatingGrid::blend(table[Kd].data(), offset, weight, count);
+}
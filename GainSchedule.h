@@ -0,0 +1,57 @@
+#ifndef GAIN_SCHEDULE_H
+#define GAIN_SCHEDULE_H
+
+#include <vector>
+
+#include "OperatingGrid.h"
+#include "PID.h"
+
+/*
+* Kp, Ki and Kd tabulated over IAS, pressure altitude and gross weight and
+* interpolated (bi-/tri-)linearly in between. Any axis can be left out, so the
+* table is 1-D to 3-D; outside the breakpoints the edge values hold.
+*
+* The breakpoints, their lookup and the interpolation weights are the
+* OperatingGrid's; a lookup does not allocate and blends at most 8 table
+* values per gain, O(1) per tick regardless of the table size.
+*/
+class GainSchedule
+{
+public:
+	enum Gain
+	{
+		Kp,
+		Ki,
+		Kd,
+		Gains
+	};
+
+	/*
+	* breakpoints: strictly increasing per axis, empty = axis not used.
+	* values: per gain either empty (gain not scheduled) or one value per grid
+	* point, IAS running fastest, then altitude, then weight.
+	* Returns false and stays disabled if the sizes do not fit.
+	*/
+	bool configure(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<float> (&values)[Gains]);
+	void clear();
+
+	bool enabled() const { return active; }
+	bool uses(OperatingGrid::Axis a) const { return grid.uses(a); }
+	bool schedules(Gain g) const { return !table[g].empty(); }
+
+	/* interpolated gain at the operating point; only valid if schedules(g) */
+	float gain(Gain g, const float (&point)[OperatingGrid::Axes]) const;
+	/* writes the scheduled gains into ctrl, the others stay as they are */
+	void apply(PIDController& ctrl, const float (&point)[OperatingGrid::Axes]) const;
+
+	/* why the last configure() failed */
+	const char* error() const { return lastError; }
+
+private:
+	OperatingGrid grid;
+	std::vector<float> table[Gains];
+	bool active = false;
+	const char* lastError = "";
+};
+
+#endif
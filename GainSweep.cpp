@@ -0,0 +1,217 @@
+#include "GainSweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+
+#include "WorkStealingPool.h"
+
+float SweepRange::at(unsigned i) const
+{
+	if (steps < 2)
+		return min;
+
+	return min + (max - min) * static_cast<float>(i) / static_cast<float>(steps - 1);
+}
+
+static float PIDController::* const SweepFields[] = {
+	&PIDController::Kp, &PIDController::Ki, &PIDController::Kd, &PIDController::tau,
+	&PIDController::limMin, &PIDController::limMax, &PIDController::limMinInt, &PIDController::limMaxInt
+};
+
+/* same order as SweepFields */
+static void sweepRanges(const SweepSpace& space, const SweepRange* (&ranges)[8])
+{
+	ranges[0] = &space.kp, ranges[1] = &space.ki, ranges[2] = &space.kd, ranges[3] = &space.tau;
+	ranges[4] = &space.limMin, ranges[5] = &space.limMax, ranges[6] = &space.limMinInt, ranges[7] = &space.limMaxInt;
+}
+
+static bool validLimits(const PIDController& c)
+{
+	return c.limMin < c.limMax && c.limMinInt <= c.limMaxInt;
+}
+
+std::size_t SweepSpace::gridSize() const
+{
+	const SweepRange* ranges[8];
+	sweepRanges(*this, ranges);
+
+	std::size_t size = 1;
+	for (auto r : ranges)
+		if (r->steps > 0)
+			size *= r->steps;
+	return size;
+}
+
+GainSweep::GainSweep(const PlantModel& plant, const SweepScenario& scenario, const SweepWeights& weights)
+	: plant(plant), scenario(scenario), weights(weights)
+{
+}
+
+std::vector<PIDController> GainSweep::expandGrid(const SweepSpace& space, const PIDController& base)
+{
+	const SweepRange* ranges[8];
+	sweepRanges(space, ranges);
+
+	std::vector<PIDController> grid;
+	grid.reserve(space.gridSize());
+
+	for (std::size_t n = 0; n < space.gridSize(); ++n)
+	{
+		PIDController c = base;
+		std::size_t rest = n;
+
+		for (int f = 0; f < 8; ++f)
+		{
+			if (0 == ranges[f]->steps)
+				continue;
+			c.*SweepFields[f] = ranges[f]->at(static_cast<unsigned>(rest % ranges[f]->steps));
+			rest /= ranges[f]->steps;
+		}
+
+		if (validLimits(c))
+			grid.push_back(c);
+	}
+	return grid;
+}
+
+std::vector<PIDController> GainSweep::expandRandom(const SweepSpace& space, const PIDController& base, std::size_t count, unsigned seed)
+{
+	const SweepRange* ranges[8];
+	sweepRanges(space, ranges);
+
+	std::mt19937 rng{ seed };
+	std::uniform_real_distribution<float> uniform{ 0.0f, 1.0f };
+
+	std::vector<PIDController> samples;
+	samples.reserve(count);
+
+	/* invalid limit combinations are redrawn, give up if the space has none */
+	for (std::size_t tries = 0; samples.size() < count && tries < count * 100; ++tries)
+	{
+		PIDController c = base;
+
+		for (int f = 0; f < 8; ++f)
+		{
+			if (0 == ranges[f]->steps)
+				continue;
+			c.*SweepFields[f] = ranges[f]->min + (ranges[f]->max - ranges[f]->min) * uniform(rng);
+		}
+
+		if (validLimits(c))
+			samples.push_back(c);
+	}
+	return samples;
+}
+
+SweepMetrics GainSweep::simulate(const PIDController& gains) const
+{
+	std::unique_ptr<PlantModel> aircraft{ plant.clone() };
+	aircraft->reset();
+
+	/* the plant starts at its trim speed: the derivative must not see a jump from 0 to it */
+	PIDController ctrl = gains;
+	ctrl.T = scenario.T;
+	ctrl.integrator = 0;
+	ctrl.prevError = scenario.setpoint - aircraft->output();
+	ctrl.differentiator = 0;
+	ctrl.prevMeasurement = aircraft->output();
+	ctrl.out = 0;
+	PID pid{ ctrl };
+
+	SweepMetrics m{ 0, 0, 0, 0, true, 0 };
+
+	float setpoint = scenario.setpoint;
+	float measurement = aircraft->output();
+	float stepStart = 0;
+	float direction = setpoint >= measurement ? 1.0f : -1.0f;
+	float lastOutside = 0;
+	float throttle = 0;
+	std::size_t nextStep = 0;
+
+	/* closes the settling window of the current setpoint step */
+	auto closeStep = [&](float now) {
+		float settle = lastOutside - stepStart;
+		if (lastOutside >= now - scenario.T * 0.5f)
+		{
+			m.settled = false;
+			settle = now - stepStart;
+		}
+		m.settlingTime = std::max(m.settlingTime, settle);
+	};
+
+	const unsigned ticks = static_cast<unsigned>(scenario.duration / scenario.T + 0.5f);
+	for (unsigned i = 0; i < ticks; ++i)
+	{
+		float now = i * scenario.T;
+
+		if (nextStep < scenario.steps.size() && now >= scenario.steps[nextStep].time)
+		{
+			closeStep(now);
+			setpoint = scenario.steps[nextStep++].setpoint;
+			direction = setpoint >= measurement ? 1.0f : -1.0f;
+			stepStart = now;
+			lastOutside = now;
+		}
+
+		pid.update(setpoint, measurement);
+		float out = pid.data().out;
+		if (i > 0)
+			m.throttleActivity += std::fabs(out - throttle);
+		throttle = out;
+
+		measurement = aircraft->step(throttle, scenario.T);
+
+		float error = setpoint - measurement;
+		m.iae += std::fabs(error) * scenario.T;
+		m.overshoot = std::max(m.overshoot, -error * direction);
+		if (std::fabs(error) > scenario.settleBand)
+			lastOutside = now + scenario.T;
+
+		if (!std::isfinite(measurement))
+			break;
+	}
+	closeStep(ticks * scenario.T);
+
+	m.score = weights.overshoot * m.overshoot + weights.settlingTime * m.settlingTime
+		+ weights.iae * m.iae + weights.throttleActivity * m.throttleActivity;
+	if (!std::isfinite(m.score))
+		m.score = std::numeric_limits<float>::infinity();
+
+	return m;
+}
+
+std::vector<SweepResult> GainSweep::run(const std::vector<PIDController>& candidates, WorkStealingPool& pool) const
+{
+	std::vector<SweepResult> results(candidates.size());
+
+	pool.parallelFor(0, candidates.size(), 64, [&](std::size_t i) {
+		results[i].gains = candidates[i];
+		results[i].metrics = simulate(candidates[i]);
+	});
+
+	std::stable_sort(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b) {
+		return a.metrics.score < b.metrics.score;
+	});
+	return results;
+}
+
+void GainSweep::writeTable(std::ostream& out, const std::vector<SweepResult>& results, std::size_t top)
+{
+	out << "rank;kp;ki;kd;tau;limMin;limMax;limIntMin;limIntMax;overshoot;settlingTime;settled;iae;throttleActivity;score" << std::endl;
+
+	std::size_t rows = 0 == top ? results.size() : std::min(top, results.size());
+	for (std::size_t i = 0; i < rows; ++i)
+	{
+		const PIDController& c = results[i].gains;
+		const SweepMetrics& m = results[i].metrics;
+
+		out << i + 1 << ";";
+		out << c.Kp << ";" << c.Ki << ";" << c.Kd << ";" << c.tau << ";";
+		out << c.limMin << ";" << c.limMax << ";" << c.limMinInt << ";" << c.limMaxInt << ";";
+		out << m.overshoot << ";" << m.settlingTime << ";" << (m.settled ? 1 : 0) << ";";
+		out << m.iae << ";" << m.throttleActivity << ";" << m.score << std::endl;
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef GAIN_SWEEP_H
+#define GAIN_SWEEP_H
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "PID.h"
+#include "PlantModel.h"
+
+class WorkStealingPool;
+
+/* steps == 0 keeps the base value, steps == 1 uses min */
+struct SweepRange
+{
+	float min = 0;
+	float max = 0;
+	unsigned steps = 0;
+
+	float at(unsigned i) const;
+};
+
+struct SweepSpace
+{
+	SweepRange kp, ki, kd, tau;
+	SweepRange limMin, limMax, limMinInt, limMaxInt;
+
+	/* number of grid points before invalid limit combinations are dropped */
+	std::size_t gridSize() const;
+};
+
+/* one closed-loop flight: the plant starts in its initial state, the controller cold */
+struct SweepScenario
+{
+	float T = 0.05f;					/* controller period, s */
+	float duration = 120.0f;			/* s */
+	float setpoint = 180.0f;			/* kts, from t = 0 */
+	float settleBand = 1.0f;			/* kts */
+	struct Step
+	{
+		float time;
+		float setpoint;
+	};
+	std::vector<Step> steps;			/* further setpoint changes, ascending time */
+};
+
+struct SweepMetrics
+{
+	float overshoot;				/* kts beyond the setpoint in step direction, worst step */
+	float settlingTime;				/* s after a setpoint change until inside settleBand for good, worst step */
+	float iae;						/* integral of |error|, kts*s */
+	float throttleActivity;			/* sum of |delta throttle| */
+	bool settled;
+	float score;
+};
+
+/* score = sum of weight * metric, lower is better */
+struct SweepWeights
+{
+	float overshoot = 20.0f;
+	float settlingTime = 1.0f;
+	float iae = 1.0f;
+	float throttleActivity = 5.0f;
+};
+
+struct SweepResult
+{
+	PIDController gains;
+	SweepMetrics metrics;
+};
+
+class GainSweep
+{
+	const PlantModel& plant;
+	SweepScenario scenario;
+	SweepWeights weights;
+
+public:
+	/* plant is cloned per simulation and must outlive the sweep */
+	GainSweep(const PlantModel& plant, const SweepScenario& scenario, const SweepWeights& weights = SweepWeights{});
+
+	static std::vector<PIDController> expandGrid(const SweepSpace& space, const PIDController& base);
+	static std::vector<PIDController> expandRandom(const SweepSpace& space, const PIDController& base, std::size_t count, unsigned seed);
+
+	SweepMetrics simulate(const PIDController& gains) const;
+
+	/* simulates every candidate on the pool, result sorted by score */
+	std::vector<SweepResult> run(const std::vector<PIDController>& candidates, WorkStealingPool& pool) const;
+
+	/* semicolon separated like the flight logs, top == 0 writes all */
+	static void writeTable(std::ostream& out, const std::vector<SweepResult>& results, std::size_t top = 0);
+};
+
+#endif
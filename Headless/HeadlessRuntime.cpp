@@ -0,0 +1,301 @@
+#include "HeadlessRuntime.h"
+
+#include <XPLMPlugin.h>
+
+#include <chrono>
+#include <cstdio>
+
+// entry points of the statically linked plugin (XPlugin/dllmain.cpp)
+PLUGIN_API int XPluginStart(char* name, char* sig, char* desc);
+PLUGIN_API void XPluginStop();
+PLUGIN_API int XPluginEnable();
+PLUGIN_API void XPluginDisable();
+PLUGIN_API void XPluginReceiveMessage(XPLMPluginID from, int msg, void* param);
+
+namespace Headless
+{
+	Runtime& Runtime::instance()
+	{
+		static Runtime rt;
+		return rt;
+	}
+
+	Runtime::Runtime()
+	{
+		menus.emplace_back();
+		menus.back().name = "Plugins";
+
+		timeRef = defineFloat("sim/time/total_running_time_sec", 0, false);
+	}
+
+	void Runtime::setAircraft(std::unique_ptr<AircraftModel> m)
+	{
+		model = std::move(m);
+		if (model)
+			model->bind(*this);
+	}
+
+	std::string Runtime::aircraftFileName() const
+	{
+		return model ? model->fileName() + ".acf" : std::string{};
+	}
+
+	bool Runtime::startPlugin()
+	{
+		char name[256] = { 0 }, sig[256] = { 0 }, desc[256] = { 0 };
+
+		if (!XPluginStart(name, sig, desc))
+			return false;
+
+		return XPluginEnable() != 0;
+	}
+
+	void Runtime::loadAircraft()
+	{
+		XPluginReceiveMessage(XPLM_PLUGIN_XPLANE, XPLM_MSG_PLANE_LOADED, nullptr);
+	}
+
+	void Runtime::stopPlugin()
+	{
+		XPluginReceiveMessage(XPLM_PLUGIN_XPLANE, XPLM_MSG_PLANE_UNLOADED, nullptr);
+		XPluginDisable();
+		XPluginStop();
+	}
+
+	void Runtime::run(double seconds)
+	{
+		double end = time + seconds;
+
+		while (time < end)
+		{
+			callFlightLoops(xplm_FlightLoop_Phase_BeforeFlightModel);
+
+			if (model)
+				model->step(frameTime);
+
+			time += frameTime;
+			*timeRef = static_cast<float>(time);
+			++frames;
+
+			callFlightLoops(xplm_FlightLoop_Phase_AfterFlightModel);
+		}
+	}
+
+	void Runtime::callFlightLoops(int phase)
+	{
+		for (auto& loop : loops)
+		{
+			if (loop.destroyed || !loop.scheduled || loop.params.phase != phase)
+				continue;
+
+			if (loop.byFrames ? frames < loop.nextFrame : time < loop.nextTime)
+				continue;
+
+			float sinceLastCall = static_cast<float>(time - loop.lastCallTime);
+
+			int64_t callsBefore = apiCallTotal;
+			inFlightLoop = true;
+
+			auto start = std::chrono::steady_clock::now();
+			float next = loop.params.callbackFunc(sinceLastCall, sinceLastCall, static_cast<int>(frames), loop.params.refcon);
+			auto stop = std::chrono::steady_clock::now();
+
+			inFlightLoop = false;
+			loop.xplmCalls += apiCallTotal - callsBefore;
+
+			double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+			loop.callNs += ns;
+			if (ns > loop.maxCallNs)
+				loop.maxCallNs = ns;
+			++loop.calls;
+			loop.lastCallTime = time;
+
+			// the callback may have rescheduled or destroyed itself
+			if (!loop.destroyed && loop.scheduled)
+				scheduleFlightLoop(&loop, next, true);
+		}
+	}
+
+	FlightLoop* Runtime::createFlightLoop(const XPLMCreateFlightLoop_t& params)
+	{
+		loops.emplace_back();
+		loops.back().params = params;
+		return &loops.back();
+	}
+
+	void Runtime::scheduleFlightLoop(FlightLoop* loop, float interval, bool relativeToNow)
+	{
+		if (0 == interval)
+		{
+			loop->scheduled = false;
+			return;
+		}
+
+		if (!loop->scheduled)
+			loop->lastCallTime = time;
+
+		loop->scheduled = true;
+		loop->byFrames = interval < 0;
+		if (loop->byFrames)
+			loop->nextFrame = frames + static_cast<int64_t>(-interval);
+		else
+			loop->nextTime = (relativeToNow ? time : loop->lastCallTime) + interval;
+	}
+
+	bool Runtime::selectMenuItem(const std::string& menu, const std::string& item)
+	{
+		for (auto& m : menus)
+		{
+			if (m.destroyed || m.name != menu || nullptr == m.handler)
+				continue;
+
+			for (auto& i : m.items)
+			{
+				if (i.name == item)
+				{
+					m.handler(m.menuRef, i.itemRef);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool Runtime::commandOnce(const std::string& name)
+	{
+		Command* cmd = findCommand(name, false);
+		if (nullptr == cmd)
+			return false;
+
+		for (auto phase : { xplm_CommandBegin, xplm_CommandEnd })
+		{
+			for (auto& h : cmd->handlers)
+				h.callback(cmd, phase, h.refcon);
+		}
+		return true;
+	}
+
+	void Runtime::drawWindows()
+	{
+		for (auto& w : windows)
+		{
+			if (!w.destroyed && w.visible && w.params.drawWindowFunc)
+				w.params.drawWindowFunc(&w, w.params.refcon);
+		}
+	}
+
+	Command* Runtime::findCommand(const std::string& name, bool create)
+	{
+		for (auto& c : commands)
+		{
+			if (c.name == name)
+				return &c;
+		}
+
+		if (!create)
+			return nullptr;
+
+		commands.emplace_back();
+		commands.back().name = name;
+		return &commands.back();
+	}
+
+	Menu* Runtime::createMenu(const std::string& name, XPLMMenuHandler_f handler, void* menuRef)
+	{
+		menus.emplace_back();
+		menus.back().name = name;
+		menus.back().handler = handler;
+		menus.back().menuRef = menuRef;
+		return &menus.back();
+	}
+
+	Window* Runtime::createWindow(const XPLMCreateWindow_t& params)
+	{
+		windows.emplace_back();
+		windows.back().params = params;
+		windows.back().visible = params.visible != 0;
+		return &windows.back();
+	}
+
+	void Runtime::debugString(const char* str)
+	{
+		if (!quiet)
+			fputs(str, stderr);
+	}
+
+	DataRef* Runtime::find(const std::string& name)
+	{
+		auto it = datarefIndex.find(name);
+		return it == datarefIndex.end() ? nullptr : it->second;
+	}
+
+	DataRef* Runtime::define(const std::string& name, XPLMDataTypeID type, bool writable)
+	{
+		DataRef* ref = find(name);
+		if (nullptr == ref)
+		{
+			datarefs.emplace_back();
+			ref = &datarefs.back();
+			ref->name = name;
+			datarefIndex[name] = ref;
+		}
+
+		ref->types = type;
+		ref->writable = writable;
+		return ref;
+	}
+
+	float* Runtime::defineFloat(const std::string& name, float value, bool writable)
+	{
+		DataRef* ref = define(name, xplmType_Float | xplmType_Double, writable);
+		ref->floats.assign(1, value);
+		return ref->floats.data();
+	}
+
+	float* Runtime::defineFloatArray(const std::string& name, int size, bool writable)
+	{
+		DataRef* ref = define(name, xplmType_FloatArray, writable);
+		ref->floats.assign(size, 0.0f);
+		return ref->floats.data();
+	}
+
+	int* Runtime::defineInt(const std::string& name, int value, bool writable)
+	{
+		DataRef* ref = define(name, xplmType_Int, writable);
+		ref->ints.assign(1, value);
+		return ref->ints.data();
+	}
+
+	DataRef* Runtime::registerAccessor(const DataRef& accessor)
+	{
+		DataRef* ref = define(accessor.name, accessor.types, accessor.writable);
+		*ref = accessor;
+		ref->owned = true;
+		return ref;
+	}
+
+	float Runtime::getf(const std::string& name)
+	{
+		return XPLMGetDataf(find(name));
+	}
+
+	int Runtime::geti(const std::string& name)
+	{
+		return XPLMGetDatai(find(name));
+	}
+
+	int Runtime::getvf(const std::string& name, float* values, int count)
+	{
+		return XPLMGetDatavf(find(name), values, 0, count);
+	}
+
+	void Runtime::setf(const std::string& name, float value)
+	{
+		XPLMSetDataf(find(name), value);
+	}
+
+	void Runtime::seti(const std::string& name, int value)
+	{
+		XPLMSetDatai(find(name), value);
+	}
+}
@@ -0,0 +1,215 @@
+#ifndef HEADLESS_RUNTIME_H
+#define HEADLESS_RUNTIME_H
+
+#include <XPLMDataAccess.h>
+#include <XPLMDisplay.h>
+#include <XPLMMenus.h>
+#include <XPLMProcessing.h>
+#include <XPLMUtilities.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+///
+/// Headless stand-in for the parts of XPLM/XPWidgets the plugin uses
+/// (XPLMStub.cpp implements the API on top of this runtime).
+///
+/// The plugin is linked statically into the same executable; the runtime
+/// steps an AircraftModel with a fixed frame time and calls the flight loops
+/// that are due after every frame, as fast as the CPU allows.
+///
+
+namespace Headless
+{
+	class Runtime;
+
+	/// <summary>
+	/// Pluggable flight model. Reads its inputs from and publishes its state to
+	/// datarefs, like X-Plane does for the plugin.
+	/// </summary>
+	class AircraftModel
+	{
+	public:
+		virtual ~AircraftModel() = default;
+
+		/// aircraft file name without .acf, selects the plugin's <name>.ini
+		virtual std::string fileName() const = 0;
+		/// create the datarefs the model reads and writes
+		virtual void bind(Runtime& rt) = 0;
+		/// advance the model by dt seconds
+		virtual void step(double dt) = 0;
+	};
+
+	struct DataRef
+	{
+		std::string name;
+		XPLMDataTypeID types = xplmType_Unknown;
+		bool writable = true;
+
+		/// storage of sim datarefs; scalars live in element 0
+		std::vector<float> floats;
+		std::vector<int> ints;
+		double d = 0;
+
+		/// accessors of plugin-owned datarefs (XPLMRegisterDataAccessor)
+		bool owned = false;
+		XPLMGetDatai_f readInt = nullptr;
+		XPLMSetDatai_f writeInt = nullptr;
+		XPLMGetDataf_f readFloat = nullptr;
+		XPLMSetDataf_f writeFloat = nullptr;
+		XPLMGetDatad_f readDouble = nullptr;
+		XPLMSetDatad_f writeDouble = nullptr;
+		XPLMGetDatavi_f readIntArray = nullptr;
+		XPLMSetDatavi_f writeIntArray = nullptr;
+		XPLMGetDatavf_f readFloatArray = nullptr;
+		XPLMSetDatavf_f writeFloatArray = nullptr;
+		void* readRefcon = nullptr;
+		void* writeRefcon = nullptr;
+	};
+
+	struct FlightLoop
+	{
+		XPLMCreateFlightLoop_t params{};
+		bool scheduled = false;
+		bool destroyed = false;
+		double nextTime = 0;		/// interval > 0: due time in sim seconds
+		int64_t nextFrame = 0;		/// interval < 0: due frame
+		bool byFrames = false;
+		double lastCallTime = 0;
+		int64_t calls = 0;
+		double callNs = 0;			/// wall time spent in the callback
+		double maxCallNs = 0;
+		int64_t xplmCalls = 0;		/// XPLM API calls made by the callback
+	};
+
+	struct Command
+	{
+		struct Handler
+		{
+			XPLMCommandCallback_f callback;
+			int before;
+			void* refcon;
+		};
+
+		std::string name;
+		std::string description;
+		std::vector<Handler> handlers;
+	};
+
+	struct Menu
+	{
+		struct Item
+		{
+			std::string name;
+			void* itemRef;
+		};
+
+		std::string name;
+		XPLMMenuHandler_f handler = nullptr;
+		void* menuRef = nullptr;
+		std::vector<Item> items;
+		bool destroyed = false;
+	};
+
+	struct Window
+	{
+		XPLMCreateWindow_t params{};
+		bool visible = false;
+		bool destroyed = false;
+	};
+
+	class Runtime
+	{
+	public:
+		static Runtime& instance();
+
+		void setAircraft(std::unique_ptr<AircraftModel> model);
+		AircraftModel* aircraft() const { return model.get(); }
+		void setPluginDir(const std::string& dir) { pluginDir = dir; }
+		const std::string& getPluginDir() const { return pluginDir; }
+		void setFrameTime(double dt) { frameTime = dt; }
+		void setQuiet(bool q) { quiet = q; }
+		bool isQuiet() const { return quiet; }
+
+		/// plugin life cycle, calls the PLUGIN_API entry points
+		bool startPlugin();
+		void loadAircraft();
+		void stopPlugin();
+
+		/// runs frames until the sim time advanced by the given seconds
+		void run(double seconds);
+		double simTime() const { return time; }
+		int64_t frameCount() const { return frames; }
+
+		/// user interaction
+		bool selectMenuItem(const std::string& menu, const std::string& item);
+		bool commandOnce(const std::string& name);
+		void drawWindows();
+
+		/// datarefs; define* create sim-owned datarefs and return their storage
+		DataRef* find(const std::string& name);
+		float* defineFloat(const std::string& name, float value = 0, bool writable = true);
+		float* defineFloatArray(const std::string& name, int size, bool writable = true);
+		int* defineInt(const std::string& name, int value = 0, bool writable = true);
+		float getf(const std::string& name);
+		int geti(const std::string& name);
+		int getvf(const std::string& name, float* values, int count);
+		void setf(const std::string& name, float value);
+		void seti(const std::string& name, int value);
+
+		/// used by XPLMStub.cpp
+		DataRef* registerAccessor(const DataRef& accessor);
+		FlightLoop* createFlightLoop(const XPLMCreateFlightLoop_t& params);
+		void scheduleFlightLoop(FlightLoop* loop, float interval, bool relativeToNow);
+		Command* findCommand(const std::string& name, bool create);
+		Menu* pluginsMenu() { return &menus.front(); }
+		Menu* createMenu(const std::string& name, XPLMMenuHandler_f handler, void* menuRef);
+		Window* createWindow(const XPLMCreateWindow_t& params);
+		void debugString(const char* str);
+
+		const std::deque<FlightLoop>& flightLoops() const { return loops; }
+
+		/// XPLM API calls made from flight loop callbacks, by function name
+		int64_t& apiCallCounter(const char* function) { return apiCallCount[function]; }
+		void countApiCall(int64_t& counter)
+		{
+			if (inFlightLoop)
+				++counter, ++apiCallTotal;
+		}
+		const std::map<std::string, int64_t>& apiCalls() const { return apiCallCount; }
+		std::string aircraftFileName() const;
+
+	private:
+		Runtime();
+
+		DataRef* define(const std::string& name, XPLMDataTypeID type, bool writable);
+		void callFlightLoops(int phase);
+
+		std::unique_ptr<AircraftModel> model;
+		std::string pluginDir = ".";
+		double frameTime = 1.0 / 30.0;
+		bool quiet = false;
+
+		double time = 0;
+		int64_t frames = 0;
+		float* timeRef = nullptr;
+
+		bool inFlightLoop = false;
+		int64_t apiCallTotal = 0;
+		std::map<std::string, int64_t> apiCallCount;	/// node based, counters stay put
+
+		/// deques keep the addresses handed out as XPLM ids stable
+		std::map<std::string, DataRef*> datarefIndex;
+		std::deque<DataRef> datarefs;
+		std::deque<FlightLoop> loops;
+		std::deque<Command> commands;
+		std::deque<Menu> menus;
+		std::deque<Window> windows;
+	};
+}
+
+#endif
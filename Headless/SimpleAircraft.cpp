@@ -0,0 +1,222 @@
+#include "SimpleAircraft.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Headless
+{
+	namespace
+	{
+		const float MsPerKt = 0.514444f;
+		const float Gravity = 9.80665f;
+	}
+
+	SimpleAircraft::Params SimpleAircraft::C90B()
+	{
+		// trims at ~0.6 throttle for 180 kts
+		return { "C90B", 4500.0f, 9000.0f, 0.63f, 1.5f, 150.0f, 0.5f, 2, 2230.0f, 52.0f, 0.0f,
+			520.0f, 760.0f, 2.0f, 695.0f, 1315.0f, 101.5f };
+	}
+
+	SimpleAircraft::Params SimpleAircraft::CitationX()
+	{
+		// trims at ~0.6 throttle for 250 kts
+		return { "Cessna_CitationX", 16000.0f, 57000.0f, 2.07f, 2.5f, 220.0f, 0.5f, 2, 0.0f, 46.0f, 0.0f,
+			480.0f, 1010.0f, 3.0f, 948.0f, 0.0f, 100.0f };
+	}
+
+	SimpleAircraft::Params SimpleAircraft::byName(const std::string& fileName)
+	{
+		if (fileName == "Cessna_CitationX")
+			return CitationX();
+		return C90B();
+	}
+
+	void SimpleAircraft::setSpeedModel(const SpeedModelPlant::Params& m)
+	{
+		useModel = true;
+		model = m;
+
+		// trimmed on the model at the initial speed
+		float trim = m.gain > 0 ? (m.damping * params.initialIas - m.offset) / m.gain : params.initialThrottle;
+		params.initialThrottle = trim < 0 ? 0 : (trim > 1 ? 1 : trim);
+	}
+
+	void SimpleAircraft::atmosphere(float altitude, float& sigma, float& soundSpeed)
+	{
+		// troposphere to 11 km, isothermal above
+		const float T0 = 288.15f, lapse = 0.0065f, tropopause = 11000.0f;
+		float h = altitude < 0 ? 0 : altitude;
+		float T = h < tropopause ? T0 - lapse * h : T0 - lapse * tropopause;
+		sigma = std::pow(T / T0, 4.2559f);
+		if (h > tropopause)
+			sigma *= std::exp(-(h - tropopause) / 6341.6f);
+		soundSpeed = std::sqrt(1.4f * 287.053f * T);
+	}
+
+	void SimpleAircraft::bind(Runtime& rt)
+	{
+		float sigma, soundSpeed;
+		atmosphere(startAgl, sigma, soundSpeed);
+		tas = params.initialIas * MsPerKt / std::sqrt(sigma);
+
+		throttleAll = rt.defineFloat("sim/cockpit2/engine/actuators/throttle_ratio_all", params.initialThrottle);
+		lastThrottleAll = params.initialThrottle;
+		throttle = rt.defineFloatArray("sim/cockpit2/engine/actuators/throttle_ratio", MaxEngines);
+		n1 = rt.defineFloatArray("sim/flightmodel/engine/ENGN_N1_", MaxEngines, false);
+		torque = rt.defineFloatArray("sim/cockpit2/engine/indicators/torque_n_mtr", MaxEngines, false);
+		itt = rt.defineFloatArray("sim/cockpit2/engine/indicators/ITT_deg_C", MaxEngines, false);
+		rt.defineFloat("sim/aircraft/limits/red_hi_ITT", params.redItt, false);
+		rt.defineFloat("sim/aircraft/limits/red_hi_TRQ", params.redTorque, false);
+		rt.defineFloat("sim/aircraft/limits/red_hi_N1", params.redN1, false);
+		rt.defineInt("sim/aircraft/engine/acf_num_engines", params.engines, false);
+		ias = rt.defineFloat("sim/cockpit2/gauges/indicators/airspeed_kts_pilot", params.initialIas, false);
+		rt.defineFloat("sim/cockpit2/autopilot/airspeed_dial_kts", params.initialIas);
+		agl = rt.defineFloat("sim/flightmodel/position/y_agl", startAgl, false);
+		vs = rt.defineFloat("sim/flightmodel/position/vh_ind_fpm", 0, false);
+		onGround = rt.defineInt("sim/flightmodel/failures/onground_any", startAgl > 0 ? 0 : 1, false);
+		gearDown = rt.defineInt("sim/cockpit2/controls/gear_handle_down", 0);
+		// airfield at sea level, standard day
+		pressureAltitude = rt.defineFloat("sim/flightmodel2/position/pressure_altitude", startAgl / MPerFt, false);
+		rt.defineFloat("sim/flightmodel/weight/m_total", params.mass, false);
+		mach = rt.defineFloat("sim/flightmodel/misc/machno", tas / soundSpeed, false);
+		// X-Plane converts the dial when airspeed_is_mach is toggled, here the writer has to
+		rt.defineFloat("sim/cockpit2/autopilot/airspeed_dial_kts_mach", params.initialIas);
+		rt.defineInt("sim/cockpit2/autopilot/airspeed_is_mach", 0);
+		trueAirspeed = rt.defineFloat("sim/flightmodel/position/true_airspeed", tas, false);
+		groundspeed = rt.defineFloat("sim/flightmodel/position/groundspeed", tas, false);
+		localVx = rt.defineFloat("sim/flightmodel/position/local_vx", tas, false);
+		rt.defineFloat("sim/flightmodel/position/local_vz", 0, false);
+		localAx = rt.defineFloat("sim/flightmodel/position/local_ax", 0, false);
+		rt.defineFloat("sim/flightmodel/position/local_az", 0, false);
+		noiselessIas = params.initialIas;
+
+		for (int i = 0; i < params.engines; ++i)
+		{
+			spool[i] = params.initialThrottle;
+			throttle[i] = params.initialThrottle;
+			ittState[i] = ittTarget(i);
+		}
+		updateIndicators();
+	}
+
+	float SimpleAircraft::enginePower(int i) const
+	{
+		return i == params.engines - 1 ? spool[i] * (1.0f - params.asymmetry) : spool[i];
+	}
+
+	float SimpleAircraft::ittTarget(int i) const
+	{
+		return params.ittIdle + (params.ittFull - params.ittIdle) * enginePower(i);
+	}
+
+	void SimpleAircraft::updateIndicators()
+	{
+		for (int i = 0; i < params.engines; ++i)
+		{
+			n1[i] = params.idleN1 + (100.0f - params.idleN1) * enginePower(i);
+			torque[i] = params.maxTorque * enginePower(i);
+			itt[i] = ittState[i];
+		}
+	}
+
+	void SimpleAircraft::step(double dt)
+	{
+		float h = static_cast<float>(dt);
+
+		// like X-Plane: writing throttle_ratio_all moves every lever,
+		// throttle_ratio_all reads back the mean
+		if (*throttleAll != lastThrottleAll)
+		{
+			for (int i = 0; i < params.engines; ++i)
+				throttle[i] = *throttleAll;
+		}
+
+		// the model's dead time: the spools get the levers of deadTime ago
+		time += dt;
+		const float* delayed = throttle;
+		if (useModel && model.deadTime > 0)
+		{
+			Levers now{ time, {} };
+			std::copy(throttle, throttle + MaxEngines, now.lever);
+			leverHistory.push_back(now);
+			while (leverHistory.size() > 1 && leverHistory[1].time <= time - model.deadTime)
+				leverHistory.pop_front();
+			delayed = leverHistory.front().time <= time - model.deadTime ? leverHistory.front().lever : nullptr;
+		}
+
+		float thrust = 0;
+		float levers = 0;
+		float power = 0;
+		float spoolTau = useModel ? model.spoolTau : params.spoolTau;
+		for (int i = 0; i < params.engines; ++i)
+		{
+			// before the first lever is deadTime old the spools hold the initial trim
+			float lever = delayed ? delayed[i] : params.initialThrottle;
+			float cmd = lever < 0 ? 0 : (lever > 1 ? 1 : lever);
+			spool[i] += (cmd - spool[i]) * h / (spoolTau + h);
+			ittState[i] += (ittTarget(i) - ittState[i]) * h / (params.ittTau + h);
+			thrust += params.maxThrust / params.engines * enginePower(i);
+			power += enginePower(i) / params.engines;
+			levers += throttle[i];
+		}
+		travel += std::fabs(levers / params.engines - lastThrottleAll);
+		*throttleAll = lastThrottleAll = levers / params.engines;
+		updateIndicators();
+
+		// commanded vertical speed, nothing below the ground
+		float climb = vsCommand / 60.0f * MPerFt;
+		if (*onGround && climb < 0)
+			climb = 0;
+		*agl += climb * h;
+		if (*agl <= 0)
+		{
+			*agl = 0;
+			climb = 0;
+		}
+		*onGround = *agl <= 0 ? 1 : 0;
+		*vs = climb * 60.0f / MPerFt;
+		*pressureAltitude = *agl / MPerFt;
+
+		// drag on equivalent airspeed
+		float sigma, soundSpeed;
+		atmosphere(*agl, sigma, soundSpeed);
+		float eas = tas * std::sqrt(sigma);
+		float drag = params.dragFactor * (1.0f + extraDrag) * eas * eas;
+		float slope = tas > 1.0f ? climb / tas : 0.0f;
+		if (slope > 1.0f || slope < -1.0f)
+			slope = slope > 0 ? 1.0f : -1.0f;
+		float lastTas = tas;
+		if (useModel)
+		{
+			// the model is in IAS; implicit in the damping like SpeedModelPlant
+			float v = eas / MsPerKt;
+			v = (v + (model.gain * power + model.offset - Gravity * slope / MsPerKt) * h) / (1.0f + model.damping * (1.0f + extraDrag) * h);
+			tas = v * MsPerKt / std::sqrt(sigma);
+		} else
+			tas += ((thrust - drag) / params.mass - Gravity * slope) * h;
+		if (tas < 0)
+			tas = 0;
+
+		// no compressibility error, noise on the indicator only
+		noiselessIas = tas * std::sqrt(sigma) / MsPerKt;
+		*ias = noiselessIas;
+		if (iasNoise > 0)
+			*ias = std::round((noiselessIas + std::normal_distribution<float>{ 0.0f, iasNoise }(noise)) * 10.0f) / 10.0f;
+		*mach = tas / soundSpeed;
+
+		// due east into the headwind
+		float horizontal = std::sqrt(1.0f - slope * slope);
+		*trueAirspeed = tas;
+		*localAx = h > 0 ? (tas - lastTas) * horizontal / h : 0.0f;
+		*groundspeed = *localVx = tas * horizontal - headwind;
+	}
+
+	void SimpleAircraft::setHeadwind(float kts)
+	{
+		// the aircraft keeps its groundspeed, the airspeed takes the change
+		float change = kts * MsPerKt - headwind;
+		headwind = kts * MsPerKt;
+		tas = tas + change > 0 ? tas + change : 0.0f;
+	}
+}
@@ -0,0 +1,142 @@
+#ifndef HEADLESS_SIMPLE_AIRCRAFT_H
+#define HEADLESS_SIMPLE_AIRCRAFT_H
+
+#include "HeadlessRuntime.h"
+#include "../PlantModel.h"
+
+#include <deque>
+#include <random>
+
+namespace Headless
+{
+	/// <summary>
+	/// Longitudinal point mass: engine spool lag on the throttle, thrust against
+	/// quadratic drag, level flight. Enough to close the speed loop; parameters
+	/// are rough figures for the two airframes the plugin has configs for.
+	/// Each engine spools on its own lever (throttle_ratio[]), the last one can
+	/// be rigged weak by 'asymmetry' to exercise per-engine trimming.
+	/// The vertical path is flown as commanded by setVerticalSpeed(), the
+	/// climb angle takes its share of the weight off the thrust. IAS and Mach
+	/// follow from TAS in the standard atmosphere; thrust does not lapse.
+	/// The aircraft flies east; setHeadwind() changes the wind at once, so the
+	/// airspeed steps by the change and the groundspeed does not (a gust
+	/// front), setExtraDrag() scales the drag (gear, flaps, spoilers).
+	/// setIasNoise() adds Gaussian noise and 0.1 kt quantisation to the
+	/// airspeed indicator only.
+	/// setSpeedModel() flies an identified model (PlantModel.h) instead: the
+	/// levers reach the spools after its dead time, the spools follow with its
+	/// lag and the IAS with its gain, damping and offset; the climb angle still
+	/// takes its share of the weight. The start is trimmed on the model.
+	/// </summary>
+	class SimpleAircraft : public AircraftModel
+	{
+	public:
+		struct Params
+		{
+			std::string fileName;
+			float mass;				/// kg
+			float maxThrust;		/// N, all engines
+			float dragFactor;		/// N / (m/s)^2
+			float spoolTau;			/// s, first order engine lag
+			float initialIas;		/// kts
+			float initialThrottle;
+			int engines;
+			float maxTorque;		/// N m, per engine
+			float idleN1;			/// %
+			float asymmetry;		/// power deficit of the last engine, 0..1
+			float ittIdle;			/// deg C
+			float ittFull;			/// deg C at full power, above the redline on purpose
+			float ittTau;			/// s, thermal lag
+			float redItt;			/// sim/aircraft/limits/red_hi_*, 0 = none
+			float redTorque;		/// ft-lb, as Plane Maker gives it
+			float redN1;
+		};
+
+		static Params C90B();
+		static Params CitationX();
+		/// parameters by aircraft file name, C90B for unknown names
+		static Params byName(const std::string& fileName);
+
+		explicit SimpleAircraft(const Params& p) : params(p)
+		{
+			if (params.engines < 1 || params.engines > MaxEngines)
+				params.engines = params.engines < 1 ? 1 : MaxEngines;
+		}
+
+		std::string fileName() const override { return params.fileName; }
+		void bind(Runtime& rt) override;
+		void step(double dt) override;
+		void setAsymmetry(float a) { params.asymmetry = a; }
+		/// height above ground at the start, ft
+		void setAltitude(float ft) { startAgl = ft * MPerFt; }
+		/// ft/min, applied from the next step; on the ground only climbs are flown
+		void setVerticalSpeed(float fpm) { vsCommand = fpm; }
+		void setGearDown(bool down) { if (gearDown) *gearDown = down ? 1 : 0; }
+		/// headwind from now on, kts true; negative for a tailwind
+		void setHeadwind(float kts);
+		/// drag times 1 + fraction from now on, on the speed model its damping
+		void setExtraDrag(float fraction) { extraDrag = fraction; }
+		/// standard deviation of the indicated airspeed noise, kts
+		void setIasNoise(float kts) { iasNoise = kts; }
+		/// replaces thrust and drag, call before bind()
+		void setSpeedModel(const SpeedModelPlant::Params& m);
+		/// IAS without instrument noise, kts
+		float trueIas() const { return noiselessIas; }
+		/// summed movement of the mean lever, a measure of throttle activity
+		float leverTravel() const { return travel; }
+
+	private:
+		static const int MaxEngines = 8;
+		static constexpr float MPerFt = 0.3048f;
+
+		Params params;
+		float spool[MaxEngines] = {};	/// engine output 0..1
+		float ittState[MaxEngines] = {};
+		float tas = 0;					/// m/s
+		float startAgl = 5000 * MPerFt;	/// m
+		float vsCommand = 0;			/// ft/min
+		float iasNoise = 0;				/// kts
+		float headwind = 0;				/// m/s
+		float extraDrag = 0;
+		float noiselessIas = 0;			/// kts
+		float travel = 0;
+		std::mt19937 noise{ 1 };		/// fixed seed, runs repeat
+
+		struct Levers
+		{
+			double time;
+			float lever[MaxEngines];
+		};
+		bool useModel = false;
+		SpeedModelPlant::Params model = {};
+		std::deque<Levers> leverHistory;	/// model dead time, oldest first
+		double time = 0;
+
+		float* throttleAll = nullptr;
+		float lastThrottleAll = 0;
+		float* throttle = nullptr;		/// [MaxEngines]
+		float* n1 = nullptr;
+		float* torque = nullptr;
+		float* itt = nullptr;
+		float* ias = nullptr;
+		float* agl = nullptr;			/// m
+		float* vs = nullptr;			/// ft/min
+		int* onGround = nullptr;
+		int* gearDown = nullptr;
+		float* pressureAltitude = nullptr;	/// ft
+		float* mach = nullptr;
+		float* trueAirspeed = nullptr;	/// m/s
+		float* groundspeed = nullptr;	/// m/s
+		float* localVx = nullptr;		/// m/s, east
+		float* localAx = nullptr;		/// m/s^2
+
+		/// ISA density ratio and speed of sound [m/s] at an altitude [m]
+		static void atmosphere(float altitude, float& sigma, float& soundSpeed);
+
+		float enginePower(int i) const;
+		void updateIndicators();
+		float ittTarget(int i) const;
+	};
+}
+
+#endif
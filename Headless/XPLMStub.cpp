@@ -0,0 +1,610 @@
+// XPLMStub.cpp : headless implementation of the XPLM/XPWidgets API used by the plugin.
+//
+// Everything is forwarded to Headless::Runtime. Drawing and widget calls are
+// accepted and ignored; there is no screen.
+
+#include <XPLMDataAccess.h>
+#include <XPLMDisplay.h>
+#include <XPLMGraphics.h>
+#include <XPLMMenus.h>
+#include <XPLMPlanes.h>
+#include <XPLMPlugin.h>
+#include <XPLMProcessing.h>
+#include <XPLMUtilities.h>
+#include <XPWidgets.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "HeadlessRuntime.h"
+
+using Headless::Runtime;
+
+namespace
+{
+	Headless::DataRef* ref(XPLMDataRef r)
+	{
+		return static_cast<Headless::DataRef*>(r);
+	}
+
+	void copyString(char* dst, size_t size, const std::string& src)
+	{
+		if (nullptr != dst)
+			snprintf(dst, size, "%s", src.c_str());
+	}
+
+	float getFloat(Headless::DataRef* r)
+	{
+		if (nullptr == r)
+			return 0;
+		if (r->owned)
+			return r->readFloat ? r->readFloat(r->readRefcon) : 0;
+		if (!r->floats.empty())
+			return r->floats[0];
+		return r->ints.empty() ? static_cast<float>(r->d) : static_cast<float>(r->ints[0]);
+	}
+
+	void setFloat(Headless::DataRef* r, float value)
+	{
+		if (nullptr == r || !r->writable)
+			return;
+		if (r->owned)
+		{
+			if (r->writeFloat)
+				r->writeFloat(r->writeRefcon, value);
+		} else if (!r->floats.empty())
+			r->floats[0] = value;
+		else if (!r->ints.empty())
+			r->ints[0] = static_cast<int>(value);
+	}
+
+	const int PluginId = 1;
+}
+
+/// every API function starts with this; calls made from flight loop
+/// callbacks are counted per function, see Runtime::apiCalls()
+#define COUNT_XPLM_CALL() \
+	static int64_t& callCount = Runtime::instance().apiCallCounter(__func__); \
+	Runtime::instance().countApiCall(callCount)
+
+/*
+* Data access
+*/
+XPLMDataRef XPLMFindDataRef(const char* inDataRefName)
+{
+	COUNT_XPLM_CALL();
+	return Runtime::instance().find(inDataRefName);
+}
+
+int XPLMCanWriteDataRef(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	return inDataRef && ref(inDataRef)->writable;
+}
+
+int XPLMIsDataRefGood(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	return inDataRef != nullptr;
+}
+
+XPLMDataTypeID XPLMGetDataRefTypes(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	return inDataRef ? ref(inDataRef)->types : xplmType_Unknown;
+}
+
+int XPLMGetDatai(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r)
+		return 0;
+	if (r->owned)
+		return r->readInt ? r->readInt(r->readRefcon) : 0;
+	if (!r->ints.empty())
+		return r->ints[0];
+	return r->floats.empty() ? static_cast<int>(r->d) : static_cast<int>(r->floats[0]);
+}
+
+void XPLMSetDatai(XPLMDataRef inDataRef, int inValue)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r || !r->writable)
+		return;
+	if (r->owned)
+	{
+		if (r->writeInt)
+			r->writeInt(r->writeRefcon, inValue);
+	} else if (!r->ints.empty())
+		r->ints[0] = inValue;
+	else if (!r->floats.empty())
+		r->floats[0] = static_cast<float>(inValue);
+}
+
+float XPLMGetDataf(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	return getFloat(ref(inDataRef));
+}
+
+void XPLMSetDataf(XPLMDataRef inDataRef, float inValue)
+{
+	COUNT_XPLM_CALL();
+	setFloat(ref(inDataRef), inValue);
+}
+
+double XPLMGetDatad(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr != r && r->owned && r->readDouble)
+		return r->readDouble(r->readRefcon);
+	return getFloat(r);
+}
+
+void XPLMSetDatad(XPLMDataRef inDataRef, double inValue)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr != r && r->owned && r->writeDouble)
+		r->writeDouble(r->writeRefcon, inValue);
+	else
+		setFloat(r, static_cast<float>(inValue));
+}
+
+int XPLMGetDatavf(XPLMDataRef inDataRef, float* outValues, int inOffset, int inMax)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r)
+		return 0;
+	if (r->owned)
+		return r->readFloatArray ? r->readFloatArray(r->readRefcon, outValues, inOffset, inMax) : 0;
+
+	int size = static_cast<int>(r->floats.size());
+	if (nullptr == outValues)
+		return size;
+
+	int n = 0;
+	for (; n < inMax && inOffset + n < size; ++n)
+		outValues[n] = r->floats[inOffset + n];
+	return n;
+}
+
+void XPLMSetDatavf(XPLMDataRef inDataRef, float* inValues, int inOffset, int inCount)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r || !r->writable)
+		return;
+	if (r->owned)
+	{
+		if (r->writeFloatArray)
+			r->writeFloatArray(r->writeRefcon, inValues, inOffset, inCount);
+		return;
+	}
+
+	int size = static_cast<int>(r->floats.size());
+	for (int n = 0; n < inCount && inOffset + n < size; ++n)
+		r->floats[inOffset + n] = inValues[n];
+}
+
+int XPLMGetDatavi(XPLMDataRef inDataRef, int* outValues, int inOffset, int inMax)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r)
+		return 0;
+	if (r->owned)
+		return r->readIntArray ? r->readIntArray(r->readRefcon, outValues, inOffset, inMax) : 0;
+
+	int size = static_cast<int>(r->ints.size());
+	if (nullptr == outValues)
+		return size;
+
+	int n = 0;
+	for (; n < inMax && inOffset + n < size; ++n)
+		outValues[n] = r->ints[inOffset + n];
+	return n;
+}
+
+void XPLMSetDatavi(XPLMDataRef inDataRef, int* inValues, int inOffset, int inCount)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r || !r->writable)
+		return;
+	if (r->owned)
+	{
+		if (r->writeIntArray)
+			r->writeIntArray(r->writeRefcon, inValues, inOffset, inCount);
+		return;
+	}
+
+	int size = static_cast<int>(r->ints.size());
+	for (int n = 0; n < inCount && inOffset + n < size; ++n)
+		r->ints[inOffset + n] = inValues[n];
+}
+
+XPLMDataRef XPLMRegisterDataAccessor(const char* inDataName, XPLMDataTypeID inDataType, int inIsWritable,
+	XPLMGetDatai_f inReadInt, XPLMSetDatai_f inWriteInt,
+	XPLMGetDataf_f inReadFloat, XPLMSetDataf_f inWriteFloat,
+	XPLMGetDatad_f inReadDouble, XPLMSetDatad_f inWriteDouble,
+	XPLMGetDatavi_f inReadIntArray, XPLMSetDatavi_f inWriteIntArray,
+	XPLMGetDatavf_f inReadFloatArray, XPLMSetDatavf_f inWriteFloatArray,
+	XPLMGetDatab_f inReadData, XPLMSetDatab_f inWriteData,
+	void* inReadRefcon, void* inWriteRefcon)
+{
+	COUNT_XPLM_CALL();
+	Headless::DataRef accessor;
+	accessor.name = inDataName;
+	accessor.types = inDataType;
+	accessor.writable = inIsWritable != 0;
+	accessor.readInt = inReadInt;
+	accessor.writeInt = inWriteInt;
+	accessor.readFloat = inReadFloat;
+	accessor.writeFloat = inWriteFloat;
+	accessor.readDouble = inReadDouble;
+	accessor.writeDouble = inWriteDouble;
+	accessor.readIntArray = inReadIntArray;
+	accessor.writeIntArray = inWriteIntArray;
+	accessor.readFloatArray = inReadFloatArray;
+	accessor.writeFloatArray = inWriteFloatArray;
+	accessor.readRefcon = inReadRefcon;
+	accessor.writeRefcon = inWriteRefcon;
+	(void)inReadData;
+	(void)inWriteData;
+
+	return Runtime::instance().registerAccessor(accessor);
+}
+
+void XPLMUnregisterDataAccessor(XPLMDataRef inDataRef)
+{
+	COUNT_XPLM_CALL();
+	auto r = ref(inDataRef);
+	if (nullptr == r)
+		return;
+
+	std::string name = r->name;
+	*r = Headless::DataRef{};
+	r->name = name;
+}
+
+/*
+* Processing
+*/
+float XPLMGetElapsedTime(void)
+{
+	COUNT_XPLM_CALL();
+	return static_cast<float>(Runtime::instance().simTime());
+}
+
+XPLMFlightLoopID XPLMCreateFlightLoop(XPLMCreateFlightLoop_t* inParams)
+{
+	COUNT_XPLM_CALL();
+	return Runtime::instance().createFlightLoop(*inParams);
+}
+
+void XPLMDestroyFlightLoop(XPLMFlightLoopID inFlightLoopID)
+{
+	COUNT_XPLM_CALL();
+	auto loop = static_cast<Headless::FlightLoop*>(inFlightLoopID);
+	if (nullptr != loop)
+	{
+		loop->scheduled = false;
+		loop->destroyed = true;
+	}
+}
+
+void XPLMScheduleFlightLoop(XPLMFlightLoopID inFlightLoopID, float inInterval, int inRelativeToNow)
+{
+	COUNT_XPLM_CALL();
+	auto loop = static_cast<Headless::FlightLoop*>(inFlightLoopID);
+	if (nullptr != loop && !loop->destroyed)
+		Runtime::instance().scheduleFlightLoop(loop, inInterval, inRelativeToNow != 0);
+}
+
+/*
+* Utilities and commands
+*/
+void XPLMDebugString(const char* inString)
+{
+	COUNT_XPLM_CALL();
+	Runtime::instance().debugString(inString);
+}
+
+void XPLMEnableFeature(const char* inFeature, int inEnable)
+{
+	COUNT_XPLM_CALL();
+	(void)inFeature;
+	(void)inEnable;
+}
+
+void XPLMGetSystemPath(char* outSystemPath)
+{
+	COUNT_XPLM_CALL();
+	copyString(outSystemPath, 512, Runtime::instance().getPluginDir() + "/");
+}
+
+XPLMCommandRef XPLMFindCommand(const char* inName)
+{
+	COUNT_XPLM_CALL();
+	return Runtime::instance().findCommand(inName, false);
+}
+
+XPLMCommandRef XPLMCreateCommand(const char* inName, const char* inDescription)
+{
+	COUNT_XPLM_CALL();
+	auto cmd = Runtime::instance().findCommand(inName, true);
+	cmd->description = inDescription;
+	return cmd;
+}
+
+void XPLMCommandBegin(XPLMCommandRef inCommand)
+{
+	COUNT_XPLM_CALL();
+	auto cmd = static_cast<Headless::Command*>(inCommand);
+	for (auto& h : cmd->handlers)
+		h.callback(inCommand, xplm_CommandBegin, h.refcon);
+}
+
+void XPLMCommandEnd(XPLMCommandRef inCommand)
+{
+	COUNT_XPLM_CALL();
+	auto cmd = static_cast<Headless::Command*>(inCommand);
+	for (auto& h : cmd->handlers)
+		h.callback(inCommand, xplm_CommandEnd, h.refcon);
+}
+
+void XPLMCommandOnce(XPLMCommandRef inCommand)
+{
+	COUNT_XPLM_CALL();
+	XPLMCommandBegin(inCommand);
+	XPLMCommandEnd(inCommand);
+}
+
+void XPLMRegisterCommandHandler(XPLMCommandRef inComand, XPLMCommandCallback_f inHandler, int inBefore, void* inRefcon)
+{
+	COUNT_XPLM_CALL();
+	auto cmd = static_cast<Headless::Command*>(inComand);
+	if (nullptr != cmd)
+		cmd->handlers.push_back({ inHandler, inBefore, inRefcon });
+}
+
+void XPLMUnregisterCommandHandler(XPLMCommandRef inComand, XPLMCommandCallback_f inHandler, int inBefore, void* inRefcon)
+{
+	COUNT_XPLM_CALL();
+	auto cmd = static_cast<Headless::Command*>(inComand);
+	if (nullptr == cmd)
+		return;
+
+	for (auto it = cmd->handlers.begin(); it != cmd->handlers.end(); ++it)
+	{
+		if (it->callback == inHandler && it->before == inBefore && it->refcon == inRefcon)
+		{
+			cmd->handlers.erase(it);
+			break;
+		}
+	}
+}
+
+/*
+* Plugins and planes
+*/
+XPLMPluginID XPLMGetMyID(void)
+{
+	COUNT_XPLM_CALL();
+	return PluginId;
+}
+
+void XPLMGetPluginInfo(XPLMPluginID inPlugin, char* outName, char* outFilePath, char* outSignature, char* outDescription)
+{
+	COUNT_XPLM_CALL();
+	(void)inPlugin;
+	copyString(outName, 256, "AutoThrottle");
+	copyString(outFilePath, 256, Runtime::instance().getPluginDir() + "/AutoThrottle.xpl");
+	copyString(outSignature, 256, "com.v8judd.AutoThrottle");
+	copyString(outDescription, 256, "headless");
+}
+
+void XPLMGetNthAircraftModel(int inIndex, char* outFileName, char* outPath)
+{
+	COUNT_XPLM_CALL();
+	std::string file = 0 == inIndex ? Runtime::instance().aircraftFileName() : std::string{};
+	copyString(outFileName, 256, file);
+	copyString(outPath, 512, file.empty() ? file : Runtime::instance().getPluginDir() + "/" + file);
+}
+
+/*
+* Menus
+*/
+XPLMMenuID XPLMFindPluginsMenu(void)
+{
+	COUNT_XPLM_CALL();
+	return Runtime::instance().pluginsMenu();
+}
+
+XPLMMenuID XPLMCreateMenu(const char* inName, XPLMMenuID inParentMenu, int inParentItem, XPLMMenuHandler_f inHandler, void* inMenuRef)
+{
+	COUNT_XPLM_CALL();
+	(void)inParentMenu;
+	(void)inParentItem;
+	return Runtime::instance().createMenu(inName, inHandler, inMenuRef);
+}
+
+void XPLMDestroyMenu(XPLMMenuID inMenuID)
+{
+	COUNT_XPLM_CALL();
+	auto menu = static_cast<Headless::Menu*>(inMenuID);
+	if (nullptr != menu)
+		menu->destroyed = true;
+}
+
+int XPLMAppendMenuItem(XPLMMenuID inMenu, const char* inItemName, void* inItemRef, int inDeprecatedAndIgnored)
+{
+	COUNT_XPLM_CALL();
+	(void)inDeprecatedAndIgnored;
+	auto menu = static_cast<Headless::Menu*>(inMenu);
+	menu->items.push_back({ inItemName, inItemRef });
+	return static_cast<int>(menu->items.size()) - 1;
+}
+
+void XPLMAppendMenuSeparator(XPLMMenuID inMenu)
+{
+	COUNT_XPLM_CALL();
+	auto menu = static_cast<Headless::Menu*>(inMenu);
+	menu->items.push_back({ "", nullptr });
+}
+
+void XPLMSetMenuItemName(XPLMMenuID inMenu, int inIndex, const char* inItemName, int inDeprecatedAndIgnored)
+{
+	COUNT_XPLM_CALL();
+	(void)inDeprecatedAndIgnored;
+	auto menu = static_cast<Headless::Menu*>(inMenu);
+	if (inIndex >= 0 && inIndex < static_cast<int>(menu->items.size()))
+		menu->items[inIndex].name = inItemName;
+}
+
+void XPLMCheckMenuItem(XPLMMenuID inMenu, int index, XPLMMenuCheck inCheck)
+{
+	COUNT_XPLM_CALL();
+	(void)inMenu;
+	(void)index;
+	(void)inCheck;
+}
+
+/*
+* Windows and drawing
+*/
+XPLMWindowID XPLMCreateWindowEx(XPLMCreateWindow_t* inParams)
+{
+	COUNT_XPLM_CALL();
+	return Runtime::instance().createWindow(*inParams);
+}
+
+void XPLMDestroyWindow(XPLMWindowID inWindowID)
+{
+	COUNT_XPLM_CALL();
+	auto wnd = static_cast<Headless::Window*>(inWindowID);
+	if (nullptr != wnd)
+		wnd->destroyed = true;
+}
+
+void XPLMGetScreenBoundsGlobal(int* outLeft, int* outTop, int* outRight, int* outBottom)
+{
+	COUNT_XPLM_CALL();
+	*outLeft = 0;
+	*outTop = 1080;
+	*outRight = 1920;
+	*outBottom = 0;
+}
+
+void XPLMGetWindowGeometry(XPLMWindowID inWindowID, int* outLeft, int* outTop, int* outRight, int* outBottom)
+{
+	COUNT_XPLM_CALL();
+	auto wnd = static_cast<Headless::Window*>(inWindowID);
+	if (outLeft)
+		*outLeft = wnd->params.left;
+	if (outTop)
+		*outTop = wnd->params.top;
+	if (outRight)
+		*outRight = wnd->params.right;
+	if (outBottom)
+		*outBottom = wnd->params.bottom;
+}
+
+int XPLMGetWindowIsVisible(XPLMWindowID inWindowID)
+{
+	COUNT_XPLM_CALL();
+	return static_cast<Headless::Window*>(inWindowID)->visible;
+}
+
+void XPLMSetWindowIsVisible(XPLMWindowID inWindowID, int inIsVisible)
+{
+	COUNT_XPLM_CALL();
+	static_cast<Headless::Window*>(inWindowID)->visible = inIsVisible != 0;
+}
+
+void XPLMSetGraphicsState(int inEnableFog, int inNumberTexUnits, int inEnableLighting, int inEnableAlphaTesting,
+	int inEnableAlphaBlending, int inEnableDepthTesting, int inEnableDepthWriting)
+{
+	COUNT_XPLM_CALL();
+	(void)inEnableFog;
+	(void)inNumberTexUnits;
+	(void)inEnableLighting;
+	(void)inEnableAlphaTesting;
+	(void)inEnableAlphaBlending;
+	(void)inEnableDepthTesting;
+	(void)inEnableDepthWriting;
+}
+
+void XPLMDrawTranslucentDarkBox(int inLeft, int inTop, int inRight, int inBottom)
+{
+	COUNT_XPLM_CALL();
+	(void)inLeft;
+	(void)inTop;
+	(void)inRight;
+	(void)inBottom;
+}
+
+void XPLMDrawString(float* inColorRGB, int inXOffset, int inYOffset, char* inChar, int* inWordWrapWidth, XPLMFontID inFontID)
+{
+	COUNT_XPLM_CALL();
+	(void)inColorRGB;
+	(void)inXOffset;
+	(void)inYOffset;
+	(void)inChar;
+	(void)inWordWrapWidth;
+	(void)inFontID;
+}
+
+void XPLMGetFontDimensions(XPLMFontID inFontID, int* outCharWidth, int* outCharHeight, int* outDigitsOnly)
+{
+	COUNT_XPLM_CALL();
+	(void)inFontID;
+	if (outCharWidth)
+		*outCharWidth = 8;
+	if (outCharHeight)
+		*outCharHeight = 12;
+	if (outDigitsOnly)
+		*outDigitsOnly = 0;
+}
+
+float XPLMMeasureString(XPLMFontID inFontID, const char* inChar, int inNumChars)
+{
+	COUNT_XPLM_CALL();
+	(void)inFontID;
+	(void)inChar;
+	return 8.0f * inNumChars;
+}
+
+/*
+* Widgets: the plugin only touches widgets it never creates headless
+*/
+void XPDestroyWidget(XPWidgetID inWidget, int inDestroyChildren)
+{
+	COUNT_XPLM_CALL();
+	(void)inWidget;
+	(void)inDestroyChildren;
+}
+
+void XPShowWidget(XPWidgetID inWidget)
+{
+	COUNT_XPLM_CALL();
+	(void)inWidget;
+}
+
+void XPHideWidget(XPWidgetID inWidget)
+{
+	COUNT_XPLM_CALL();
+	(void)inWidget;
+}
+
+void XPSetWidgetDescriptor(XPWidgetID inWidget, const char* inDescriptor)
+{
+	COUNT_XPLM_CALL();
+	(void)inWidget;
+	(void)inDescriptor;
+}
@@ -0,0 +1,292 @@
+// Headless/main.cpp : runs the AutoThrottle plugin against the headless XPLM runtime.
+//
+// usage: headless [--aircraft C90B|Cessna_CitationX] [--plugin-dir DIR] [--duration SEC]
+//                 [--frame SEC] [--setpoint SEC=KTS ...] [--trace FILE] [--quiet] [--calls]
+//                 [--asymmetry FRACTION] [--agl FT] [--vs SEC=FPM ...] [--gear SEC=0|1 ...]
+//                 [--ap-speed SEC=KTS|MACH ...] [--ias-noise KTS] [--tune SEC]
+//                 [--model FILE] [--model-order 1|2] [--gust SEC=KTS ...] [--drag SEC=FRACTION ...]
+//
+// The plugin is started, the aircraft loaded and the auto throttle enabled
+// through its menu, then the sim runs for --duration simulated seconds.
+// Setpoint changes are written to v8judd/auto_throttle/hold_speed.
+// --calls lists the XPLM functions the flight loop callbacks used.
+// --asymmetry makes the last engine weaker by the given power fraction.
+// --agl sets the starting height, --vs and --gear script the vertical path
+// and the gear handle, e.g. to run through the flight phases.
+// --gust sets the headwind at the given time, the airspeed steps by the
+// change; --drag adds the fraction to the drag (gear, flaps). Together they
+// make the disturbance benchmark in the README.
+// --ap-speed sets the autopilot speed dial, a value below 2 selects Mach.
+// --ias-noise adds Gaussian noise of that standard deviation to the airspeed
+// indicator; IAE is taken on the noise-free speed.
+// --tune selects Auto Tune at the given time; the tuner rewrites the
+// aircraft's ini in --plugin-dir.
+// --model flies the speed model of an Identify model file instead of the
+// built-in thrust and drag, --model-order 1 its first order plus dead time.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "HeadlessRuntime.h"
+#include "SimpleAircraft.h"
+
+int main(int argc, char* argv[])
+{
+	std::string aircraft = "C90B";
+	std::string pluginDir = ".";
+	std::string traceFile;
+	double duration = 3600;
+	double frame = 1.0 / 30.0;
+	bool quiet = false;
+	bool listCalls = false;
+	float asymmetry = 0;
+	float startAgl = 5000;
+	float iasNoise = 0;
+	double tuneAt = -1;
+	std::string modelFile;
+	int modelOrder = 2;
+	std::map<double, float> setpoints;
+	std::map<double, float> verticalSpeeds;
+	std::map<double, float> gear;
+	std::map<double, float> apSpeeds;
+	std::map<double, float> gusts;
+	std::map<double, float> drags;
+
+	// SEC=VALUE schedule entries
+	auto addEvent = [](std::map<double, float>& events, const std::string& option, const std::string& event) {
+		auto pos = event.find('=');
+		if (std::string::npos == pos)
+		{
+			fprintf(stderr, "%s expects SEC=VALUE, got %s\n", option.c_str(), event.c_str());
+			return false;
+		}
+		events[atof(event.substr(0, pos).c_str())] = static_cast<float>(atof(event.substr(pos + 1).c_str()));
+		return true;
+	};
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if ("--aircraft" == arg && hasValue)
+			aircraft = argv[++i];
+		else if ("--plugin-dir" == arg && hasValue)
+			pluginDir = argv[++i];
+		else if ("--duration" == arg && hasValue)
+			duration = atof(argv[++i]);
+		else if ("--frame" == arg && hasValue)
+			frame = atof(argv[++i]);
+		else if ("--trace" == arg && hasValue)
+			traceFile = argv[++i];
+		else if ("--setpoint" == arg && hasValue)
+		{
+			if (!addEvent(setpoints, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--vs" == arg && hasValue)
+		{
+			if (!addEvent(verticalSpeeds, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--gear" == arg && hasValue)
+		{
+			if (!addEvent(gear, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--ap-speed" == arg && hasValue)
+		{
+			if (!addEvent(apSpeeds, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--gust" == arg && hasValue)
+		{
+			if (!addEvent(gusts, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--drag" == arg && hasValue)
+		{
+			if (!addEvent(drags, arg, argv[++i]))
+				return EXIT_FAILURE;
+		} else if ("--quiet" == arg)
+			quiet = true;
+		else if ("--calls" == arg)
+			listCalls = true;
+		else if ("--asymmetry" == arg && hasValue)
+			asymmetry = static_cast<float>(atof(argv[++i]));
+		else if ("--agl" == arg && hasValue)
+			startAgl = static_cast<float>(atof(argv[++i]));
+		else if ("--ias-noise" == arg && hasValue)
+			iasNoise = static_cast<float>(atof(argv[++i]));
+		else if ("--tune" == arg && hasValue)
+			tuneAt = atof(argv[++i]);
+		else if ("--model" == arg && hasValue)
+			modelFile = argv[++i];
+		else if ("--model-order" == arg && hasValue)
+			modelOrder = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "unknown argument: %s\n", arg.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto& rt = Headless::Runtime::instance();
+	rt.setQuiet(quiet);
+	rt.setPluginDir(pluginDir);
+	rt.setFrameTime(frame);
+	auto model = std::make_unique<Headless::SimpleAircraft>(Headless::SimpleAircraft::byName(aircraft));
+	model->setAsymmetry(asymmetry);
+	model->setAltitude(startAgl);
+	model->setIasNoise(iasNoise);
+	if (!modelFile.empty())
+	{
+		SpeedModelPlant::Params firstOrder, secondOrder;
+		if (!SpeedModelPlant::load(modelFile, firstOrder, secondOrder))
+		{
+			fprintf(stderr, "failed to load model %s\n", modelFile.c_str());
+			return EXIT_FAILURE;
+		}
+		model->setSpeedModel(1 == modelOrder ? firstOrder : secondOrder);
+	}
+	auto aircraftModel = model.get();
+	rt.setAircraft(std::move(model));
+
+	if (!rt.startPlugin())
+	{
+		fprintf(stderr, "XPluginStart failed\n");
+		return EXIT_FAILURE;
+	}
+	rt.loadAircraft();
+	rt.selectMenuItem("AutoThrottle", "Enable");
+
+	std::ofstream trace;
+	if (!traceFile.empty())
+	{
+		trace.open(traceFile);
+		trace << "t;speed;out;setpoint;itt;torque;limit;agl;vs;phase;mach;hold_mach;mach_mode;plant_gain;plant_damping;kp;ki;kd" << std::endl;
+	}
+
+	const char* throttleName = "sim/cockpit2/engine/actuators/throttle_ratio_all";
+	const char* holdName = "v8judd/auto_throttle/hold_speed";
+
+	double iae = 0;
+	auto nextSetpoint = setpoints.begin();
+	auto nextVs = verticalSpeeds.begin();
+	auto nextGear = gear.begin();
+	auto nextApSpeed = apSpeeds.begin();
+	auto nextGust = gusts.begin();
+	auto nextDrag = drags.begin();
+	float worstError = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	// one second slices: apply setpoint changes, integrate the error, trace
+	while (rt.simTime() < duration)
+	{
+		while (nextSetpoint != setpoints.end() && nextSetpoint->first <= rt.simTime())
+		{
+			rt.setf(holdName, nextSetpoint->second);
+			++nextSetpoint;
+		}
+		for (; nextVs != verticalSpeeds.end() && nextVs->first <= rt.simTime(); ++nextVs)
+			aircraftModel->setVerticalSpeed(nextVs->second);
+		for (; nextGear != gear.end() && nextGear->first <= rt.simTime(); ++nextGear)
+			aircraftModel->setGearDown(nextGear->second != 0);
+		for (; nextGust != gusts.end() && nextGust->first <= rt.simTime(); ++nextGust)
+			aircraftModel->setHeadwind(nextGust->second);
+		for (; nextDrag != drags.end() && nextDrag->first <= rt.simTime(); ++nextDrag)
+			aircraftModel->setExtraDrag(nextDrag->second);
+		if (tuneAt >= 0 && tuneAt <= rt.simTime())
+		{
+			rt.selectMenuItem("AutoThrottle", "Auto Tune");
+			tuneAt = -1;
+		}
+		for (; nextApSpeed != apSpeeds.end() && nextApSpeed->first <= rt.simTime(); ++nextApSpeed)
+		{
+			rt.seti("sim/cockpit2/autopilot/airspeed_is_mach", nextApSpeed->second < 2 ? 1 : 0);
+			rt.setf("sim/cockpit2/autopilot/airspeed_dial_kts_mach", nextApSpeed->second);
+		}
+
+		rt.run(1.0);
+
+		float ias = aircraftModel->trueIas();
+		float hold = rt.getf(holdName);
+		iae += std::fabs(hold - ias);
+		if (std::fabs(hold - ias) > worstError)
+			worstError = std::fabs(hold - ias);
+
+		if (trace.is_open())
+		{
+			float engine[8] = {}, engineTorque[8] = {};
+			rt.getvf("sim/cockpit2/engine/indicators/ITT_deg_C", engine, 1);
+			rt.getvf("sim/cockpit2/engine/indicators/torque_n_mtr", engineTorque, 1);
+			trace << rt.simTime() << ";" << ias << ";" << rt.getf(throttleName) << ";" << hold << ";"
+				<< engine[0] << ";" << engineTorque[0] << ";" << rt.getf("v8judd/auto_throttle/envelope_limit") << ";"
+				<< rt.getf("sim/flightmodel/position/y_agl") / 0.3048f << ";" << rt.getf("sim/flightmodel/position/vh_ind_fpm") << ";"
+				<< rt.geti("v8judd/auto_throttle/flight_phase") << ";" << rt.getf("sim/flightmodel/misc/machno") << ";"
+				<< rt.getf("v8judd/auto_throttle/hold_mach") << ";" << rt.geti("v8judd/auto_throttle/mach_mode") << ";"
+				<< rt.getf("v8judd/auto_throttle/plant_gain") << ";" << rt.getf("v8judd/auto_throttle/plant_damping") << ";"
+				<< rt.getf("v8judd/auto_throttle/kp") << ";" << rt.getf("v8judd/auto_throttle/ki") << ";" << rt.getf("v8judd/auto_throttle/kd") << "\n";
+		}
+	}
+
+	auto stop = std::chrono::steady_clock::now();
+	double wall = std::chrono::duration<double>(stop - start).count();
+
+	rt.selectMenuItem("AutoThrottle", "Disable");
+	// the log writer runs in real time, far behind the sim, so samples are dropped here
+	int logDropped = rt.geti("v8judd/auto_throttle/log_dropped");
+	int mpcFallbacks = rt.geti("v8judd/auto_throttle/mpc_fallbacks");
+	float plantGain = rt.getf("v8judd/auto_throttle/plant_gain");
+	float plantDamping = rt.getf("v8judd/auto_throttle/plant_damping");
+	float plantGainSd = rt.getf("v8judd/auto_throttle/plant_gain_sd");
+	float gains[3] = { rt.getf("v8judd/auto_throttle/kp"), rt.getf("v8judd/auto_throttle/ki"), rt.getf("v8judd/auto_throttle/kd") };
+	float levers[8] = {}, n1[8] = {}, torque[8] = {}, itt[8] = {};
+	int engines = rt.geti("sim/aircraft/engine/acf_num_engines");
+	rt.getvf("sim/cockpit2/engine/actuators/throttle_ratio", levers, 8);
+	rt.getvf("sim/flightmodel/engine/ENGN_N1_", n1, 8);
+	rt.getvf("sim/cockpit2/engine/indicators/torque_n_mtr", torque, 8);
+	rt.getvf("sim/cockpit2/engine/indicators/ITT_deg_C", itt, 8);
+	rt.stopPlugin();
+
+	printf("aircraft:        %s\n", aircraft.c_str());
+	printf("simulated:       %.0f s in %lld frames\n", rt.simTime(), static_cast<long long>(rt.frameCount()));
+	printf("wall time:       %.3f s (%.0fx real time)\n", wall, rt.simTime() / wall);
+	printf("final speed:     %.2f kts (hold %.2f)\n", aircraftModel->trueIas(), rt.getf(holdName));
+	printf("IAE:             %.1f kts*s\n", iae);
+	printf("worst error:     %.2f kts\n", worstError);
+	printf("lever travel:    %.2f\n", aircraftModel->leverTravel());
+	printf("log dropped:     %d samples\n", logDropped);
+	printf("MPC fallbacks:   %d\n", mpcFallbacks);
+	if (plantGain != 0)
+		printf("plant estimate:  gain %.3f +- %.3f kts/s, damping %.4f 1/s\n", plantGain, plantGainSd, plantDamping);
+	printf("final gains:     kp %.4f ki %.4f kd %.4f\n", gains[0], gains[1], gains[2]);
+	printf("engines:        ");
+	for (int i = 0; i < engines; ++i)
+		printf(" [%d] lever %.3f N1 %.1f%% torque %.0f Nm ITT %.0f C", i + 1, levers[i], n1[i], torque[i], itt[i]);
+	printf("\n");
+
+	int64_t callbacks = 0;
+	for (auto& loop : rt.flightLoops())
+	{
+		if (0 == loop.calls)
+			continue;
+		printf("flight loop:     %lld calls, %.0f ns mean, %.0f ns max, %.2f XPLM calls each\n",
+			static_cast<long long>(loop.calls), loop.callNs / loop.calls, loop.maxCallNs,
+			static_cast<double>(loop.xplmCalls) / loop.calls);
+		callbacks += loop.calls;
+	}
+
+	if (listCalls && callbacks > 0)
+	{
+		for (auto& call : rt.apiCalls())
+		{
+			if (call.second > 0)
+				printf("  %-28s %.2f per callback\n", call.first.c_str(), static_cast<double>(call.second) / callbacks);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+// Identify/main.cpp : fits speed models to flight logs and writes a model file.
+//
+// usage: identify [--step SEC] [--max-dead-time SEC] [--min-run SEC] [--max-gap SEC]
+//                 [--per-log] [--threads N] [--out FILE]
+//                 [--trim] [--trim-ias LIST] [--trim-alt LIST] [--trim-weight LIST]
+//                 [--trim-window SEC] [--trim-speed-band KTS] [--trim-lever-band LEVER]
+//                 [--trim-smoothing W] LOG|DIR [LOG|DIR ...]
+//
+// Every LOG is a CSV log (<plane>_logN.csv or the Auswertung layout) or a
+// binary .atlog; a DIR contributes all of its .csv and .atlog files. Logs are
+// read in parallel, every "setpoint:" block is a run of its own. Both models
+// of SpeedModelPlant are fitted over all runs together and written as a model
+// file (to stdout without --out) that Sweep and the headless runtime read
+// with --model, and whose mpc_ keys the plugin reads from the aircraft ini.
+// --per-log also fits every log on its own first: logs that disagree with the
+// rest (flown in a climb, turbulence, ...) show up there and are better left
+// out, the joint fit has no way to tell them apart from the plant.
+//
+// --trim also learns the steady lever over IAS (and pressure altitude and
+// weight with --trim-alt/--trim-weight breakpoints, from logs that have
+// them) from the steady segments of the logs, the runs without lever
+// movement included, and adds it to the model file as the trim_ keys of the
+// plugin's feedforward. Without --trim-ias the IAS breakpoints are every
+// 10 kts over the speeds flown. A segment is steady while speed and lever
+// stay within their bands for --trim-window seconds; --trim-smoothing
+// weights the differences between neighbouring table values against one
+// second of steady flight.
+//
+// Build:
+//   g++ -std=c++17 -O2 -pthread -I.. main.cpp ../PlantIdentification.cpp ../PlantModel.cpp ../TrimTable.cpp ../OperatingGrid.cpp ../WorkStealingPool.cpp ../BinaryLog.cpp -o identify
+//   cl /std:c++17 /O2 /EHsc /I.. main.cpp ..\PlantIdentification.cpp ..\PlantModel.cpp ..\TrimTable.cpp ..\OperatingGrid.cpp ..\WorkStealingPool.cpp ..\BinaryLog.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PlantIdentification.h"
+#include "PlantModel.h"
+#include "TrimTable.h"
+#include "WorkStealingPool.h"
+
+namespace fs = std::filesystem;
+
+/* spacing of the IAS breakpoints picked from the data, kts */
+#define TRIM_IAS_SPACING 10.0f
+
+static std::vector<float> parseList(const char* text)
+{
+	std::vector<float> list;
+	std::string s{ text };
+	std::size_t start = 0;
+	for (;;)
+	{
+		auto pos = s.find(',', start);
+		list.push_back(static_cast<float>(atof(s.substr(start, std::string::npos == pos ? std::string::npos : pos - start).c_str())));
+		if (std::string::npos == pos)
+			break;
+		start = pos + 1;
+	}
+	return list;
+}
+
+static void writeList(std::ostream& out, const char* key, const std::vector<float>& list)
+{
+	out << key << "=";
+	for (std::size_t i = 0; i < list.size(); ++i)
+		out << (i > 0 ? "," : "") << list[i];
+	out << "\n";
+}
+
+static void printModel(const std::string& name, const IdentResult& r)
+{
+	if (!r.valid)
+	{
+		fprintf(stderr, "%-13s no fit\n", name.c_str());
+		return;
+	}
+
+	auto& m = r.model;
+	fprintf(stderr, "%-13s K %7.2f kts/lever  T %6.2f s  dead time %4.2f s  spool %4.2f s  drag slope %.4f 1/s  gain %.3f kts/s  rms %.3f kts\n",
+		name.c_str(), m.gain / m.damping, 1.0f / m.damping, m.deadTime, m.spoolTau, m.damping, m.gain, r.rms);
+	if (r.deadTimeAtLimit)
+		fprintf(stderr, "%-13s warning: dead time at the --max-dead-time limit, raise it or check the logs\n", name.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+	IdentSettings settings;
+	unsigned threads = 0;
+	std::string outFile;
+	bool perLog = false;
+	bool trim = false;
+	std::vector<float> trimBreakpoints[OperatingGrid::Axes];
+	float trimSmoothing = 10;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if ("--step" == arg && hasValue)
+			settings.step = static_cast<float>(atof(argv[++i]));
+		else if ("--max-dead-time" == arg && hasValue)
+			settings.maxDeadTime = static_cast<float>(atof(argv[++i]));
+		else if ("--min-run" == arg && hasValue)
+			settings.minRun = static_cast<float>(atof(argv[++i]));
+		else if ("--max-gap" == arg && hasValue)
+			settings.maxGap = static_cast<float>(atof(argv[++i]));
+		else if ("--per-log" == arg)
+			perLog = true;
+		else if ("--threads" == arg && hasValue)
+			threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if ("--out" == arg && hasValue)
+			outFile = argv[++i];
+		else if ("--trim" == arg)
+			trim = true;
+		else if ("--trim-ias" == arg && hasValue)
+			trimBreakpoints[OperatingGrid::Ias] = parseList(argv[++i]), trim = true;
+		else if ("--trim-alt" == arg && hasValue)
+			trimBreakpoints[OperatingGrid::Altitude] = parseList(argv[++i]), trim = true;
+		else if ("--trim-weight" == arg && hasValue)
+			trimBreakpoints[OperatingGrid::Weight] = parseList(argv[++i]), trim = true;
+		else if ("--trim-window" == arg && hasValue)
+			settings.steady.window = static_cast<float>(atof(argv[++i]));
+		else if ("--trim-speed-band" == arg && hasValue)
+			settings.steady.speedBand = static_cast<float>(atof(argv[++i]));
+		else if ("--trim-lever-band" == arg && hasValue)
+			settings.steady.leverBand = static_cast<float>(atof(argv[++i]));
+		else if ("--trim-smoothing" == arg && hasValue)
+			trimSmoothing = static_cast<float>(atof(argv[++i]));
+		else if (0 == arg.compare(0, 2, "--"))
+		{
+			fprintf(stderr, "unknown argument: %s\n", arg.c_str());
+			return EXIT_FAILURE;
+		} else
+			inputs.push_back(arg);
+	}
+
+	if (inputs.empty() || settings.step <= 0)
+	{
+		fprintf(stderr, "usage: identify [--step SEC] [--max-dead-time SEC] [--min-run SEC] [--max-gap SEC] [--per-log] [--threads N] [--out FILE]\n"
+			"                [--trim] [--trim-ias LIST] [--trim-alt LIST] [--trim-weight LIST] [--trim-window SEC]\n"
+			"                [--trim-speed-band KTS] [--trim-lever-band LEVER] [--trim-smoothing W] LOG|DIR ...\n");
+		return EXIT_FAILURE;
+	}
+
+	// directories expand to their logs, sorted so the run order does not depend on the file system
+	std::vector<std::string> logs;
+	for (auto& in : inputs)
+	{
+		std::error_code ec;
+		if (!fs::is_directory(in, ec))
+		{
+			logs.push_back(in);
+			continue;
+		}
+
+		std::vector<std::string> found;
+		for (auto& entry : fs::directory_iterator(in, ec))
+		{
+			auto ext = entry.path().extension().string();
+			if (entry.is_regular_file(ec) && (".csv" == ext || ".atlog" == ext))
+				found.push_back(entry.path().string());
+		}
+		std::sort(found.begin(), found.end());
+		logs.insert(logs.end(), found.begin(), found.end());
+	}
+
+	WorkStealingPool pool{ threads };
+	PlantIdentification ident{ settings };
+
+	struct Loaded
+	{
+		std::vector<IdentRun> runs;
+		std::vector<TrimPoint> trim;
+		std::string airframe;
+		std::string error;
+		bool ok;
+	};
+	std::vector<Loaded> loaded(logs.size());
+
+	auto start = std::chrono::steady_clock::now();
+	pool.parallelFor(0, logs.size(), 1, [&](std::size_t i) {
+		loaded[i].ok = ident.load(logs[i], loaded[i].runs, loaded[i].airframe, loaded[i].error, trim ? &loaded[i].trim : nullptr);
+	});
+
+	std::vector<IdentRun> runs;
+	std::vector<TrimPoint> trimPoints;
+	std::size_t trimLogs = 0;
+	std::vector<std::string> airframes;
+	std::size_t usedLogs = 0;
+	for (std::size_t i = 0; i < logs.size(); ++i)
+	{
+		if (!loaded[i].ok)
+		{
+			fprintf(stderr, "%s: %s, skipped\n", logs[i].c_str(), loaded[i].error.c_str());
+			continue;
+		}
+		if (!loaded[i].trim.empty())
+		{
+			trimPoints.insert(trimPoints.end(), loaded[i].trim.begin(), loaded[i].trim.end());
+			++trimLogs;
+		}
+		if (loaded[i].runs.empty())
+		{
+			fprintf(stderr, "%s: no run with lever movement%s\n", logs[i].c_str(), loaded[i].trim.empty() ? ", skipped" : "");
+			continue;
+		}
+
+		auto& a = loaded[i].airframe;
+		if (!a.empty() && std::find(airframes.begin(), airframes.end(), a) == airframes.end())
+			airframes.push_back(a);
+		++usedLogs;
+		if (perLog)
+		{
+			fprintf(stderr, "%s: %zu runs\n", logs[i].c_str(), loaded[i].runs.size());
+			printModel("  first", ident.fitFirstOrder(loaded[i].runs, pool));
+			printModel("  second", ident.fitSecondOrder(loaded[i].runs, pool));
+		}
+		std::move(loaded[i].runs.begin(), loaded[i].runs.end(), std::back_inserter(runs));
+	}
+	if (runs.empty() && trimPoints.empty())
+	{
+		fprintf(stderr, trim ? "no usable runs and no steady segments\n" : "no usable runs\n");
+		return EXIT_FAILURE;
+	}
+	if (airframes.size() > 1)
+		fprintf(stderr, "warning: logs of %zu airframes mixed\n", airframes.size());
+
+	IdentResult first{}, second{};
+	if (!runs.empty())
+	{
+		first = ident.fitFirstOrder(runs, pool);
+		second = ident.fitSecondOrder(runs, pool);
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printModel("first order", first);
+		printModel("second order", second);
+		fprintf(stderr, "%zu runs, %zu samples from %zu logs on %u threads in %.3f s\n",
+			runs.size(), first.samples, usedLogs, pool.size(), wall);
+		if (!first.valid || !second.valid)
+			return EXIT_FAILURE;
+
+		// runs the second order model explains much worse than the others, candidates for leaving out
+		std::vector<float> sorted = second.runRms;
+		std::sort(sorted.begin(), sorted.end());
+		float median = sorted[sorted.size() / 2];
+		for (std::size_t i = 0; i < runs.size(); ++i)
+		{
+			if (second.runRms[i] > 2.0f * median)
+				fprintf(stderr, "%s, setpoint %g: rms %.3f kts, %.1fx the median\n",
+					runs[i].source.c_str(), runs[i].setpoint, second.runRms[i], second.runRms[i] / median);
+		}
+	}
+
+	TrimTable table;
+	if (trim)
+	{
+		if (trimPoints.empty())
+		{
+			fprintf(stderr, "no steady segments for the trim table\n");
+			return EXIT_FAILURE;
+		}
+
+		auto& ias = trimBreakpoints[OperatingGrid::Ias];
+		if (ias.empty())
+		{
+			auto range = std::minmax_element(trimPoints.begin(), trimPoints.end(),
+				[](const TrimPoint& a, const TrimPoint& b) { return a.ias < b.ias; });
+			float low = std::floor(range.first->ias / TRIM_IAS_SPACING) * TRIM_IAS_SPACING;
+			float high = std::ceil(range.second->ias / TRIM_IAS_SPACING) * TRIM_IAS_SPACING;
+			float spacing = TRIM_IAS_SPACING;
+			while ((high - low) / spacing + 1 > OPERATING_GRID_MAX_POINTS)
+				spacing *= 2;
+			for (float v = low; v <= high; v += spacing)
+				ias.push_back(v);
+		}
+
+		float rms;
+		std::size_t used;
+		if (!table.fit(trimBreakpoints, trimPoints, trimSmoothing, rms, used))
+		{
+			fprintf(stderr, "trim table: %s\n", *table.error() ? table.error() : "no steady segment has the values of the axes asked for");
+			return EXIT_FAILURE;
+		}
+		fprintf(stderr, "trim table: %zu of %zu steady segments from %zu logs, lever rms %.4f\n", used, trimPoints.size(), trimLogs, rms);
+	}
+
+	std::ofstream file;
+	if (!outFile.empty())
+	{
+		file.open(outFile);
+		if (!file.is_open())
+		{
+			fprintf(stderr, "%s: cannot write\n", outFile.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream& out = outFile.empty() ? std::cout : file;
+
+	if (!runs.empty())
+	{
+		out << "# speed model of " << (airframes.empty() ? std::string{ "unknown airframe" } : airframes.front())
+			<< " identified from " << runs.size() << " runs in " << usedLogs << " logs\n";
+		out << "# simulation error " << first.rms << " and " << second.rms << " kts rms\n";
+		SpeedModelPlant::save(out, first.model, second.model);
+	}
+	if (table.enabled())
+	{
+		// no key names in the comment, the plugin's ini reader would take them
+		out << "# steady lever from " << trimPoints.size() << " segments in " << trimLogs << " logs\n";
+		writeList(out, "trim_ias", trimBreakpoints[OperatingGrid::Ias]);
+		if (table.uses(OperatingGrid::Altitude))
+			writeList(out, "trim_alt", trimBreakpoints[OperatingGrid::Altitude]);
+		if (table.uses(OperatingGrid::Weight))
+			writeList(out, "trim_weight", trimBreakpoints[OperatingGrid::Weight]);
+		writeList(out, "trim_lever", table.values());
+	}
+
+	return out.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
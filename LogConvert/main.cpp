@@ -0,0 +1,107 @@
+// LogConvert/main.cpp : turns binary flight logs (<plane>_logN.atlog) back into
+// the semicolon CSV layout of <plane>_logN.csv, for the .ods evaluations.
+//
+// usage: logconvert [-o OUT.csv] LOG.atlog [LOG.atlog ...]
+//
+// Without -o every LOG.atlog is written next to itself as LOG.csv. A log cut
+// short by a crash converts up to its last complete chunk, with a warning.
+//
+// Build:
+//   g++ -std=c++17 -O2 -I.. main.cpp ../BinaryLog.cpp ../FlightLog.cpp -pthread -o logconvert
+//   cl /std:c++17 /O2 /EHsc /I.. main.cpp ..\BinaryLog.cpp ..\FlightLog.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BinaryLog.h"
+#include "FlightLog.h"
+
+static bool convert(const std::string& in, const std::string& out)
+{
+	BinaryLogReader log;
+	if (!log.open(in))
+	{
+		fprintf(stderr, "%s: not a binary flight log (or a newer version)\n", in.c_str());
+		return false;
+	}
+
+	std::ofstream csv{ out };
+	if (!csv.is_open())
+	{
+		fprintf(stderr, "%s: cannot write\n", out.c_str());
+		return false;
+	}
+
+	const BinaryLogFileHeader& h = log.header();
+	std::string airframe{ h.airframe, std::find(h.airframe, h.airframe + sizeof(h.airframe), '\0') };
+	FlightLogHeader header{ airframe, h.Kp, h.Ki, h.Kd, h.tau,
+		h.limMin, h.limMax, h.limMinInt, h.limMaxInt, h.holdSpeed, h.T };
+	FlightLog::writeCsvHeader(csv, header);
+
+	for (auto& chunk : log.chunks())
+	{
+		if (BinaryLogChunkHeader::Run == chunk.kind)
+		{
+			FlightLog::writeCsvRun(csv, chunk.setpoint);
+			continue;
+		}
+
+		// version 1 logs have no altitude and weight, they convert as 0
+		bool extended = h.columns >= BINARY_LOG_COLUMNS;
+		for (std::uint32_t r = 0; r < chunk.rows; ++r)
+		{
+			FlightLogSample s{ chunk.column(0)[r], chunk.column(1)[r], chunk.column(2)[r], chunk.column(3)[r],
+				chunk.column(4)[r], chunk.column(5)[r], chunk.column(6)[r],
+				extended ? chunk.column(7)[r] : 0.0f, extended ? chunk.column(8)[r] : 0.0f };
+			FlightLog::writeCsvSample(csv, s);
+		}
+	}
+
+	if (log.truncated())
+		fprintf(stderr, "%s: incomplete last chunk ignored\n", in.c_str());
+
+	return csv.good();
+}
+
+int main(int argc, char* argv[])
+{
+	std::string out;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if ("-o" == arg && i + 1 < argc)
+			out = argv[++i];
+		else
+			inputs.push_back(arg);
+	}
+
+	if (inputs.empty() || (!out.empty() && inputs.size() > 1))
+	{
+		fprintf(stderr, "usage: logconvert [-o OUT.csv] LOG.atlog [LOG.atlog ...]\n");
+		return EXIT_FAILURE;
+	}
+
+	int failed = 0;
+	for (auto& in : inputs)
+	{
+		std::string target = out;
+		if (target.empty())
+		{
+			auto dot = in.find_last_of('.');
+			auto sep = in.find_last_of("\\/");
+			bool hasExt = std::string::npos != dot && (std::string::npos == sep || dot > sep);
+			target = (hasExt ? in.substr(0, dot) : in) + ".csv";
+		}
+
+		if (!convert(in, target))
+			++failed;
+	}
+
+	return 0 == failed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
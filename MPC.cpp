@@ -0,0 +1,311 @@
+#include "MPC.h"
+
+#include <chrono>
+#include <cmath>
+
+/* ADMM: initial penalty, proximal term, over-relaxation */
+#define MPC_RHO 0.1f
+#define MPC_SIGMA 1e-6f
+#define MPC_ALPHA 1.6f
+/* the penalty is adapted when the residuals are out of balance by this factor, within these bounds */
+#define MPC_RHO_ADAPT 5.0f
+#define MPC_RHO_MIN 1e-4f
+#define MPC_RHO_MAX 1e4f
+/* convergence, absolute and relative */
+#define MPC_EPS_ABS 1e-4f
+#define MPC_EPS_REL 1e-3f
+/* residuals and the clock are checked every so many iterations */
+#define MPC_CHECK_EVERY 5
+#define MPC_MAX_ITERATIONS 1000
+/* RK4 sub-steps per prediction step when discretising */
+#define MPC_SUBSTEPS 20
+
+namespace
+{
+	float clamp(float value, float lower, float upper)
+	{
+		return value < lower ? lower : (value > upper ? upper : value);
+	}
+
+	/* the continuous model over one step from (v, s) under constant u and d, RK4 */
+	void propagate(const MPC::Model& m, float step, float u, float d, float& v, float& s)
+	{
+		auto dv = [&](float v, float s) { return -m.damping * v + m.gain * s + d; };
+		auto ds = [&](float s) { return (u - s) / m.spoolTau; };
+
+		float h = step / MPC_SUBSTEPS;
+		for (int i = 0; i < MPC_SUBSTEPS; ++i)
+		{
+			float k1v = dv(v, s), k1s = ds(s);
+			float k2v = dv(v + 0.5f * h * k1v, s + 0.5f * h * k1s), k2s = ds(s + 0.5f * h * k1s);
+			float k3v = dv(v + 0.5f * h * k2v, s + 0.5f * h * k2s), k3s = ds(s + 0.5f * h * k2s);
+			float k4v = dv(v + h * k3v, s + h * k3s), k4s = ds(s + h * k3s);
+			v += h / 6.0f * (k1v + 2.0f * k2v + 2.0f * k3v + k4v);
+			s += h / 6.0f * (k1s + 2.0f * k2s + 2.0f * k3s + k4s);
+		}
+	}
+}
+
+bool MPC::configure(const Model& m, const Tuning& t)
+{
+	valid = false;
+	if (t.horizon < 1 || t.horizon > MPC_MAX_HORIZON || t.moves < 1 || t.moves > MPC_MAX_MOVES || t.moves > t.horizon)
+		return false;
+	if (t.step <= 0 || m.spoolTau <= 0 || t.speedWeight <= 0 || t.moveWeight < 0 || t.rateLimit <= 0)
+		return false;
+	model = m;
+	tuning = t;
+	const int N = t.horizon, M = t.moves;
+
+	// columns of the discrete model from unit states and inputs
+	float v = 1, s = 0;
+	propagate(m, t.step, 0, 0, v, s);
+	Ad[0][0] = v, Ad[1][0] = s;
+	v = 0, s = 1;
+	propagate(m, t.step, 0, 0, v, s);
+	Ad[0][1] = v, Ad[1][1] = s;
+	v = 0, s = 0;
+	propagate(m, t.step, 1, 0, v, s);
+	Bd[0] = v, Bd[1] = s;
+	v = 0, s = 0;
+	propagate(m, t.step, 0, 1, v, s);
+	Ed[0] = v, Ed[1] = s;
+
+	// forced response: move j acts from step j on, the last move to the end
+	for (int j = 0; j < M; ++j)
+	{
+		float state[2] = {};
+		for (int k = 0; k < N; ++k)
+		{
+			float u = (k < M - 1 ? k : M - 1) == j ? 1.0f : 0.0f;
+			float next0 = Ad[0][0] * state[0] + Ad[0][1] * state[1] + Bd[0] * u;
+			float next1 = Ad[1][0] * state[0] + Ad[1][1] * state[1] + Bd[1] * u;
+			state[0] = next0, state[1] = next1;
+			G[k][j] = state[0];
+		}
+	}
+
+	// P = speedWeight G'G + moveWeight D'D, D the lever steps (first one from the lever applied)
+	float maxDiagonal = 0;
+	for (int i = 0; i < M; ++i)
+	{
+		for (int j = 0; j < M; ++j)
+		{
+			float gg = 0;
+			for (int k = 0; k < N; ++k)
+				gg += G[k][i] * G[k][j];
+			float dd = i == j ? (i < M - 1 ? 2.0f : 1.0f) : (i - j == 1 || j - i == 1 ? -1.0f : 0.0f);
+			P[i][j] = t.speedWeight * gg + t.moveWeight * dd;
+		}
+		maxDiagonal = P[i][i] > maxDiagonal ? P[i][i] : maxDiagonal;
+	}
+	if (maxDiagonal <= 0)
+		return false;
+
+	// scaled to a unit diagonal so one rho fits every aircraft
+	costScale = 1.0f / maxDiagonal;
+	for (int i = 0; i < M; ++i)
+		for (int j = 0; j < M; ++j)
+			P[i][j] *= costScale;
+
+	valid = factor(MPC_RHO);
+	return valid;
+}
+
+bool MPC::factor(float penalty)
+{
+	// K = P + sigma I + rho A'A with A = [I; D], A'A = I + D'D; K = L L'
+	const int M = tuning.moves;
+	for (int i = 0; i < M; ++i)
+	{
+		for (int j = 0; j <= i; ++j)
+		{
+			float dd = i == j ? (i < M - 1 ? 2.0f : 1.0f) : (i - j == 1 ? -1.0f : 0.0f);
+			float sum = P[i][j] + penalty * ((i == j ? 1.0f : 0.0f) + dd) + (i == j ? MPC_SIGMA : 0.0f);
+			for (int k = 0; k < j; ++k)
+				sum -= L[i][k] * L[j][k];
+			if (i == j)
+			{
+				if (sum <= 0)
+					return false;
+				L[i][i] = std::sqrt(sum);
+			} else
+				L[i][j] = sum / L[j][j];
+		}
+	}
+	rho = penalty;
+	return true;
+}
+
+void MPC::reset(float speed, float lever)
+{
+	spool = lever;
+	disturbance = model.damping * speed - model.gain * lever;
+	out = lever;
+	for (int j = 0; j < MPC_MAX_MOVES; ++j)
+		x[j] = lever;
+	for (int i = 0; i < 2 * MPC_MAX_MOVES; ++i)
+		y[i] = 0;
+}
+
+void MPC::predictFree(float speed, float s, float (&v)[MPC_MAX_HORIZON]) const
+{
+	for (int k = 0; k < tuning.horizon; ++k)
+	{
+		float next = Ad[0][0] * speed + Ad[0][1] * s + Ed[0] * disturbance;
+		s = Ad[1][0] * speed + Ad[1][1] * s + Ed[1] * disturbance;
+		speed = next;
+		v[k] = speed;
+	}
+}
+
+bool MPC::update(float reference, float speed, float rate, float lever, float limMin, float limMax, float dt)
+{
+	if (!valid || dt <= 0)
+		return false;
+	auto start = std::chrono::steady_clock::now();
+	const int N = tuning.horizon, M = tuning.moves;
+
+	// the engine followed the lever applied, d is what the model misses in the measured acceleration
+	spool += (lever - spool) * dt / (model.spoolTau + dt);
+	disturbance += (rate + model.damping * speed - model.gain * spool - disturbance) * dt / (tuning.disturbanceTau + dt);
+
+	float free[MPC_MAX_HORIZON];
+	predictFree(speed, spool, free);
+
+	// linear cost
+	float q[MPC_MAX_MOVES] = {};
+	for (int j = 0; j < M; ++j)
+	{
+		float sum = 0;
+		for (int k = 0; k < N; ++k)
+			sum += G[k][j] * (free[k] - reference);
+		q[j] = costScale * tuning.speedWeight * sum;
+	}
+	q[0] -= costScale * tuning.moveWeight * lever;
+
+	// bounds: levers, then lever steps; the first step may always reach the lever range
+	if (limMax < limMin)
+		limMax = limMin;
+	float lower[2 * MPC_MAX_MOVES], upper[2 * MPC_MAX_MOVES];
+	for (int j = 0; j < M; ++j)
+	{
+		lower[j] = limMin;
+		upper[j] = limMax;
+		lower[M + j] = -tuning.rateLimit * tuning.step;
+		upper[M + j] = tuning.rateLimit * tuning.step;
+	}
+	lower[M] = lever - tuning.rateLimit * dt;
+	upper[M] = lever + tuning.rateLimit * dt;
+	lower[M] = lower[M] < limMax ? lower[M] : limMax;
+	upper[M] = upper[M] > limMin ? upper[M] : limMin;
+
+	// A x with A = [I; D]; A' w
+	auto multiplyA = [&](const float* in, float* result) {
+		for (int j = 0; j < M; ++j)
+		{
+			result[j] = in[j];
+			result[M + j] = j > 0 ? in[j] - in[j - 1] : in[0];
+		}
+	};
+	auto multiplyAt = [&](const float* in, float* result) {
+		for (int j = 0; j < M; ++j)
+			result[j] = in[j] + in[M + j] - (j + 1 < M ? in[M + j + 1] : 0.0f);
+	};
+
+	const int rows = 2 * M;
+	float ax[2 * MPC_MAX_MOVES];
+	multiplyA(x, ax);
+	for (int i = 0; i < rows; ++i)
+		z[i] = clamp(ax[i], lower[i], upper[i]);
+
+	bool converged = false;
+	int iteration = 0;
+	while (!converged)
+	{
+		// x~ = K^-1 (sigma x - q + A' (rho z - y))
+		float w[2 * MPC_MAX_MOVES], rhs[MPC_MAX_MOVES], xt[MPC_MAX_MOVES];
+		for (int i = 0; i < rows; ++i)
+			w[i] = rho * z[i] - y[i];
+		multiplyAt(w, rhs);
+		for (int j = 0; j < M; ++j)
+			rhs[j] += MPC_SIGMA * x[j] - q[j];
+		for (int i = 0; i < M; ++i)
+		{
+			float sum = rhs[i];
+			for (int k = 0; k < i; ++k)
+				sum -= L[i][k] * xt[k];
+			xt[i] = sum / L[i][i];
+		}
+		for (int i = M - 1; i >= 0; --i)
+		{
+			float sum = xt[i];
+			for (int k = i + 1; k < M; ++k)
+				sum -= L[k][i] * xt[k];
+			xt[i] = sum / L[i][i];
+		}
+
+		// relaxed x and z, projection, dual step
+		float zt[2 * MPC_MAX_MOVES];
+		multiplyA(xt, zt);
+		for (int j = 0; j < M; ++j)
+			x[j] = MPC_ALPHA * xt[j] + (1.0f - MPC_ALPHA) * x[j];
+		for (int i = 0; i < rows; ++i)
+		{
+			float relaxed = MPC_ALPHA * zt[i] + (1.0f - MPC_ALPHA) * z[i];
+			float projected = clamp(relaxed + y[i] / rho, lower[i], upper[i]);
+			y[i] += rho * (relaxed - projected);
+			z[i] = projected;
+		}
+
+		if (++iteration % MPC_CHECK_EVERY)
+			continue;
+
+		// primal |Ax - z|, dual |Px + q + A'y|
+		multiplyA(x, ax);
+		float primal = 0, primalScale = 0;
+		for (int i = 0; i < rows; ++i)
+		{
+			primal = std::fmax(primal, std::fabs(ax[i] - z[i]));
+			primalScale = std::fmax(primalScale, std::fmax(std::fabs(ax[i]), std::fabs(z[i])));
+		}
+		float aty[MPC_MAX_MOVES];
+		multiplyAt(y, aty);
+		float dual = 0, dualScale = 0;
+		for (int i = 0; i < M; ++i)
+		{
+			float px = 0;
+			for (int j = 0; j < M; ++j)
+				px += P[i][j] * x[j];
+			dual = std::fmax(dual, std::fabs(px + q[i] + aty[i]));
+			dualScale = std::fmax(dualScale, std::fmax(std::fabs(px), std::fmax(std::fabs(aty[i]), std::fabs(q[i]))));
+		}
+		converged = primal <= MPC_EPS_ABS + MPC_EPS_REL * primalScale && dual <= MPC_EPS_ABS + MPC_EPS_REL * dualScale;
+		if (converged)
+			break;
+
+		std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() > tuning.budget || iteration >= MPC_MAX_ITERATIONS)
+			break;
+
+		// penalty balancing the relative residuals; refactoring is cheap at this size
+		float balance = std::sqrt((primal / (primalScale + 1e-9f)) / (dual / (dualScale + 1e-9f) + 1e-9f));
+		if (balance > MPC_RHO_ADAPT || balance * MPC_RHO_ADAPT < 1.0f)
+		{
+			float penalty = clamp(rho * balance, MPC_RHO_MIN, MPC_RHO_MAX);
+			if (penalty != rho)
+			{
+				float previous = rho;
+				if (!factor(penalty))
+					factor(previous);
+			}
+		}
+	}
+	lastIterations = iteration;
+	if (!converged)
+		return false;
+
+	// x and y stay as the next tick's start, a tick is far shorter than a move
+	out = clamp(clamp(x[0], lower[M], upper[M]), limMin, limMax);
+	return true;
+}
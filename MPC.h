@@ -0,0 +1,106 @@
+#ifndef MPC_CONTROLLER_H
+#define MPC_CONTROLLER_H
+
+/* fixed maximum sizes, nothing is allocated */
+#define MPC_MAX_HORIZON 40
+#define MPC_MAX_MOVES 10
+
+/*
+* Linear model predictive speed controller, an alternative to PID.
+*
+* Model, speed v [kts] and engine output s (lever units) under lever u:
+*
+*   dv/dt = -damping * v + gain * s + d
+*   ds/dt = (u - s) / spoolTau
+*
+* d lumps drag, trim and everything else the model does not know. It is
+* estimated from the measured speed and its rate (low-pass 'disturbanceTau')
+* and held constant over the horizon, which makes the controller offset free.
+* s is not measured, it is simulated from the levers actually applied.
+*
+* Each update predicts 'horizon' steps of 'step' seconds and picks 'moves'
+* lever values (the last one held to the end of the horizon) minimising
+*
+*   speedWeight * sum (v_k - reference)^2 + moveWeight * sum (u_j - u_j-1)^2
+*
+* subject to the lever limits and a lever rate limit. This is a dense QP of
+* 'moves' variables, solved by ADMM on a Cholesky factor computed once in
+* configure(). Each solve starts from the previous one's primal and dual
+* solution: it runs every tick, and a tick is much shorter than a move. It
+* stops when converged, or unconverged when 'budget' seconds of wall time
+* have passed: update() then returns false and the caller falls back to its
+* PID for this tick.
+*/
+class MPC
+{
+public:
+	struct Model
+	{
+		float gain = 4;				/* kts/s per unit of engine output */
+		float damping = 0.03f;		/* 1/s, speed stability from drag */
+		float spoolTau = 1.5f;		/* s */
+	};
+
+	struct Tuning
+	{
+		int horizon = 20;			/* prediction steps, up to MPC_MAX_HORIZON */
+		int moves = 5;				/* free lever moves, up to MPC_MAX_MOVES */
+		float step = 0.5f;			/* s */
+		float speedWeight = 1;
+		float moveWeight = 50;
+		float rateLimit = 0.2f;		/* lever units per s */
+		float disturbanceTau = 2;	/* s */
+		float budget = 200e-6f;		/* s of wall time per update */
+	};
+
+	/* builds the prediction and factors the QP; false if the model or tuning is unusable */
+	bool configure(const Model& m, const Tuning& t);
+	bool configured() const { return valid; }
+
+	/* engaging at steady speed with the lever at 'lever' */
+	void reset(float speed, float lever);
+
+	/*
+	* speed and rate [kts, kts/s] measured now, 'lever' the output applied
+	* over the last dt; returns false if the solve ran out of budget, output()
+	* is not to be used then
+	*/
+	bool update(float reference, float speed, float rate, float lever, float limMin, float limMax, float dt);
+
+	float output() const { return out; }
+	int iterations() const { return lastIterations; }
+
+private:
+	void predictFree(float speed, float spool, float (&v)[MPC_MAX_HORIZON]) const;
+	/* Cholesky factor of the ADMM system for the penalty */
+	bool factor(float penalty);
+
+	Model model;
+	Tuning tuning;
+	bool valid = false;
+
+	/* one step of the discretised model: x' = Ad x + Bd u + Ed d, x = (v, s) */
+	float Ad[2][2] = {};
+	float Bd[2] = {};
+	float Ed[2] = {};
+
+	/* speed at step k + 1 per unit of move j */
+	float G[MPC_MAX_HORIZON][MPC_MAX_MOVES] = {};
+	/* QP Hessian (scaled) and the Cholesky factor of the ADMM system */
+	float P[MPC_MAX_MOVES][MPC_MAX_MOVES] = {};
+	float L[MPC_MAX_MOVES][MPC_MAX_MOVES] = {};
+	float costScale = 1;
+	float rho = 0;
+
+	/* warm start: moves, constraint values and duals; rows 0..M-1 levers, M..2M-1 lever steps */
+	float x[MPC_MAX_MOVES] = {};
+	float z[2 * MPC_MAX_MOVES] = {};
+	float y[2 * MPC_MAX_MOVES] = {};
+
+	float spool = 0;
+	float disturbance = 0;
+	float out = 0;
+	int lastIterations = 0;
+};
+
+#endif
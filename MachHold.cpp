@@ -0,0 +1,71 @@
+#include "MachHold.h"
+
+/* time constant of the knots-per-Mach filter, s */
+#define MACH_HOLD_RATIO_TAU 2.0f
+/* below this the ratio is not updated, IAS / Mach is meaningless near standstill */
+#define MACH_HOLD_MIN_MACH 0.1f
+
+void MachHold::configure(float crossoverAltitude, float hysteresis)
+{
+	crossoverAlt = crossoverAltitude;
+	band = hysteresis;
+}
+
+void MachHold::reset(bool machMode, float ias, float machNumber)
+{
+	mach = machMode;
+	side = 0;
+	snapRatio(ias, machNumber);
+}
+
+void MachHold::snapRatio(float ias, float machNumber)
+{
+	if (machNumber > MACH_HOLD_MIN_MACH)
+		ktsPerMach = ias / machNumber;
+}
+
+bool MachHold::update(float pressureAltitude, float ias, float machNumber, float dt)
+{
+	if (machNumber > MACH_HOLD_MIN_MACH)
+		ktsPerMach += (ias / machNumber - ktsPerMach) * dt / (MACH_HOLD_RATIO_TAU + dt);
+
+	int now = sideOf(pressureAltitude);
+	if (0 == now || now == side)
+		return false;
+
+	// a side of the band reached from the other one, or for the first time
+	side = now;
+	bool wanted = side > 0;
+	if (wanted == mach)
+		return false;
+	mach = wanted;
+	snapRatio(ias, machNumber);
+	return true;
+}
+
+int MachHold::sideOf(float pressureAltitude) const
+{
+	if (!crossoverEnabled())
+		return 0;
+	if (pressureAltitude > crossoverAlt + 0.5f * band)
+		return 1;
+	if (pressureAltitude < crossoverAlt - 0.5f * band)
+		return -1;
+	return 0;
+}
+
+void MachHold::scaleGains(PIDController& gains) const
+{
+	if (!mach)
+		return;
+	gains.Kp *= ktsPerMach;
+	gains.Ki *= ktsPerMach;
+	gains.Kd *= ktsPerMach;
+}
+
+void MachHold::convertState(PIDController& pid, float measurement) const
+{
+	/* integrator and differentiator are in output units and carry over as they are */
+	pid.prevError *= mach ? 1.0f / ktsPerMach : ktsPerMach;
+	pid.prevMeasurement = measurement;
+}
@@ -0,0 +1,60 @@
+#ifndef MACH_HOLD_H
+#define MACH_HOLD_H
+
+#include "PID.h"
+
+/*
+* IAS or Mach as the held speed, with the crossover at a set pressure
+* altitude: climbing through it the hold changes to Mach, descending through
+* it back to IAS. Only crossing the altitude switches, in between the mode can
+* be set from outside (the autopilot's IAS/Mach flag).
+*
+* The loop is tuned in knots. A Mach error is some hundred times smaller than
+* the same speed error in knots, so in Mach mode the gains are multiplied by
+* the local knots-per-Mach ratio (IAS / Mach, low-pass filtered). The loop then
+* sees the same error in output units and keeps its bandwidth. The ratio also
+* converts setpoints and controller state when the mode changes.
+*/
+class MachHold
+{
+public:
+	/* crossover pressure altitude [ft], <= 0 = no automatic crossover; band: hysteresis around it [ft] */
+	void configure(float crossoverAltitude, float band);
+	bool crossoverEnabled() const { return crossoverAlt > 0; }
+
+	/* start in the given mode, ratio taken from the current speeds; the next update() applies the crossover for the altitude */
+	void reset(bool mach, float ias, float machNumber);
+
+	/* filters the ratio; returns true if the altitude crossed the crossover and changed the mode */
+	bool update(float pressureAltitude, float ias, float machNumber, float dt);
+
+	bool machMode() const { return mach; }
+	void setMode(bool machMode) { mach = machMode; }
+
+	/* kts per Mach at the current flight condition */
+	float ratio() const { return ktsPerMach; }
+	/* ratio straight from the speeds, unfiltered; for converting at a mode change */
+	void snapRatio(float ias, float machNumber);
+	float toMach(float ias) const { return ias / ktsPerMach; }
+	float toIas(float machNumber) const { return machNumber * ktsPerMach; }
+
+	/* gains tuned in knots to the current mode */
+	void scaleGains(PIDController& gains) const;
+	/*
+	* controller memory into the units of the mode now selected: the last error
+	* is converted, the last measurement becomes the current one (in the new
+	* unit) so the derivative does not see the change of units as a step
+	*/
+	void convertState(PIDController& pid, float measurement) const;
+
+private:
+	int sideOf(float pressureAltitude) const;
+
+	float crossoverAlt = 0;
+	float band = 0;
+	bool mach = false;
+	int side = 0;	/* -1 below the band, 1 above, 0 inside */
+	float ktsPerMach = 600;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "OperatingGrid.h"
+
+/* cap on the bin index per axis, breakpoints spaced closer than range/limit just cost a few steps */
+#define OPERATING_GRID_MAX_BINS 4096
+
+void OperatingGrid::clear()
+{
+	for (int a = 0; a < Axes; ++a)
+	{
+		axis[a] = AxisTable{};
+		strides[a] = 0;
+	}
+	gridSize = 0;
+}
+
+bool OperatingGrid::configure(const std::vector<float> (&breakpoints)[Axes])
+{
+	clear();
+
+	int size = 1;
+	for (int a = 0; a < Axes; ++a)
+	{
+		auto& bp = breakpoints[a];
+		auto& t = axis[a];
+
+		if (bp.size() > OPERATING_GRID_MAX_POINTS)
+		{
+			lastError = "too many breakpoints";
+			clear();
+			return false;
+		}
+
+		t.points = static_cast<int>(bp.size());
+		float narrowest = 0;
+		for (int i = 0; i < t.points; ++i)
+		{
+			t.bp[i] = bp[i];
+			if (i > 0)
+			{
+				float width = bp[i] - bp[i - 1];
+				if (!(width > 0))
+				{
+					lastError = "breakpoints not increasing";
+					clear();
+					return false;
+				}
+				if (1 == i || width < narrowest)
+					narrowest = width;
+			}
+		}
+
+		strides[a] = size;
+		if (t.points > 0)
+			size *= t.points;
+
+		if (t.points > 1)
+		{
+			float range = t.bp[t.points - 1] - t.bp[0];
+			int binCount = static_cast<int>(range / narrowest) + 1;
+			if (binCount > OPERATING_GRID_MAX_BINS)
+				binCount = OPERATING_GRID_MAX_BINS;
+
+			t.binScale = binCount / range;
+			t.bins.resize(binCount);
+			int segment = 0;
+			for (int b = 0; b < binCount; ++b)
+			{
+				float x = t.bp[0] + b / t.binScale;
+				while (segment < t.points - 2 && x >= t.bp[segment + 1])
+					++segment;
+				t.bins[b] = static_cast<unsigned char>(segment);
+			}
+		}
+	}
+
+	if (!uses(Ias) && !uses(Altitude) && !uses(Weight))
+	{
+		lastError = "no breakpoints";
+		clear();
+		return false;
+	}
+
+	lastError = "";
+	gridSize = size;
+	return true;
+}
+
+void OperatingGrid::locate(const AxisTable& t, float x, int& index, float& weight)
+{
+	if (t.points < 2 || x <= t.bp[0])
+	{
+		index = 0;
+		weight = 0;
+		return;
+	}
+	if (x >= t.bp[t.points - 1])
+	{
+		index = t.points - 2;
+		weight = 1;
+		return;
+	}
+
+	int bin = static_cast<int>((x - t.bp[0]) * t.binScale);
+	int last = static_cast<int>(t.bins.size()) - 1;
+	int i = t.bins[bin < last ? bin : last];
+	while (i < t.points - 2 && x >= t.bp[i + 1])
+		++i;
+
+	index = i;
+	weight = (x - t.bp[i]) / (t.bp[i + 1] - t.bp[i]);
+}
+
+int OperatingGrid::corners(const float (&point)[Axes], int (&offset)[Corners], float (&weight)[Corners]) const
+{
+	int index[Axes];
+	float upper[Axes];
+	for (int a = 0; a < Axes; ++a)
+		locate(axis[a], point[a], index[a], upper[a]);
+
+	// the 2^axes surrounding grid points, unused axes and clamped edges give weight 0 and are dropped
+	int count = 0;
+	for (int corner = 0; corner < Corners; ++corner)
+	{
+		float w = 1;
+		int o = 0;
+		for (int a = 0; a < Axes; ++a)
+		{
+			bool up = (corner >> a) & 1;
+			w *= up ? upper[a] : 1.0f - upper[a];
+			o += (index[a] + (up ? 1 : 0)) * strides[a];
+		}
+		if (w != 0)
+		{
+			offset[count] = o;
+			weight[count] = w;
+			++count;
+		}
+	}
+	return count;
+}
+
+float OperatingGrid::blend(const float* values, const int (&offset)[Corners], const float (&weight)[Corners], int count)
+{
+	float result = 0;
+	for (int c = 0; c < count; ++c)
+		result += weight[c] * values[offset[c]];
+	return result;
+}
@@ -0,0 +1,75 @@
+#ifndef OPERATING_GRID_H
+#define OPERATING_GRID_H
+
+#include <vector>
+
+/* breakpoints per axis */
+#define OPERATING_GRID_MAX_POINTS 32
+
+/*
+* Breakpoint grid over the operating point: IAS, pressure altitude and gross
+* weight. Any axis can be left out, so the grid is 1-D to 3-D. Tables on the
+* grid (GainSchedule, TrimTable) keep one value per grid point, IAS running
+* fastest, then altitude, then weight, and interpolate (bi-/tri-)linearly in
+* between with the corners() of the point; outside the breakpoints the edge
+* values hold.
+*
+* A lookup does not allocate: per axis a uniform bin index maps the input
+* straight to its segment (the bins are no wider than the narrowest segment,
+* so at most one step corrects the guess), then at most 8 grid points carry
+* weight. That is O(1) per tick regardless of the grid size.
+*/
+class OperatingGrid
+{
+public:
+	enum Axis
+	{
+		Ias,		/* kts */
+		Altitude,	/* pressure altitude, ft */
+		Weight,		/* gross weight, kg */
+		Axes
+	};
+
+	static const int Corners = 1 << Axes;
+
+	/*
+	* breakpoints: strictly increasing per axis, empty = axis not used, at
+	* least one axis used. Returns false and stays empty if not.
+	*/
+	bool configure(const std::vector<float> (&breakpoints)[Axes]);
+	void clear();
+
+	bool uses(Axis a) const { return axis[a].points > 0; }
+	int points(Axis a) const { return axis[a].points; }
+	/* offset between neighbouring grid points along the axis */
+	int stride(Axis a) const { return strides[a]; }
+	/* number of grid points, 0 if not configured */
+	int size() const { return gridSize; }
+
+	/* grid offsets and weights of the points around point, returns how many carry weight */
+	int corners(const float (&point)[Axes], int (&offset)[Corners], float (&weight)[Corners]) const;
+	/* table value at the corners */
+	static float blend(const float* values, const int (&offset)[Corners], const float (&weight)[Corners], int count);
+
+	/* why the last configure() failed */
+	const char* error() const { return lastError; }
+
+private:
+	struct AxisTable
+	{
+		int points = 0;
+		float bp[OPERATING_GRID_MAX_POINTS] = {};
+		float binScale = 0;
+		std::vector<unsigned char> bins;	/* uniform bin -> segment */
+	};
+
+	/* segment index and weight of the upper breakpoint */
+	static void locate(const AxisTable& t, float x, int& index, float& weight);
+
+	AxisTable axis[Axes];
+	int strides[Axes] = {};
+	int gridSize = 0;
+	const char* lastError = "";
+};
+
+#endif
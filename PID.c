@@ -1,4 +1,5 @@
 #include "PID.h"
+#include "PIDDenormal.h"
 
 
 void PIDController_Init(PIDController *pid) {
@@ -7,8 +8,40 @@ void PIDController_Init(PIDController *pid) {
 
 }
 
+static float PIDController_UpdateTerms(PIDController *pid, float setpoint, float measurement);
+
 float PIDController_Update(PIDController *pid, float setpoint, float measurement) {
 
+	float out;
+
+	if (pid->denormalMode == PID_DENORMAL_OFF) {
+
+		return PIDController_UpdateTerms(pid, setpoint, measurement);
+
+	}
+
+#if PID_HAS_MXCSR
+	if (pid->denormalMode == PID_DENORMAL_FTZ_DAZ) {
+
+		unsigned int csr = PID_EnterFtzDaz();
+		out = PIDController_UpdateTerms(pid, setpoint, measurement);
+		PID_LeaveFtzDaz(csr);
+		return out;
+
+	}
+#endif
+
+	/* Snap decayed state to zero before it turns subnormal */
+	out = PIDController_UpdateTerms(pid, setpoint, measurement);
+	pid->integrator = PID_FlushDenormal(pid->integrator);
+	pid->differentiator = PID_FlushDenormal(pid->differentiator);
+
+	return out;
+
+}
+
+static float PIDController_UpdateTerms(PIDController *pid, float setpoint, float measurement) {
+
 	/*
 	* Error signal
 	*/
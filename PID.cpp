@@ -1,4 +1,12 @@
 #include "PID.h"
+#include "BasicPID.h"
+#include "PIDDenormal.h"
+
+/* Variants PID dispatches into, also usable directly by other code */
+template class BasicPID<PIDTerms::P, float>;
+template class BasicPID<PIDTerms::PI, float>;
+template class BasicPID<PIDTerms::PD, float>;
+template class BasicPID<PIDTerms::PID, float>;
 
 PID::PID(float T, float Kp, float Ki, float Kd)
 {
@@ -9,6 +17,7 @@ PID::PID(float T, float Kp, float Ki, float Kd)
 	pid.prevMeasurement = 0.0f;
 
 	pid.out = 0.0f;
+	pid.denormalMode = PID_DENORMAL_OFF;
 
 	pid.Kd = Kd;
 	pid.Ki = Ki;
@@ -23,74 +32,147 @@ PID::PID(const PIDController& pidInit)
 
 float PID::update(float setpoint, float measurement)
 {
-	/*
-	* Error signal
-	*/
-	float error = setpoint - measurement;
+	if (0 == feedForward)
+		return updateResidual(pid, setpoint, measurement);
+
+	/* the terms run on the residual, against a copy with the limits shifted by the feedforward */
+	PIDController residual = pid;
+	residual.limMin -= feedForward, residual.limMax -= feedForward;
+	residual.limMinInt -= feedForward, residual.limMaxInt -= feedForward;
+	residual.out -= feedForward;
+	float error = updateResidual(residual, setpoint, measurement);
+
+	pid.integrator = residual.integrator;
+	pid.prevError = residual.prevError;
+	pid.differentiator = residual.differentiator;
+	pid.prevMeasurement = residual.prevMeasurement;
+	pid.out = residual.out + feedForward;
+	return error;
+}
 
+float PID::updateResidual(PIDController& c, float setpoint, float measurement)
+{
+	if (PID_DENORMAL_OFF == c.denormalMode)
+		return updateTerms(c, setpoint, measurement);
 
-	/*
-	* Proportional
-	*/
-	float proportional = pid.Kp * error;
+#if PID_HAS_MXCSR
+	if (PID_DENORMAL_FTZ_DAZ == c.denormalMode)
+	{
+		unsigned int csr = PID_EnterFtzDaz();
+		float error = updateTerms(c, setpoint, measurement);
+		PID_LeaveFtzDaz(csr);
+		return error;
+	}
+#endif
 
+	float error = updateTerms(c, setpoint, measurement);
+	c.integrator = PID_FlushDenormal(c.integrator);
+	c.differentiator = PID_FlushDenormal(c.differentiator);
+	return error;
+}
 
+float PID::update(float setpoint, float measurement, float rate)
+{
+	measurementRate = rate;
+	rateGiven = true;
+	float error = update(setpoint, measurement);
+	rateGiven = false;
+	return error;
+}
+
+float PID::updateTerms(PIDController& c, float setpoint, float measurement)
+{
 	/*
-	* Integral
+	* Gains can be changed at any time through data(), so the coefficients are
+	* checked and the variant is picked per call. A term with zero gain has its
+	* state cleared, as it always had.
 	*/
-	if (pid.Ki != 0)
-	{
-		pid.integrator = pid.integrator + 0.5f * pid.Ki * pid.T * (error + pid.prevError);
+	BasicPID<PIDTerms::PID, float>::refresh(coef, c, timeTolerance);
 
-		/* Anti-wind-up via integrator clamping */
-		if (pid.integrator > pid.limMaxInt)
-		{
-			pid.integrator = pid.limMaxInt;
+	float error;
 
-		} else if (pid.integrator < pid.limMinInt)
+	if (c.Ki != 0)
+	{
+		if (0 == c.Kd)
 		{
-			pid.integrator = pid.limMinInt;
-
-		}
+			c.differentiator = 0;
+			error = BasicPID<PIDTerms::PI, float>::step(c, coef, setpoint, measurement);
+		} else
+			error = BasicPID<PIDTerms::PID, float>::step(c, coef, setpoint, measurement);
 	} else
-		pid.integrator = 0;
+	{
+		c.integrator = 0;
 
+		if (0 == c.Kd)
+		{
+			c.differentiator = 0;
+			error = BasicPID<PIDTerms::P, float>::step(c, coef, setpoint, measurement);
+		} else
+			error = BasicPID<PIDTerms::PD, float>::step(c, coef, setpoint, measurement);
+	}
 
+	/* an estimated rate replaces the differenced measurement */
+	if (rateGiven && c.Kd != 0)
+		c.differentiator = -c.Kd * measurementRate;
 
 	/*
-	* Derivative (band-limited differentiator)
+	* Setpoint weighting: P and D are recomputed around the step's integrator
+	* and measurement derivative. The derivative filter is linear, so the
+	* setpoint's part runs as a second differentiator on the same coefficients.
 	*/
-	if (0 == pid.Kd)
-		pid.differentiator = 0;
-	else
+	bool weighted = 1.0f != weightP || 0.0f != weightD;
+	float unclamped = 0;
+	if (weighted || rateGiven)
 	{
-		pid.differentiator = -(2.0f * pid.Kd * (measurement - pid.prevMeasurement)	/* Note: derivative on measurement, therefore minus sign in front of equation! */
-							   + (2.0f * pid.tau - pid.T) * pid.differentiator)
-			/ (2.0f * pid.tau + pid.T);
+		float change = setpointPrimed ? setpoint - prevSetpoint : 0.0f;
+		if (!setpointPrimed || 0 == c.Ki || c.Kp <= 0)
+			setpointAnchor = setpoint;
+		else
+			setpointAnchor += (setpoint - setpointAnchor) * c.T / (c.Kp / c.Ki + c.T);
+
+		if (c.Kd != 0)
+			setpointDifferentiator = weightD * coef.derivative * change - coef.derivativeDecay * setpointDifferentiator;
+		else
+			setpointDifferentiator = 0;
+
+		float weightedSetpoint = weightP * setpoint + (1.0f - weightP) * setpointAnchor;
+		unclamped = c.Kp * (weightedSetpoint - measurement) + c.integrator + c.differentiator + setpointDifferentiator;
+		if (unclamped > c.limMax)
+			c.out = c.limMax;
+		else if (unclamped < c.limMin)
+			c.out = c.limMin;
+		else
+			c.out = unclamped;
 	}
 
 	/*
-	* Compute output and apply limits
+	* Back-calculation: when the output limits cut the output, pull the
+	* integrator towards the value that would just produce the limited output.
+	* Keeps the integrator from winding up against limits that move, where the
+	* fixed integrator clamp does not help.
 	*/
-	pid.out = proportional + pid.integrator + pid.differentiator;
-
-	if (pid.out > pid.limMax)
-	{
-
-		pid.out = pid.limMax;
-
-	} else if (pid.out < pid.limMin)
+	if (trackingGain > 0 && c.Ki != 0)
 	{
+		if (!weighted && !rateGiven)
+			unclamped = c.Kp * error + c.integrator + c.differentiator;
+		if (unclamped != c.out)
+		{
+			float k = trackingGain * c.T;
+			c.integrator += (k < 1.0f ? k : 1.0f) * (c.out - unclamped);
 
-		pid.out = pid.limMin;
-
+			if (c.integrator > c.limMaxInt)
+				c.integrator = c.limMaxInt;
+			else if (c.integrator < c.limMinInt)
+				c.integrator = c.limMinInt;
+		}
 	}
 
-	/* Store error and measurement for later use */
-	pid.prevError = error;
-	pid.prevMeasurement = measurement;
+	/* Store error and measurement for later use, also for disabled terms */
+	c.prevError = error;
+	c.prevMeasurement = measurement;
+	prevSetpoint = setpoint;
+	setpointPrimed = true;
 
-	/* Return controller output */
 	return error;
 }
 
@@ -98,3 +180,50 @@ void PID::updateConfig(const PIDController& ctrl)
 {
 	pid = ctrl;
 }
+
+void PID::switchGains(const PIDController& ctrl)
+{
+	/* the differentiator state carries Kd, rescale it to the new gain */
+	pid.differentiator = pid.Kd != 0 ? pid.differentiator * ctrl.Kd / pid.Kd : 0.0f;
+	setpointDifferentiator = pid.Kd != 0 ? setpointDifferentiator * ctrl.Kd / pid.Kd : 0.0f;
+
+	pid.Kp = ctrl.Kp;
+	pid.Ki = ctrl.Ki;
+	pid.Kd = ctrl.Kd;
+	pid.tau = ctrl.tau;
+	pid.limMin = ctrl.limMin;
+	pid.limMax = ctrl.limMax;
+	pid.limMinInt = ctrl.limMinInt;
+	pid.limMaxInt = ctrl.limMaxInt;
+
+	/* the coefficients follow on the next update, refresh() sees the new gains */
+	matchIntegrator();
+}
+
+void PID::trackOutput(float out)
+{
+	pid.out = out;
+	matchIntegrator();
+}
+
+void PID::matchIntegrator()
+{
+	/*
+	* Bumpless transfer: with the last error the proportional and derivative
+	* terms plus the integrator and the feedforward reproduce the current output.
+	*/
+	if (pid.Ki != 0)
+	{
+		bool weighted = 1.0f != weightP || 0.0f != weightD;
+		float weightedSetpoint = weightP * prevSetpoint + (1.0f - weightP) * setpointAnchor;
+		float proportional = weighted ? pid.Kp * (weightedSetpoint - pid.prevMeasurement) : pid.Kp * pid.prevError;
+		float derivative = weighted ? pid.differentiator + setpointDifferentiator : pid.differentiator;
+		pid.integrator = pid.out - feedForward - proportional - derivative;
+
+		if (pid.integrator > pid.limMaxInt - feedForward)
+			pid.integrator = pid.limMaxInt - feedForward;
+		else if (pid.integrator < pid.limMinInt - feedForward)
+			pid.integrator = pid.limMinInt - feedForward;
+	} else
+		pid.integrator = 0;
+}
@@ -32,23 +32,111 @@ typedef struct
 	/* Controller output */
 	float out;
 
+	/* Denormal protection, one of PID_DENORMAL_* */
+	int denormalMode;
+
 } PIDController;
 
+enum
+{
+	PID_DENORMAL_OFF = 0,		/* state may decay into subnormal floats */
+	PID_DENORMAL_FLUSH = 1,		/* snap integrator/differentiator to 0 below PID_DENORMAL_THRESHOLD */
+	PID_DENORMAL_FTZ_DAZ = 2	/* FTZ/DAZ set only for the duration of the update (x86), FLUSH elsewhere */
+};
+
+/* far below anything a throttle command resolves, and well above FLT_MIN so intermediates stay normal too */
+#define PID_DENORMAL_THRESHOLD 1e-30f
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* C implementation, PID.c */
+void PIDController_Init(PIDController *pid);
+float PIDController_Update(PIDController *pid, float setpoint, float measurement);
+
+#ifdef __cplusplus
+}
+
 class PID
 {
 	PIDController pid;
 
+	/* precomputed integrator/differentiator coefficients, see BasicPID.h */
+	struct Coefficients
+	{
+		float Ki, integral;
+		float Kd, tau, derivative, derivativeDecay;
+		float T;
+		bool valid;
+	} coef{};
+	float timeTolerance = 0;
+	float trackingGain = 0;
+	float feedForward = 0;
+
+	/* setpoint weights of the proportional and derivative term, the setpoint the P weight fades to, the derivative's setpoint part */
+	float weightP = 1;
+	float weightD = 0;
+	float setpointAnchor = 0;
+	float setpointDifferentiator = 0;
+	float prevSetpoint = 0;
+	bool setpointPrimed = false;
+
+	/* measurement rate for the derivative, from update(setpoint, measurement, rate) */
+	float measurementRate = 0;
+	bool rateGiven = false;
+
+	/* one step on c: pid itself, or a copy with the limits of the residual while a feedforward is set */
+	float updateTerms(PIDController& c, float setpoint, float measurement);
+	float updateResidual(PIDController& c, float setpoint, float measurement);
+	/* integrator re-initialised so the terms reproduce pid.out */
+	void matchIntegrator();
+
 public:
 	explicit PID(float T, float Kp, float Ki, float Kd);
 	explicit PID(const PIDController& pid);
 
 	float update(float setpoint, float measurement);
+	/*
+	* with the rate of the measurement from an estimator: D is -Kd * rate
+	* instead of the filtered difference of successive measurements
+	*/
+	float update(float setpoint, float measurement, float rate);
 	void updateConfig(const PIDController& ctrl);
+	/* new gains and limits from ctrl, controller state kept; the integrator is re-initialised so the output does not jump */
+	void switchGains(const PIDController& ctrl);
+	/* another controller drove the output: continue from out, bumpless like switchGains */
+	void trackOutput(float out);
 	void setTime(float t) { pid.T = t; }
+	/* relative change of T tolerated before the coefficients are recomputed, 0 = any change */
+	void setTimeTolerance(float relative) { timeTolerance = relative; }
 	PIDController& data() { return pid; }
 	void setLimits(float lower, float upper) { pid.limMax = upper, pid.limMin = lower; }
 	void setMinLimit(float lower) { pid.limMin = lower; }
 	void setMaxLimit(float upper) { pid.limMax = upper; }
+	void setDenormalMode(int mode) { pid.denormalMode = mode; }
+	/*
+	* output added to the terms, e.g. the steady lever for the setpoint. The
+	* output and integrator limits stay on the total, the integrator holds
+	* only the residual; takes effect on the next update.
+	*/
+	void setFeedForward(float u) { feedForward = u; }
+	float feedForwardValue() const { return feedForward; }
+	/* integrator back-calculation when the output is limited, 1/s, 0 = off (integrator clamp only) */
+	void setTrackingGain(float gain) { trackingGain = gain; }
+	/*
+	* Two-degree-of-freedom: P sees only the fraction b of a setpoint change,
+	* D acts on c * setpoint - measurement, I on the full error. b = 1, c = 0
+	* (the default) is the plain controller with derivative on measurement.
+	* Unlike the textbook b * setpoint, the part of a change P does not see
+	* fades in with the integral time Kp / Ki: the integrator limits are far too
+	* tight to ever hold Kp * (1 - b) * setpoint.
+	*/
+	void setSetpointWeights(float b, float c) { weightP = b, weightD = c; }
+	/* the next update sees no setpoint change, e.g. after the setpoint changed units */
+	void holdSetpoint(float setpoint) { prevSetpoint = setpointAnchor = setpoint, setpointPrimed = true; }
 };
 
 #endif
+
+#endif
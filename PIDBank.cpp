@@ -0,0 +1,397 @@
+#include "PIDBank.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIDBANK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PIDBANK_TARGET_AVX
+#else
+#define PIDBANK_TARGET_AVX __attribute__((target("avx")))
+#endif
+#else
+#define PIDBANK_X86 0
+#endif
+
+namespace
+{
+	enum : std::size_t
+	{
+		FieldCount = 17,
+		Lanes = 8
+	};
+
+	bool cpuHasAvx()
+	{
+#if PIDBANK_X86 && defined(_MSC_VER)
+		int regs[4] = { 0 };
+		__cpuid(regs, 1);
+		bool osxsave = (regs[2] & (1 << 27)) != 0;
+		bool avx = (regs[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx)
+			return false;
+
+		/* OS must save the YMM registers on context switch */
+		return (_xgetbv(0) & 0x6) == 0x6;
+#elif PIDBANK_X86
+		return __builtin_cpu_supports("avx");
+#else
+		return false;
+#endif
+	}
+}
+
+PIDBank::PIDBank(std::size_t channels, Kernel kernel)
+{
+	count = channels;
+	stride = (channels + Lanes - 1) / Lanes * Lanes;
+	storage.assign(FieldCount * stride, 0.0f);
+
+	float* base = storage.data();
+	Kp = base + 0 * stride;
+	Ki = base + 1 * stride;
+	Kd = base + 2 * stride;
+	tau = base + 3 * stride;
+	limMin = base + 4 * stride;
+	limMax = base + 5 * stride;
+	limMinInt = base + 6 * stride;
+	limMaxInt = base + 7 * stride;
+	T = base + 8 * stride;
+	integrator = base + 9 * stride;
+	prevError = base + 10 * stride;
+	differentiator = base + 11 * stride;
+	prevMeasurement = base + 12 * stride;
+	output = base + 13 * stride;
+	kIntegral = base + 14 * stride;
+	kDerivative = base + 15 * stride;
+	kDerivativeDecay = base + 16 * stride;
+
+	if (!setKernel(kernel))
+		setKernel(Kernel::Auto);
+}
+
+void PIDBank::setChannel(std::size_t ch, const PIDController& ctrl)
+{
+	Kp[ch] = ctrl.Kp;
+	Ki[ch] = ctrl.Ki;
+	Kd[ch] = ctrl.Kd;
+	tau[ch] = ctrl.tau;
+	limMin[ch] = ctrl.limMin;
+	limMax[ch] = ctrl.limMax;
+	limMinInt[ch] = ctrl.limMinInt;
+	limMaxInt[ch] = ctrl.limMaxInt;
+	T[ch] = ctrl.T;
+	integrator[ch] = ctrl.integrator;
+	prevError[ch] = ctrl.prevError;
+	differentiator[ch] = ctrl.differentiator;
+	prevMeasurement[ch] = ctrl.prevMeasurement;
+	output[ch] = ctrl.out;
+
+	refreshCoefficients(ch);
+}
+
+void PIDBank::refreshCoefficients(std::size_t ch)
+{
+	kIntegral[ch] = 0.5f * Ki[ch] * T[ch];
+	kDerivative[ch] = 2.0f * Kd[ch] / (2.0f * tau[ch] + T[ch]);
+	kDerivativeDecay[ch] = (2.0f * tau[ch] - T[ch]) / (2.0f * tau[ch] + T[ch]);
+}
+
+PIDController PIDBank::channel(std::size_t ch) const
+{
+	PIDController ctrl{ 0 };
+
+	ctrl.Kp = Kp[ch];
+	ctrl.Ki = Ki[ch];
+	ctrl.Kd = Kd[ch];
+	ctrl.tau = tau[ch];
+	ctrl.limMin = limMin[ch];
+	ctrl.limMax = limMax[ch];
+	ctrl.limMinInt = limMinInt[ch];
+	ctrl.limMaxInt = limMaxInt[ch];
+	ctrl.T = T[ch];
+	ctrl.integrator = integrator[ch];
+	ctrl.prevError = prevError[ch];
+	ctrl.differentiator = differentiator[ch];
+	ctrl.prevMeasurement = prevMeasurement[ch];
+	ctrl.out = output[ch];
+
+	return ctrl;
+}
+
+void PIDBank::setTime(float t)
+{
+	for (std::size_t i = 0; i < count; ++i)
+		setTime(i, t);
+}
+
+void PIDBank::setTime(std::size_t ch, float t)
+{
+	if (T[ch] == t)
+		return;
+
+	T[ch] = t;
+	refreshCoefficients(ch);
+}
+
+void PIDBank::reset()
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		integrator[i] = 0.0f;
+		prevError[i] = 0.0f;
+		differentiator[i] = 0.0f;
+		prevMeasurement[i] = 0.0f;
+		output[i] = 0.0f;
+	}
+}
+
+bool PIDBank::kernelSupported(Kernel k)
+{
+	switch (k)
+	{
+		case Kernel::Auto:
+		case Kernel::Scalar:
+			return true;
+		case Kernel::SSE:
+			return PIDBANK_X86 != 0;
+		case Kernel::AVX:
+			return cpuHasAvx();
+	}
+	return false;
+}
+
+bool PIDBank::setKernel(Kernel k)
+{
+	if (!kernelSupported(k))
+		return false;
+
+	if (Kernel::Auto == k)
+	{
+		if (kernelSupported(Kernel::AVX))
+			k = Kernel::AVX;
+		else if (kernelSupported(Kernel::SSE))
+			k = Kernel::SSE;
+		else
+			k = Kernel::Scalar;
+	}
+
+	active = k;
+	return true;
+}
+
+const char* PIDBank::kernelName(Kernel k)
+{
+	switch (k)
+	{
+		case Kernel::Auto:
+			return "auto";
+		case Kernel::Scalar:
+			return "scalar";
+		case Kernel::SSE:
+			return "sse";
+		case Kernel::AVX:
+			return "avx";
+	}
+	return "unknown";
+}
+
+void PIDBank::update(const float* setpoint, const float* measurement)
+{
+	switch (active)
+	{
+		case Kernel::AVX:
+			updateAVX(setpoint, measurement);
+			break;
+
+		case Kernel::SSE:
+			updateSSE(setpoint, measurement);
+			break;
+
+		default:
+			updateScalar(0, setpoint, measurement);
+			break;
+	}
+}
+
+/*
+* Same statement order as PID::update, one channel after the other.
+* Also used for the tail of the vector kernels.
+*/
+void PIDBank::updateScalar(std::size_t first, const float* setpoint, const float* measurement)
+{
+	for (std::size_t i = first; i < count; ++i)
+	{
+		float error = setpoint[i] - measurement[i];
+		float proportional = Kp[i] * error;
+
+		if (Ki[i] != 0)
+		{
+			integrator[i] = integrator[i] + kIntegral[i] * (error + prevError[i]);
+
+			if (integrator[i] > limMaxInt[i])
+			{
+				integrator[i] = limMaxInt[i];
+
+			} else if (integrator[i] < limMinInt[i])
+			{
+				integrator[i] = limMinInt[i];
+
+			}
+		} else
+			integrator[i] = 0;
+
+		if (0 == Kd[i])
+			differentiator[i] = 0;
+		else
+		{
+			differentiator[i] = -(kDerivative[i] * (measurement[i] - prevMeasurement[i])
+								  + kDerivativeDecay[i] * differentiator[i]);
+		}
+
+		float out = proportional + integrator[i] + differentiator[i];
+
+		if (out > limMax[i])
+		{
+			out = limMax[i];
+
+		} else if (out < limMin[i])
+		{
+			out = limMin[i];
+
+		}
+		output[i] = out;
+
+		prevError[i] = error;
+		prevMeasurement[i] = measurement[i];
+	}
+}
+
+#if PIDBANK_X86
+
+namespace
+{
+	/* mask ? b : a, SSE2 only */
+	inline __m128 select(__m128 a, __m128 b, __m128 mask)
+	{
+		return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+	}
+
+	/* mask ? b : a; plain and/andnot/or, GCC scalarises blendv with some flags */
+	PIDBANK_TARGET_AVX
+	inline __m256 select(__m256 a, __m256 b, __m256 mask)
+	{
+		return _mm256_or_ps(_mm256_andnot_ps(mask, a), _mm256_and_ps(mask, b));
+	}
+}
+
+void PIDBank::updateSSE(const float* setpoint, const float* measurement)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sp = _mm_loadu_ps(setpoint + i);
+		__m128 meas = _mm_loadu_ps(measurement + i);
+
+		__m128 error = _mm_sub_ps(sp, meas);
+		__m128 proportional = _mm_mul_ps(_mm_loadu_ps(Kp + i), error);
+
+		/* Integral */
+		__m128 ki = _mm_loadu_ps(Ki + i);
+		__m128 maxInt = _mm_loadu_ps(limMaxInt + i);
+		__m128 minInt = _mm_loadu_ps(limMinInt + i);
+		__m128 integ = _mm_add_ps(_mm_loadu_ps(integrator + i),
+			_mm_mul_ps(_mm_loadu_ps(kIntegral + i), _mm_add_ps(error, _mm_loadu_ps(prevError + i))));
+		__m128 clamped = select(integ, minInt, _mm_cmplt_ps(integ, minInt));
+		clamped = select(clamped, maxInt, _mm_cmpgt_ps(integ, maxInt));
+		integ = select(clamped, zero, _mm_cmpeq_ps(ki, zero));
+
+		/* Derivative (band-limited differentiator) */
+		__m128 kd = _mm_loadu_ps(Kd + i);
+		__m128 sum = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(kDerivative + i), _mm_sub_ps(meas, _mm_loadu_ps(prevMeasurement + i))),
+			_mm_mul_ps(_mm_loadu_ps(kDerivativeDecay + i), _mm_loadu_ps(differentiator + i)));
+		__m128 diff = _mm_xor_ps(sum, signBit);
+		diff = select(diff, zero, _mm_cmpeq_ps(kd, zero));
+
+		/* Output and limits */
+		__m128 out = _mm_add_ps(_mm_add_ps(proportional, integ), diff);
+		__m128 lo = _mm_loadu_ps(limMin + i);
+		__m128 hi = _mm_loadu_ps(limMax + i);
+		__m128 limited = select(out, lo, _mm_cmplt_ps(out, lo));
+		limited = select(limited, hi, _mm_cmpgt_ps(out, hi));
+
+		_mm_storeu_ps(integrator + i, integ);
+		_mm_storeu_ps(differentiator + i, diff);
+		_mm_storeu_ps(output + i, limited);
+		_mm_storeu_ps(prevError + i, error);
+		_mm_storeu_ps(prevMeasurement + i, meas);
+	}
+
+	updateScalar(i, setpoint, measurement);
+}
+
+PIDBANK_TARGET_AVX
+void PIDBank::updateAVX(const float* setpoint, const float* measurement)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sp = _mm256_loadu_ps(setpoint + i);
+		__m256 meas = _mm256_loadu_ps(measurement + i);
+
+		__m256 error = _mm256_sub_ps(sp, meas);
+		__m256 proportional = _mm256_mul_ps(_mm256_loadu_ps(Kp + i), error);
+
+		/* Integral */
+		__m256 ki = _mm256_loadu_ps(Ki + i);
+		__m256 maxInt = _mm256_loadu_ps(limMaxInt + i);
+		__m256 minInt = _mm256_loadu_ps(limMinInt + i);
+		__m256 integ = _mm256_add_ps(_mm256_loadu_ps(integrator + i),
+			_mm256_mul_ps(_mm256_loadu_ps(kIntegral + i), _mm256_add_ps(error, _mm256_loadu_ps(prevError + i))));
+		__m256 clamped = select(integ, minInt, _mm256_cmp_ps(integ, minInt, _CMP_LT_OQ));
+		clamped = select(clamped, maxInt, _mm256_cmp_ps(integ, maxInt, _CMP_GT_OQ));
+		integ = select(clamped, zero, _mm256_cmp_ps(ki, zero, _CMP_EQ_OQ));
+
+		/* Derivative (band-limited differentiator) */
+		__m256 kd = _mm256_loadu_ps(Kd + i);
+		__m256 sum = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(kDerivative + i), _mm256_sub_ps(meas, _mm256_loadu_ps(prevMeasurement + i))),
+			_mm256_mul_ps(_mm256_loadu_ps(kDerivativeDecay + i), _mm256_loadu_ps(differentiator + i)));
+		__m256 diff = _mm256_xor_ps(sum, signBit);
+		diff = select(diff, zero, _mm256_cmp_ps(kd, zero, _CMP_EQ_OQ));
+
+		/* Output and limits */
+		__m256 out = _mm256_add_ps(_mm256_add_ps(proportional, integ), diff);
+		__m256 lo = _mm256_loadu_ps(limMin + i);
+		__m256 hi = _mm256_loadu_ps(limMax + i);
+		__m256 limited = select(out, lo, _mm256_cmp_ps(out, lo, _CMP_LT_OQ));
+		limited = select(limited, hi, _mm256_cmp_ps(out, hi, _CMP_GT_OQ));
+
+		_mm256_storeu_ps(integrator + i, integ);
+		_mm256_storeu_ps(differentiator + i, diff);
+		_mm256_storeu_ps(output + i, limited);
+		_mm256_storeu_ps(prevError + i, error);
+		_mm256_storeu_ps(prevMeasurement + i, meas);
+	}
+
+	updateScalar(i, setpoint, measurement);
+}
+
+#else
+
+void PIDBank::updateSSE(const float* setpoint, const float* measurement)
+{
+	updateScalar(0, setpoint, measurement);
+}
+
+void PIDBank::updateAVX(const float* setpoint, const float* measurement)
+{
+	updateScalar(0, setpoint, measurement);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PID_BANK_H
+#define PID_BANK_H
+
+#include <cstddef>
+#include <vector>
+
+#include "PID.h"
+
+/*
+* Bank of independent PID channels stored as structure-of-arrays.
+*
+* Every channel runs exactly the same arithmetic as PID::update, in the same
+* order, so results are bit-for-bit identical to a PID instance fed with the
+* same inputs (with the default time tolerance of 0 and PID_DENORMAL_OFF). Like PID the bank keeps
+* the discretisation coefficients precomputed; they are refreshed whenever a
+* channel or its sample time is set. The vector kernels only use IEEE add/sub/mul/div and compare +
+* blend for the clamps, which is why they can match the scalar code exactly.
+* Note: the compiler must not contract a*b+c into FMA (MSVC /fp:precise does
+* not, GCC/Clang need -ffp-contract=off), otherwise no two paths agree anyway.
+*/
+class PIDBank
+{
+public:
+	enum class Kernel
+	{
+		Auto,		/* best kernel the CPU supports */
+		Scalar,
+		SSE,
+		AVX
+	};
+
+	explicit PIDBank(std::size_t channels, Kernel kernel = Kernel::Auto);
+	PIDBank(const PIDBank&) = delete;
+	PIDBank& operator=(const PIDBank&) = delete;
+
+	std::size_t size() const { return count; }
+
+	void setChannel(std::size_t ch, const PIDController& ctrl);
+	PIDController channel(std::size_t ch) const;
+
+	void setTime(float t);
+	void setTime(std::size_t ch, float t);
+	void setLimits(std::size_t ch, float lower, float upper) { limMin[ch] = lower, limMax[ch] = upper; }
+	void reset();
+
+	/* setpoint and measurement hold size() values each */
+	void update(const float* setpoint, const float* measurement);
+
+	float out(std::size_t ch) const { return output[ch]; }
+	const float* outputs() const { return output; }
+
+	Kernel kernel() const { return active; }
+	bool setKernel(Kernel k);
+	static bool kernelSupported(Kernel k);
+	static const char* kernelName(Kernel k);
+
+private:
+	void refreshCoefficients(std::size_t ch);
+	void updateScalar(std::size_t first, const float* setpoint, const float* measurement);
+	void updateSSE(const float* setpoint, const float* measurement);
+	void updateAVX(const float* setpoint, const float* measurement);
+
+	std::size_t count = 0;
+	std::size_t stride = 0;		/* channel count padded to a multiple of 8 */
+	Kernel active = Kernel::Scalar;
+	std::vector<float> storage;
+
+	/* Gains and limits */
+	float* Kp = nullptr;
+	float* Ki = nullptr;
+	float* Kd = nullptr;
+	float* tau = nullptr;
+	float* limMin = nullptr;
+	float* limMax = nullptr;
+	float* limMinInt = nullptr;
+	float* limMaxInt = nullptr;
+	float* T = nullptr;
+
+	/* Precomputed coefficients, same formulas as BasicPID::refresh */
+	float* kIntegral = nullptr;
+	float* kDerivative = nullptr;
+	float* kDerivativeDecay = nullptr;
+
+	/* Controller "memory" */
+	float* integrator = nullptr;
+	float* prevError = nullptr;
+	float* differentiator = nullptr;
+	float* prevMeasurement = nullptr;
+
+	float* output = nullptr;
+};
+
+#endif
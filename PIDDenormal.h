@@ -0,0 +1,48 @@
+#ifndef PID_DENORMAL_H
+#define PID_DENORMAL_H
+
+/*
+* Helpers for PID_DENORMAL_* modes, shared by PID.c and PID.cpp.
+*
+* In steady state the band-limited differentiator decays geometrically and,
+* with a decay factor close to 1, gets stuck in the subnormal range where x86
+* arithmetic takes a microcode assist on every operation.
+*/
+
+#include "PID.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#define PID_HAS_MXCSR 1
+#define PID_MXCSR_FTZ_DAZ 0x8040u	/* flush-to-zero (bit 15) | denormals-are-zero (bit 6) */
+#else
+#define PID_HAS_MXCSR 0
+#endif
+
+static inline float PID_FlushDenormal(float x)
+{
+	return (x < PID_DENORMAL_THRESHOLD && x > -PID_DENORMAL_THRESHOLD) ? 0.0f : x;
+}
+
+/* Returns the previous control word, to be passed to PID_LeaveFtzDaz */
+static inline unsigned int PID_EnterFtzDaz(void)
+{
+#if PID_HAS_MXCSR
+	unsigned int csr = _mm_getcsr();
+	_mm_setcsr(csr | PID_MXCSR_FTZ_DAZ);
+	return csr;
+#else
+	return 0;
+#endif
+}
+
+static inline void PID_LeaveFtzDaz(unsigned int csr)
+{
+#if PID_HAS_MXCSR
+	_mm_setcsr(csr);
+#else
+	(void)csr;
+#endif
+}
+
+#endif
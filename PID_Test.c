@@ -21,8 +21,14 @@
 /* Maximum run-time of simulation */
 #define SIMULATION_TIME_MAX 4.0f
 
-/* Simulated dynamical system (first order) */
-float TestSystem_Update(float inp);
+/* Simulated dynamical system (first order), state per instance */
+typedef struct
+{
+    float output;
+    float alpha;
+} TestSystem;
+
+float TestSystem_Update(TestSystem *sys, float inp);
 
 int main()
 {
@@ -35,6 +41,8 @@ int main()
 
     PIDController_Init(&pid);
 
+    TestSystem sys = { 0.0f, 0.02f };
+
     /* Simulate response using test system */
     float setpoint = 1.0f;
 
@@ -42,7 +50,7 @@ int main()
     for (float t = 0.0f; t <= SIMULATION_TIME_MAX; t += SAMPLE_TIME_S) {
 
         /* Get measurement from system */
-        float measurement = TestSystem_Update(pid.out);
+        float measurement = TestSystem_Update(&sys, pid.out);
 
         /* Compute new control signal */
         PIDController_Update(&pid, setpoint, measurement);
@@ -54,12 +62,9 @@ int main()
     return 0;
 }
 
-float TestSystem_Update(float inp) {
-
-    static float output = 0.0f;
-    static const float alpha = 0.02f;
+float TestSystem_Update(TestSystem *sys, float inp) {
 
-    output = (SAMPLE_TIME_S * inp + output) / (1.0f + alpha * SAMPLE_TIME_S);
+    sys->output = (SAMPLE_TIME_S * inp + sys->output) / (1.0f + sys->alpha * SAMPLE_TIME_S);
 
-    return output;
+    return sys->output;
 }
@@ -0,0 +1,107 @@
+#include "PlantEstimator.h"
+
+#include <cmath>
+
+/* standard deviations of the starting estimate: gain as a fraction of itself, damping [1/s], bias [kts/s] */
+#define PLANT_ESTIMATOR_GAIN_SD 1.0f
+#define PLANT_ESTIMATOR_DAMPING_SD 0.05f
+#define PLANT_ESTIMATOR_BIAS_SD 1.0f
+/* starting residual, kts/s */
+#define PLANT_ESTIMATOR_RESIDUAL 0.1f
+
+void PlantEstimator::reset(float speed, float lever)
+{
+	referenceSpeed = speed;
+	spool = lever;
+	theta[Gain] = settings.gain;
+	theta[Damping] = settings.damping;
+	theta[Bias] = -settings.gain * lever;
+
+	// the covariance of the estimate is P times the residual variance
+	float sd[Parameters] = { PLANT_ESTIMATOR_GAIN_SD * std::fabs(settings.gain), PLANT_ESTIMATOR_DAMPING_SD, PLANT_ESTIMATOR_BIAS_SD };
+	residualVariance = PLANT_ESTIMATOR_RESIDUAL * PLANT_ESTIMATOR_RESIDUAL;
+	initialTrace = 0;
+	for (int i = 0; i < Parameters; ++i)
+	{
+		initialP[i] = sd[i] * sd[i] / residualVariance;
+		initialTrace += initialP[i];
+	}
+	resetCovariance();
+	count = 0;
+}
+
+void PlantEstimator::resetCovariance()
+{
+	for (int i = 0; i < Parameters; ++i)
+	{
+		for (int j = 0; j < Parameters; ++j)
+			P[i][j] = 0;
+		P[i][i] = initialP[i];
+	}
+}
+
+void PlantEstimator::update(float speed, float accel, float lever, float dt)
+{
+	if (dt <= 0 || !std::isfinite(speed) || !std::isfinite(accel) || !std::isfinite(lever))
+		return;
+
+	// engine output over the last dt, exact for a lever held over it
+	if (settings.spoolTau > 0)
+		spool += (lever - spool) * (1.0f - std::exp(-dt / settings.spoolTau));
+	else
+		spool = lever;
+
+	float lambda = settings.memory > 0 ? std::exp(-dt / settings.memory) : 1.0f;
+	const float phi[Parameters] = { spool, -(speed - referenceSpeed), 1.0f };
+
+	// Pphi = P phi, s = lambda + phi' P phi
+	float pphi[Parameters];
+	float s = lambda;
+	float prediction = 0;
+	for (int i = 0; i < Parameters; ++i)
+	{
+		pphi[i] = 0;
+		for (int j = 0; j < Parameters; ++j)
+			pphi[i] += P[i][j] * phi[j];
+		s += phi[i] * pphi[i];
+		prediction += phi[i] * theta[i];
+	}
+	// phi' P phi < 0: rounding has cost P its positive definiteness, the estimate restarts from its current value
+	if (!(s >= lambda))
+	{
+		resetCovariance();
+		return;
+	}
+
+	float error = accel - prediction;
+	for (int i = 0; i < Parameters; ++i)
+		theta[i] += pphi[i] / s * error;
+
+	// P = (P - Pphi Pphi' / s) / lambda, no forgetting once P is at its bound; kept symmetric against rounding
+	float trace = 0;
+	for (int i = 0; i < Parameters; ++i)
+	{
+		for (int j = i; j < Parameters; ++j)
+			P[j][i] = P[i][j] = 0.5f * (P[i][j] + P[j][i]) - pphi[i] * pphi[j] / s;
+		trace += P[i][i];
+	}
+	if (trace < settings.maxVariance * initialTrace)
+	{
+		for (int i = 0; i < Parameters; ++i)
+			for (int j = 0; j < Parameters; ++j)
+				P[i][j] /= lambda;
+	}
+
+	residualVariance = lambda * residualVariance + (1.0f - lambda) * error * error;
+	++count;
+}
+
+float PlantEstimator::deviation(Parameter p) const
+{
+	return std::sqrt(P[p][p] * residualVariance);
+}
+
+float PlantEstimator::residual() const
+{
+	return std::sqrt(residualVariance);
+}
@@ -0,0 +1,70 @@
+#ifndef PLANT_ESTIMATOR_H
+#define PLANT_ESTIMATOR_H
+
+/*
+* Online estimate of the speed plant by recursive least squares with
+* exponential forgetting, the model of SpeedModelPlant and MPC.h:
+*
+*   dv/dt = gain * s - damping * (v - vRef) + bias
+*   ds/dt = (u - s) / spoolTau
+*
+* v in kts, u the lever applied, s the engine output simulated from it, vRef
+* the speed at reset() so bias stays small. Data older than 'memory' seconds
+* fades out at 1/e, independent of the loop rate. While the lever and the
+* speed hold still the data says nothing new and plain forgetting would let
+* the covariance grow without bound (wind-up); it stops growing at
+* 'maxVariance' times its initial size.
+*
+* Each update is O(n^2) in the three parameters and allocates nothing.
+*/
+class PlantEstimator
+{
+public:
+	enum Parameter
+	{
+		Gain,		/* kts/s per lever unit */
+		Damping,	/* 1/s, drag slope */
+		Bias,		/* kts/s at vRef with no engine output */
+		Parameters
+	};
+
+	struct Settings
+	{
+		float memory = 60;			/* s */
+		float spoolTau = 1.5f;		/* s, 0 = lever acts at once */
+		float gain = 4;				/* starting estimate, kts/s per lever unit */
+		float damping = 0.03f;		/* starting estimate, 1/s */
+		float maxVariance = 100;	/* wind-up bound, times the initial covariance */
+	};
+
+	void configure(const Settings& s) { settings = s; }
+	const Settings& configuration() const { return settings; }
+
+	/* engaging at 'speed' with 'lever' applied, trimmed: bias balances the starting gain */
+	void reset(float speed, float lever);
+
+	/* accel [kts/s] measured now, 'lever' applied over the last dt */
+	void update(float speed, float accel, float lever, float dt);
+
+	float estimate(Parameter p) const { return theta[p]; }
+	/* one standard deviation, from the covariance and the residual */
+	float deviation(Parameter p) const;
+	/* rms of the acceleration the model did not predict, kts/s */
+	float residual() const;
+	int updates() const { return count; }
+
+private:
+	Settings settings;
+	float theta[Parameters] = {};
+	float P[Parameters][Parameters] = {};
+	float initialP[Parameters] = {};
+	float initialTrace = 0;
+	float referenceSpeed = 0;
+	float spool = 0;
+	float residualVariance = 0;
+	int count = 0;
+
+	void resetCovariance();
+};
+
+#endif
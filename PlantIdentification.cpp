@@ -0,0 +1,540 @@
+#include "PlantIdentification.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+
+#include "BinaryLog.h"
+#include "WorkStealingPool.h"
+
+/* a run whose lever moves less than this (lever units) is dropped */
+#define IDENT_MIN_LEVER_SPREAD 0.01f
+/* spool lags the second order search starts from, s */
+#define IDENT_SPOOL_STARTS { 0.5, 1.0, 2.0, 4.0 }
+#define IDENT_MAX_ITERATIONS 400
+
+namespace
+{
+	/* the runs on the resampling grid, doubles as the sums run over thousands of samples */
+	struct Problem
+	{
+		const std::vector<IdentRun>& runs;
+		double h;
+		int delay;					/* samples */
+		bool secondOrder;
+	};
+
+	/* a = damping, g = gain, spoolTau = 0 for first order */
+	struct Candidate
+	{
+		double a, g, spoolTau;
+	};
+
+	/*
+	* mean engine output over each step, spool lag on the delayed lever. Before
+	* the run the lever is unknown: 'logged' is the part of the output from the
+	* logged levers, 'before' the part per unit of a constant lever held before
+	* the run (with the spool settled on it).
+	*/
+	void engineOutput(const IdentRun& run, int delay, double h, double spoolTau,
+		std::vector<double>& logged, std::vector<double>& before)
+	{
+		std::size_t n = run.lever.size();
+		logged.resize(n);
+		before.resize(n);
+		double psi = spoolTau > 0 ? std::exp(-h / spoolTau) : 0.0;
+		double s = 0, s0 = 1;
+
+		for (std::size_t k = 0; k < n; ++k)
+		{
+			bool known = k >= static_cast<std::size_t>(delay);
+			double u = known ? run.lever[k - delay] : 0.0;
+			double u0 = known ? 0.0 : 1.0;
+			if (spoolTau > 0)
+			{
+				double next = psi * s + (1.0 - psi) * u;
+				double next0 = psi * s0 + (1.0 - psi) * u0;
+				logged[k] = 0.5 * (s + next);
+				before[k] = 0.5 * (s0 + next0);
+				s = next;
+				s0 = next0;
+			} else
+			{
+				logged[k] = u;
+				before[k] = u0;
+			}
+		}
+	}
+
+	/*
+	* squared output error over all runs. The offset of each run and the lever
+	* before it enter linearly and are solved per run; optionally returns the
+	* sample weighted mean offset and the squared error of each run.
+	*/
+	double outputError(const Problem& p, const Candidate& c, double* meanOffset = nullptr, std::vector<double>* runCost = nullptr)
+	{
+		if (!(c.a > 0) || !std::isfinite(c.g) || c.spoolTau < 0)
+			return std::numeric_limits<double>::max();
+
+		double phi = std::exp(-c.a * p.h);
+		double unit = (1.0 - phi) / c.a;
+		double cost = 0;
+		double offsetSum = 0;
+		std::size_t samples = 0;
+		std::vector<double> logged, before, free, r, q;
+		if (runCost)
+			runCost->assign(p.runs.size(), 0.0);
+
+		for (std::size_t i = 0; i < p.runs.size(); ++i)
+		{
+			auto& run = p.runs[i];
+			std::size_t n = run.speed.size();
+			engineOutput(run, p.delay, p.h, c.spoolTau, logged, before);
+
+			// speed = free + offset * r + earlier lever * q
+			free.resize(n);
+			r.resize(n);
+			q.resize(n);
+			free[0] = run.speed[0];
+			r[0] = q[0] = 0;
+			for (std::size_t k = 0; k + 1 < n; ++k)
+			{
+				free[k + 1] = phi * free[k] + unit * c.g * logged[k];
+				r[k + 1] = phi * r[k] + unit;
+				q[k + 1] = phi * q[k] + unit * c.g * before[k];
+			}
+
+			double rr = 0, rq = 0, qq = 0, er = 0, eq = 0;
+			for (std::size_t k = 0; k < n; ++k)
+			{
+				double e = run.speed[k] - free[k];
+				rr += r[k] * r[k];
+				rq += r[k] * q[k];
+				qq += q[k] * q[k];
+				er += e * r[k];
+				eq += e * q[k];
+			}
+
+			// without delay and spool lag the earlier lever does not matter
+			double offset = 0, lever = 0;
+			double det = rr * qq - rq * rq;
+			if (det > 1e-9 * rr * qq)
+			{
+				offset = (qq * er - rq * eq) / det;
+				lever = (rr * eq - rq * er) / det;
+			} else if (rr > 0)
+				offset = er / rr;
+
+			double runSum = 0;
+			for (std::size_t k = 0; k < n; ++k)
+			{
+				double e = run.speed[k] - free[k] - offset * r[k] - lever * q[k];
+				runSum += e * e;
+			}
+			cost += runSum;
+			if (runCost)
+				(*runCost)[i] = runSum;
+			offsetSum += offset * n;
+			samples += n;
+		}
+
+		if (meanOffset)
+			*meanOffset = samples > 0 ? offsetSum / samples : 0.0;
+		return std::isfinite(cost) ? cost : std::numeric_limits<double>::max();
+	}
+
+	/*
+	* equation error least squares for a given spool lag:
+	*   (v[k+1] - v[k]) / h = -a (v[k] + v[k+1]) / 2 + g w[k] + offset of the run
+	* the offsets drop out by removing the run means. The samples still under
+	* the unknown lever before the run are left out.
+	*/
+	bool equationError(const Problem& p, double spoolTau, Candidate& c)
+	{
+		double sxx = 0, sxw = 0, sww = 0, sxy = 0, swy = 0;
+		std::vector<double> w, before;
+		std::size_t skip = p.delay + static_cast<std::size_t>(3.0 * spoolTau / p.h);
+
+		for (auto& run : p.runs)
+		{
+			std::size_t n = run.speed.size();
+			if (n < skip + 2)
+				continue;
+			engineOutput(run, p.delay, p.h, spoolTau, w, before);
+
+			double mx = 0, mw = 0, my = 0;
+			for (std::size_t k = skip; k + 1 < n; ++k)
+			{
+				mx += -0.5 * (run.speed[k] + run.speed[k + 1]);
+				mw += w[k];
+				my += (run.speed[k + 1] - run.speed[k]) / p.h;
+			}
+			mx /= n - 1 - skip;
+			mw /= n - 1 - skip;
+			my /= n - 1 - skip;
+
+			for (std::size_t k = skip; k + 1 < n; ++k)
+			{
+				double x = -0.5 * (run.speed[k] + run.speed[k + 1]) - mx;
+				double u = w[k] - mw;
+				double y = (run.speed[k + 1] - run.speed[k]) / p.h - my;
+				sxx += x * x;
+				sxw += x * u;
+				sww += u * u;
+				sxy += x * y;
+				swy += u * y;
+			}
+		}
+
+		double det = sxx * sww - sxw * sxw;
+		if (!(std::fabs(det) > 0))
+			return false;
+
+		c.a = (sww * sxy - sxw * swy) / det;
+		c.g = (sxx * swy - sxw * sxy) / det;
+		c.spoolTau = spoolTau;
+		// a slightly unstable equation error fit still is a usable start
+		if (!(c.a > 1e-4))
+			c.a = 1e-4;
+		return std::isfinite(c.g);
+	}
+
+	/* Nelder-Mead over log(a), g and log(spoolTau) */
+	Candidate refine(const Problem& p, const Candidate& start)
+	{
+		const int dims = p.secondOrder ? 3 : 2;
+		typedef double Point[3];
+
+		auto toCandidate = [&](const Point& x) {
+			return Candidate{ std::exp(x[0]), x[1], p.secondOrder ? std::exp(x[2]) : 0.0 };
+		};
+		auto cost = [&](const Point& x) { return outputError(p, toCandidate(x)); };
+
+		Point simplex[4];
+		double f[4];
+		simplex[0][0] = std::log(start.a);
+		simplex[0][1] = start.g;
+		simplex[0][2] = p.secondOrder ? std::log(start.spoolTau) : 0.0;
+		for (int i = 1; i <= dims; ++i)
+		{
+			std::copy(simplex[0], simplex[0] + 3, simplex[i]);
+			simplex[i][i - 1] += 1 == i - 1 ? 0.2 * std::fabs(start.g) + 0.1 : 0.3;
+		}
+		for (int i = 0; i <= dims; ++i)
+			f[i] = cost(simplex[i]);
+
+		for (int it = 0; it < IDENT_MAX_ITERATIONS; ++it)
+		{
+			// order: best first
+			int order[4] = { 0, 1, 2, 3 };
+			std::sort(order, order + dims + 1, [&](int x, int y) { return f[x] < f[y]; });
+			Point sorted[4];
+			double fs[4];
+			for (int i = 0; i <= dims; ++i)
+			{
+				std::copy(simplex[order[i]], simplex[order[i]] + 3, sorted[i]);
+				fs[i] = f[order[i]];
+			}
+			for (int i = 0; i <= dims; ++i)
+			{
+				std::copy(sorted[i], sorted[i] + 3, simplex[i]);
+				f[i] = fs[i];
+			}
+
+			if (f[dims] - f[0] <= 1e-9 * (f[0] + 1e-12))
+				break;
+
+			Point centroid = { 0, 0, 0 };
+			for (int i = 0; i < dims; ++i)
+				for (int j = 0; j < dims; ++j)
+					centroid[j] += simplex[i][j] / dims;
+
+			auto along = [&](double t, Point& x) {
+				for (int j = 0; j < 3; ++j)
+					x[j] = centroid[j] + t * (simplex[dims][j] - centroid[j]);
+			};
+
+			Point reflected, trial;
+			along(-1.0, reflected);
+			double fr = cost(reflected);
+			if (fr < f[0])
+			{
+				along(-2.0, trial);
+				double fe = cost(trial);
+				std::copy(fe < fr ? trial : reflected, (fe < fr ? trial : reflected) + 3, simplex[dims]);
+				f[dims] = fe < fr ? fe : fr;
+			} else if (fr < f[dims - 1])
+			{
+				std::copy(reflected, reflected + 3, simplex[dims]);
+				f[dims] = fr;
+			} else
+			{
+				along(fr < f[dims] ? -0.5 : 0.5, trial);
+				double fc = cost(trial);
+				if (fc < (fr < f[dims] ? fr : f[dims]))
+				{
+					std::copy(trial, trial + 3, simplex[dims]);
+					f[dims] = fc;
+				} else
+				{
+					// shrink towards the best
+					for (int i = 1; i <= dims; ++i)
+					{
+						for (int j = 0; j < 3; ++j)
+							simplex[i][j] = simplex[0][j] + 0.5 * (simplex[i][j] - simplex[0][j]);
+						f[i] = cost(simplex[i]);
+					}
+				}
+			}
+		}
+
+		int best = static_cast<int>(std::min_element(f, f + dims + 1) - f);
+		return toCandidate(simplex[best]);
+	}
+
+	void splitColumns(const std::string& line, std::vector<std::string>& fields)
+	{
+		fields.clear();
+		std::size_t start = 0;
+		for (;;)
+		{
+			auto pos = line.find(';', start);
+			fields.push_back(line.substr(start, std::string::npos == pos ? std::string::npos : pos - start));
+			if (std::string::npos == pos)
+				break;
+			start = pos + 1;
+		}
+	}
+}
+
+PlantIdentification::PlantIdentification(const IdentSettings& settings)
+	: settings(settings)
+{
+}
+
+void PlantIdentification::addRun(const std::string& source, float setpoint, const std::vector<float>& t,
+	const std::vector<float>& speed, const std::vector<float>& lever, std::vector<IdentRun>& runs) const
+{
+	std::size_t first = 0;
+	while (first < t.size())
+	{
+		// a pause or a clock going backwards ends the piece
+		std::size_t last = first;
+		while (last + 1 < t.size() && t[last + 1] > t[last] && t[last + 1] - t[last] <= settings.maxGap)
+			++last;
+
+		if (t[last] - t[first] >= settings.minRun)
+		{
+			IdentRun run{ source, setpoint, {}, {} };
+			std::size_t j = first;
+			for (double time = t[first]; time <= t[last]; time += settings.step)
+			{
+				while (j + 1 <= last && t[j + 1] <= time)
+					++j;
+				float v = speed[j];
+				if (j < last)
+					v += (speed[j + 1] - speed[j]) * static_cast<float>((time - t[j]) / (t[j + 1] - t[j]));
+				run.speed.push_back(v);
+				run.lever.push_back(lever[j]);
+			}
+
+			auto range = std::minmax_element(run.lever.begin(), run.lever.end());
+			if (*range.second - *range.first >= IDENT_MIN_LEVER_SPREAD)
+				runs.push_back(std::move(run));
+		}
+		first = last + 1;
+	}
+}
+
+bool PlantIdentification::load(const std::string& path, std::vector<IdentRun>& runs, std::string& airframe, std::string& error,
+	std::vector<TrimPoint>* trim) const
+{
+	std::vector<float> t, speed, lever, altitude, weight;
+	float setpoint = 0;
+	bool inRun = false;
+
+	auto endRun = [&]() {
+		if (inRun)
+		{
+			addRun(path, setpoint, t, speed, lever, runs);
+			if (trim)
+				TrimTable::steadyPoints(t, speed, lever, altitude, weight, settings.steady, *trim);
+		}
+		t.clear(), speed.clear(), lever.clear(), altitude.clear(), weight.clear();
+	};
+
+	BinaryLogReader binary;
+	if (binary.open(path))
+	{
+		const BinaryLogFileHeader& h = binary.header();
+		airframe.assign(h.airframe, std::find(h.airframe, h.airframe + sizeof(h.airframe), '\0'));
+
+		for (auto& chunk : binary.chunks())
+		{
+			if (BinaryLogChunkHeader::Run == chunk.kind)
+			{
+				endRun();
+				setpoint = chunk.setpoint;
+				inRun = true;
+				continue;
+			}
+
+			for (std::uint32_t r = 0; r < chunk.rows; ++r)
+			{
+				t.push_back(chunk.column(0)[r]);
+				speed.push_back(chunk.column(2)[r]);
+				lever.push_back(chunk.column(3)[r]);
+				// version 1 logs have neither
+				if (h.columns >= BINARY_LOG_COLUMNS)
+				{
+					altitude.push_back(chunk.column(7)[r]);
+					weight.push_back(chunk.column(8)[r]);
+				}
+			}
+		}
+		endRun();
+		return true;
+	}
+
+	std::ifstream fs{ path };
+	if (!fs.is_open())
+	{
+		error = "cannot open";
+		return false;
+	}
+
+	// columns of the current run by name
+	std::map<std::string, std::size_t> columns;
+	std::vector<std::string> fields;
+	std::string line;
+	bool usable = false;
+
+	while (std::getline(fs, line))
+	{
+		if (!line.empty() && '\r' == line.back())
+			line.pop_back();
+
+		if (0 == line.compare(0, 9, "Airframe:"))
+		{
+			auto start = line.find_first_not_of(' ', 9);
+			airframe = std::string::npos == start ? "" : line.substr(start);
+		} else if (0 == line.compare(0, 9, "setpoint:"))
+		{
+			endRun();
+			setpoint = static_cast<float>(atof(line.c_str() + 9));
+			columns.clear();
+			inRun = true;
+		} else if (inRun && columns.empty())
+		{
+			splitColumns(line, fields);
+			for (std::size_t i = 0; i < fields.size(); ++i)
+				columns[fields[i]] = i;
+			if (!columns.count("t") || !columns.count("out") || (!columns.count("speed") && !columns.count("error")))
+			{
+				error = "needs t, out and speed or error columns";
+				return false;
+			}
+			usable = true;
+		} else if (inRun)
+		{
+			splitColumns(line, fields);
+			if (fields.size() < columns.size())
+				continue;
+
+			auto value = [&](const char* name) { return static_cast<float>(atof(fields[columns[name]].c_str())); };
+			float sp = columns.count("setpoint") ? value("setpoint") : setpoint;
+			float v = columns.count("speed") ? value("speed") : sp - value("error");
+			float time = value("t");
+			float u = value("out");
+			if (!std::isfinite(time) || !std::isfinite(v) || !std::isfinite(u))
+				continue;
+
+			t.push_back(time);
+			speed.push_back(v);
+			lever.push_back(u);
+			if (columns.count("alt") && columns.count("weight"))
+			{
+				altitude.push_back(value("alt"));
+				weight.push_back(value("weight"));
+			}
+		}
+	}
+	endRun();
+
+	if (!usable)
+	{
+		error = "no setpoint: block";
+		return false;
+	}
+	return true;
+}
+
+IdentResult PlantIdentification::fitFirstOrder(const std::vector<IdentRun>& runs, WorkStealingPool& pool) const
+{
+	return fit(runs, false, pool);
+}
+
+IdentResult PlantIdentification::fitSecondOrder(const std::vector<IdentRun>& runs, WorkStealingPool& pool) const
+{
+	return fit(runs, true, pool);
+}
+
+IdentResult PlantIdentification::fit(const std::vector<IdentRun>& runs, bool secondOrder, WorkStealingPool& pool) const
+{
+	IdentResult result{ { 0, 0, 0, 0, 0 }, 0, {}, 0, false, false };
+	for (auto& run : runs)
+		result.samples += run.speed.size();
+	if (runs.empty() || settings.step <= 0)
+		return result;
+
+	int delays = 1 + static_cast<int>(settings.maxDeadTime / settings.step + 0.5f);
+	std::vector<Candidate> best(delays);
+	std::vector<double> cost(delays, std::numeric_limits<double>::max());
+
+	pool.parallelFor(0, delays, 1, [&](std::size_t delay) {
+		Problem p{ runs, settings.step, static_cast<int>(delay), secondOrder };
+
+		std::vector<double> starts = secondOrder ? std::vector<double> IDENT_SPOOL_STARTS : std::vector<double>{ 0.0 };
+		Candidate start{ 0, 0, 0 };
+		double startCost = std::numeric_limits<double>::max();
+		for (double spoolTau : starts)
+		{
+			Candidate c;
+			if (!equationError(p, spoolTau, c))
+				continue;
+			double e = outputError(p, c);
+			if (e < startCost)
+			{
+				start = c;
+				startCost = e;
+			}
+		}
+		if (startCost == std::numeric_limits<double>::max())
+			return;
+
+		best[delay] = refine(p, start);
+		cost[delay] = outputError(p, best[delay]);
+	});
+
+	std::size_t d = std::min_element(cost.begin(), cost.end()) - cost.begin();
+	if (cost[d] == std::numeric_limits<double>::max())
+		return result;
+
+	std::vector<double> runCost;
+	double offset = 0;
+	outputError(Problem{ runs, settings.step, static_cast<int>(d), secondOrder }, best[d], &offset, &runCost);
+	for (std::size_t i = 0; i < runs.size(); ++i)
+		result.runRms.push_back(static_cast<float>(std::sqrt(runCost[i] / runs[i].speed.size())));
+
+	auto& c = best[d];
+	result.model = SpeedModelPlant::Params{ static_cast<float>(c.g), static_cast<float>(c.a),
+		static_cast<float>(c.spoolTau), static_cast<float>(d * settings.step), static_cast<float>(offset) };
+	result.rms = static_cast<float>(std::sqrt(cost[d] / result.samples));
+	// more lever slowing the aircraft down means the logs do not show the plant
+	result.valid = c.g > 0;
+	result.deadTimeAtLimit = delays > 1 && static_cast<int>(d) == delays - 1;
+	return result;
+}
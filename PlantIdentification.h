@@ -0,0 +1,86 @@
+#ifndef PLANT_IDENTIFICATION_H
+#define PLANT_IDENTIFICATION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "PlantModel.h"
+#include "TrimTable.h"
+
+class WorkStealingPool;
+
+/* one "setpoint:" block of a flight log, resampled to the identification step */
+struct IdentRun
+{
+	std::string source;				/* log file, for messages */
+	float setpoint;					/* kts */
+	std::vector<float> speed;		/* kts */
+	std::vector<float> lever;		/* the out column, held from its sample time */
+};
+
+struct IdentSettings
+{
+	float step = 0.1f;				/* s, resampling */
+	float maxDeadTime = 4.0f;		/* s, searched in steps of 'step' */
+	float maxGap = 1.0f;			/* s, a longer pause in a log splits the run */
+	float minRun = 10.0f;			/* s, shorter runs are dropped */
+	TrimTable::Steady steady;		/* steady segments for the trim table */
+};
+
+struct IdentResult
+{
+	SpeedModelPlant::Params model;
+	float rms;						/* kts, simulated against logged speed over all runs */
+	std::vector<float> runRms;		/* kts, per run */
+	std::size_t samples;
+	bool valid;						/* false if nothing fitted or the gain is not positive */
+	bool deadTimeAtLimit;			/* the best dead time is maxDeadTime, a longer one may fit better */
+};
+
+/*
+* Fits the speed models of SpeedModelPlant to logged controller runs.
+*
+* Each run keeps its own offset, as trim, weight and altitude differ between
+* sessions; the model file gets their mean. For every dead time on the
+* grid the model is first solved as an equation error least squares
+* problem on the trapezoidal discretisation, then refined on the output
+* error: the model is simulated from the first logged speed of each run
+* and the squared difference to the log is minimised by Nelder-Mead over
+* damping, gain and spool lag, the offsets being linear and solved in
+* closed form. The dead time with the smallest output error wins. Dead
+* times are fitted in parallel. A run that no model explains (flown in a
+* climb, through turbulence) pulls the fit like any other; runRms shows it.
+*
+* Runs without lever movement carry no information about the gain and are
+* dropped while loading; at least one run needs a step or an oscillation.
+*/
+class PlantIdentification
+{
+	IdentSettings settings;
+
+public:
+	explicit PlantIdentification(const IdentSettings& settings = IdentSettings{});
+
+	/*
+	* appends the runs of a CSV (<plane>_logN.csv and the Auswertung layout,
+	* speed from setpoint - error if it has no speed column) or binary log;
+	* false with the reason if the file is unusable, airframe is left empty
+	* if the log does not name one. With trim, the steady segments of the
+	* runs (those without lever movement included) are appended to it too,
+	* with altitude and weight where the log has them.
+	*/
+	bool load(const std::string& path, std::vector<IdentRun>& runs, std::string& airframe, std::string& error,
+		std::vector<TrimPoint>* trim = nullptr) const;
+
+	/* spoolTau = 0 */
+	IdentResult fitFirstOrder(const std::vector<IdentRun>& runs, WorkStealingPool& pool) const;
+	IdentResult fitSecondOrder(const std::vector<IdentRun>& runs, WorkStealingPool& pool) const;
+
+private:
+	IdentResult fit(const std::vector<IdentRun>& runs, bool secondOrder, WorkStealingPool& pool) const;
+	void addRun(const std::string& source, float setpoint, const std::vector<float>& t,
+		const std::vector<float>& speed, const std::vector<float>& lever, std::vector<IdentRun>& runs) const;
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include "PlantModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+namespace
+{
+	float clamp01(float x)
+	{
+		return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+	}
+
+	/* ft-lb from shp and RPM */
+	const float TorqueConstant = 5252.0f;
+	const float WattPerShp = 745.7f;
+	const float MsPerKt = 0.514444f;
+}
+
+FirstOrderPlant::FirstOrderPlant(float gain, float tau, float initial)
+	: gain(gain), tau(tau), initial(initial), y(initial)
+{
+}
+
+float FirstOrderPlant::step(float input, float dt)
+{
+	y = (y + dt * gain / tau * input) / (1.0f + dt / tau);
+	return y;
+}
+
+FOPDTPlant::FOPDTPlant(float gain, float tau, float deadTime, float sampleTime, float initialInput)
+	: lag(gain, tau, gain * initialInput), sampleTime(sampleTime), initialInput(initialInput)
+{
+	std::size_t samples = static_cast<std::size_t>(std::lround(deadTime / sampleTime));
+	delayLine.assign(samples, initialInput);
+}
+
+float FOPDTPlant::step(float input, float dt)
+{
+	if (delayLine.empty())
+		return lag.step(input, dt);
+
+	/* integrate over dt in sample sized pieces so the delay is exact for any dt */
+	while (dt > 0.0f)
+	{
+		float h = sampleTime - sinceSample;
+		bool sample = h <= dt;
+
+		if (!sample)
+			h = dt;
+		else if (h < 0.0f)
+			h = 0.0f;
+
+		lag.step(delayLine[head], h);
+		dt -= h;
+
+		if (sample)
+		{
+			sinceSample = 0;
+			delayLine[head] = input;
+			head = (head + 1) % delayLine.size();
+		} else
+			sinceSample += h;
+	}
+	return lag.output();
+}
+
+void FOPDTPlant::reset()
+{
+	lag.reset();
+	std::fill(delayLine.begin(), delayLine.end(), initialInput);
+	head = 0;
+	sinceSample = 0;
+}
+
+TurbineSpoolPlant::Params TurbineSpoolPlant::PT6A21()
+{
+	return { 52.0f, 101.5f, 1.2f, 0.8f, 15.0f, 1.5f };
+}
+
+TurbineSpoolPlant::Params TurbineSpoolPlant::FJ44()
+{
+	return { 48.0f, 100.0f, 1.5f, 1.0f, 12.0f, 2.0f };
+}
+
+TurbineSpoolPlant::Params TurbineSpoolPlant::AE3007()
+{
+	return { 30.0f, 100.0f, 2.0f, 1.2f, 10.0f, 2.0f };
+}
+
+TurbineSpoolPlant::TurbineSpoolPlant(const Params& p, float initialThrottle)
+	: params(p), initialThrottle(initialThrottle)
+{
+	reset();
+}
+
+void TurbineSpoolPlant::reset()
+{
+	n1 = params.idleN1 + (params.maxN1 - params.idleN1) * clamp01(initialThrottle);
+}
+
+float TurbineSpoolPlant::step(float input, float dt)
+{
+	float target = params.idleN1 + (params.maxN1 - params.idleN1) * clamp01(input);
+	float tau = target > n1 ? params.accelTau : params.decelTau;
+	float rate = (target - n1) / (tau + dt);
+
+	if (rate > params.maxAccelRate)
+		rate = params.maxAccelRate;
+
+	n1 += rate * dt;
+	return n1;
+}
+
+float TurbineSpoolPlant::thrustFraction() const
+{
+	float frac = clamp01((n1 - params.idleN1) / (params.maxN1 - params.idleN1));
+	return std::pow(frac, params.thrustExponent);
+}
+
+TurbopropPlant::Params TurbopropPlant::C90B()
+{
+	/* governed from ~40 % power up, windmilling at low power is ignored */
+	return { TurbineSpoolPlant::PT6A21(), 550.0f, 1.3f, 2200.0f, 3000.0f, 0.6f, 0.8f };
+}
+
+TurbopropPlant::TurbopropPlant(const Params& p, float initialThrottle)
+	: params(p), gasGenerator(p.gasGenerator, initialThrottle), initialThrottle(initialThrottle)
+{
+	reset();
+}
+
+void TurbopropPlant::reset()
+{
+	gasGenerator.reset();
+	updatePower();
+	rpm = targetRpm();
+	torque = power * TorqueConstant / rpm;
+}
+
+void TurbopropPlant::updatePower()
+{
+	const auto& gg = params.gasGenerator;
+	float frac = clamp01((gasGenerator.output() - gg.idleN1) / (gg.maxN1 - gg.idleN1));
+
+	/* a little power is left at flight idle */
+	power = params.maxShaftPower * (0.05f + 0.95f * std::pow(frac, params.powerExponent));
+}
+
+float TurbopropPlant::targetRpm() const
+{
+	/* fine pitch stop: absorbed power grows with RPM^3 */
+	float fineRpm = params.finePitchRpm * std::cbrt(power / params.maxShaftPower);
+	return fineRpm < params.governorRpm ? fineRpm : params.governorRpm;
+}
+
+float TurbopropPlant::step(float input, float dt)
+{
+	gasGenerator.step(input, dt);
+	updatePower();
+
+	rpm += (targetRpm() - rpm) * dt / (params.rpmTau + dt);
+
+	torque = rpm > 1.0f ? power * TorqueConstant / rpm : 0.0f;
+	return torque;
+}
+
+float TurbopropPlant::thrust(float tas) const
+{
+	/* below ~40 kts the momentum theory limit of the prop takes over */
+	const float minTas = 20.0f;
+	return params.propEfficiency * power * WattPerShp / (tas > minTas ? tas : minTas);
+}
+
+AirspeedPlant AirspeedPlant::C90B(float initialIas, float initialThrottle)
+{
+	/* trims at ~0.6 throttle for 180 kts */
+	Params p{ 4500.0f, 0.45f, 0.0f, 2 };
+	return AirspeedPlant{ p, TurbopropPlant{ TurbopropPlant::C90B(), initialThrottle }, initialIas };
+}
+
+AirspeedPlant AirspeedPlant::CitationX(float initialIas, float initialThrottle)
+{
+	/* trims at ~0.6 throttle for 250 kts */
+	Params p{ 16000.0f, 1.3f, 57000.0f, 2 };
+	return AirspeedPlant{ p, TurbineSpoolPlant{ TurbineSpoolPlant::AE3007(), initialThrottle }, initialIas };
+}
+
+AirspeedPlant::AirspeedPlant(const Params& p, const TurbineSpoolPlant& fan, float initialIas)
+	: params(p), engine(Engine::Turbofan), fan(fan), prop(TurbopropPlant::C90B()),
+	initialTas(initialIas * MsPerKt), tas(initialTas)
+{
+}
+
+AirspeedPlant::AirspeedPlant(const Params& p, const TurbopropPlant& prop, float initialIas)
+	: params(p), engine(Engine::Turboprop), fan(TurbineSpoolPlant::PT6A21()), prop(prop),
+	initialTas(initialIas * MsPerKt), tas(initialTas)
+{
+}
+
+float AirspeedPlant::thrust() const
+{
+	if (Engine::Turbofan == engine)
+		return params.maxThrust * fan.thrustFraction();
+
+	return params.engines * prop.thrust(tas);
+}
+
+float AirspeedPlant::step(float input, float dt)
+{
+	if (Engine::Turbofan == engine)
+		fan.step(input, dt);
+	else
+		prop.step(input, dt);
+
+	accel = (thrust() - params.dragFactor * tas * tas) / params.mass;
+	tas += accel * dt;
+	if (tas < 0.0f)
+		tas = 0.0f;
+
+	return output();
+}
+
+float AirspeedPlant::output() const
+{
+	return tas / MsPerKt;
+}
+
+void AirspeedPlant::reset()
+{
+	fan.reset();
+	prop.reset();
+	tas = initialTas;
+	accel = 0;
+}
+
+bool SpeedModelPlant::load(const std::string& path, Params& firstOrder, Params& secondOrder)
+{
+	std::ifstream fs{ path };
+	if (!fs.is_open())
+		return false;
+
+	/* same key=value format and comment rules as the aircraft ini */
+	std::map<std::string, float> cfg;
+	std::string str;
+	while (fs >> str)
+	{
+		if (str.substr(0, 2) == "//" || str.substr(0, 1) == "#")
+			continue;
+
+		auto pos = str.find('=');
+		if (std::string::npos == pos)
+			continue;
+		cfg.emplace(str.substr(0, pos), static_cast<float>(atof(str.substr(pos + 1).c_str())));
+	}
+
+	for (const char* key : { "fopdt_gain", "fopdt_tau", "mpc_gain", "mpc_damping", "mpc_spool_tau" })
+	{
+		if (!cfg.count(key))
+			return false;
+	}
+	if (cfg["fopdt_tau"] <= 0.0f || cfg["mpc_damping"] <= 0.0f)
+		return false;
+
+	/* K, T and the steady speed at lever 0 back to rates; the second order may be an integrator, its offset is a rate */
+	float T = cfg["fopdt_tau"];
+	firstOrder = { cfg["fopdt_gain"] / T, 1.0f / T, 0.0f, cfg["fopdt_dead_time"], cfg["fopdt_bias"] / T };
+	secondOrder = { cfg["mpc_gain"], cfg["mpc_damping"], cfg["mpc_spool_tau"], cfg["model_dead_time"], cfg["model_offset"] };
+	return true;
+}
+
+void SpeedModelPlant::save(std::ostream& out, const Params& firstOrder, const Params& secondOrder)
+{
+	out << "# first order plus dead time: steady kts per lever unit, lag in s, delay in s\n";
+	out << "# and the steady speed at lever 0 in kts\n";
+	out << "fopdt_gain=" << firstOrder.gain / firstOrder.damping << "\n";
+	out << "fopdt_tau=" << 1.0f / firstOrder.damping << "\n";
+	out << "fopdt_dead_time=" << firstOrder.deadTime << "\n";
+	out << "fopdt_bias=" << firstOrder.offset / firstOrder.damping << "\n";
+	out << "# second order, the MPC model: kts/s per unit of engine output, drag slope in 1/s,\n";
+	out << "# spool lag in s; plus delay in s and the speed rate at lever 0 and no speed in kts/s\n";
+	out << "mpc_gain=" << secondOrder.gain << "\n";
+	out << "mpc_damping=" << secondOrder.damping << "\n";
+	out << "mpc_spool_tau=" << secondOrder.spoolTau << "\n";
+	out << "model_dead_time=" << secondOrder.deadTime << "\n";
+	out << "model_offset=" << secondOrder.offset << "\n";
+}
+
+SpeedModelPlant::SpeedModelPlant(const Params& p, float initialSpeed, float sampleTime)
+	: params(p), sampleTime(sampleTime), initialSpeed(initialSpeed)
+{
+	std::size_t samples = static_cast<std::size_t>(std::lround(p.deadTime / sampleTime));
+	delayLine.resize(samples);
+	reset();
+}
+
+float SpeedModelPlant::trimLever(float speed) const
+{
+	return (params.damping * speed - params.offset) / params.gain;
+}
+
+void SpeedModelPlant::advance(float lever, float dt)
+{
+	/* implicit Euler like the other plants, any dt is stable */
+	if (params.spoolTau > 0.0f)
+		spool = (spool + dt / params.spoolTau * lever) / (1.0f + dt / params.spoolTau);
+	else
+		spool = lever;
+	v = (v + dt * (params.gain * spool + params.offset)) / (1.0f + dt * params.damping);
+}
+
+float SpeedModelPlant::step(float input, float dt)
+{
+	if (delayLine.empty())
+	{
+		advance(input, dt);
+		return v;
+	}
+
+	/* the delay line of FOPDTPlant */
+	while (dt > 0.0f)
+	{
+		float h = sampleTime - sinceSample;
+		bool sample = h <= dt;
+
+		if (!sample)
+			h = dt;
+		else if (h < 0.0f)
+			h = 0.0f;
+
+		advance(delayLine[head], h);
+		dt -= h;
+
+		if (sample)
+		{
+			sinceSample = 0;
+			delayLine[head] = input;
+			head = (head + 1) % delayLine.size();
+		} else
+			sinceSample += h;
+	}
+	return v;
+}
+
+void SpeedModelPlant::reset()
+{
+	v = initialSpeed;
+	spool = trimLever(initialSpeed);
+	std::fill(delayLine.begin(), delayLine.end(), spool);
+	head = 0;
+	sinceSample = 0;
+}
@@ -0,0 +1,263 @@
+#ifndef PLANT_MODEL_H
+#define PLANT_MODEL_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+* Instance based plant models for closed-loop simulation.
+*
+* Every model keeps all of its state in the instance, so any number of them
+* can run side by side (one per thread, one per sweep candidate, ...). All
+* models share step(input, dt) and can be copied by value or through clone().
+*/
+class PlantModel
+{
+public:
+	virtual ~PlantModel() = default;
+
+	/* Advance by dt seconds with the given input, returns the new output */
+	virtual float step(float input, float dt) = 0;
+	virtual float output() const = 0;
+	virtual void reset() = 0;
+	virtual std::unique_ptr<PlantModel> clone() const = 0;
+};
+
+/* Implements clone() through the copy constructor of Derived */
+template <class Derived>
+class ClonablePlant : public PlantModel
+{
+public:
+	std::unique_ptr<PlantModel> clone() const override
+	{
+		return std::make_unique<Derived>(static_cast<const Derived&>(*this));
+	}
+};
+
+/*
+* y' = (gain * u - y) / tau, implicit Euler so any dt is stable
+*/
+class FirstOrderPlant : public ClonablePlant<FirstOrderPlant>
+{
+	float gain;
+	float tau;
+	float initial;
+	float y;
+
+public:
+	explicit FirstOrderPlant(float gain, float tau, float initial = 0.0f);
+
+	float step(float input, float dt) override;
+	float output() const override { return y; }
+	void reset() override { y = initial; }
+};
+
+/*
+* First order plus dead time. The input is sampled into a delay line every
+* sampleTime seconds (zero-order hold), independent of the step size.
+*/
+class FOPDTPlant : public ClonablePlant<FOPDTPlant>
+{
+	FirstOrderPlant lag;
+	std::vector<float> delayLine;
+	std::size_t head = 0;
+	float sampleTime;
+	float sinceSample = 0;
+	float initialInput;
+
+public:
+	explicit FOPDTPlant(float gain, float tau, float deadTime, float sampleTime = 0.01f, float initialInput = 0.0f);
+
+	float step(float input, float dt) override;
+	float output() const override { return lag.output(); }
+	void reset() override;
+	float deadTime() const { return delayLine.size() * sampleTime; }
+};
+
+/*
+* Turbine spool: N1 (or Ng) in percent follows the throttle between idle and
+* max with separate acceleration/deceleration time constants and a limited
+* acceleration rate, which is what makes spool-up feel like dead time.
+*/
+class TurbineSpoolPlant : public ClonablePlant<TurbineSpoolPlant>
+{
+public:
+	struct Params
+	{
+		float idleN1;			/* % at throttle 0 */
+		float maxN1;			/* % at throttle 1 */
+		float accelTau;			/* s */
+		float decelTau;			/* s */
+		float maxAccelRate;		/* %/s */
+		float thrustExponent;	/* thrust fraction = ((N1 - idle) / (max - idle))^exponent */
+	};
+
+	static Params PT6A21();		/* Ng of the C90B engines */
+	static Params FJ44();		/* small turbofan */
+	static Params AE3007();		/* N1 of the Citation X engines */
+
+	explicit TurbineSpoolPlant(const Params& p, float initialThrottle = 0.0f);
+
+	/* input: throttle 0..1, output: N1 in % */
+	float step(float input, float dt) override;
+	float output() const override { return n1; }
+	void reset() override;
+
+	float thrustFraction() const;
+
+private:
+	Params params;
+	float initialThrottle;
+	float n1;
+};
+
+/*
+* C90B turboprop: PT6A-21 gas generator driving a governed propeller.
+* Shaft power follows Ng; the governor holds prop RPM as long as the power
+* allows, below that the prop is on the fine pitch stop and RPM drops.
+*/
+class TurbopropPlant : public ClonablePlant<TurbopropPlant>
+{
+public:
+	struct Params
+	{
+		TurbineSpoolPlant::Params gasGenerator;
+		float maxShaftPower;	/* shp */
+		float powerExponent;	/* power fraction = spool fraction^exponent */
+		float governorRpm;		/* prop RPM set by the condition lever */
+		float finePitchRpm;		/* RPM max power would drive the prop to on the fine pitch stop */
+		float rpmTau;			/* s, governor/prop inertia */
+		float propEfficiency;
+	};
+
+	static Params C90B();
+
+	explicit TurbopropPlant(const Params& p, float initialThrottle = 0.0f);
+
+	/* input: power lever 0..1, output: torque in ft-lb */
+	float step(float input, float dt) override;
+	float output() const override { return torque; }
+	void reset() override;
+
+	float ng() const { return gasGenerator.output(); }
+	float propRpm() const { return rpm; }
+	float shaftPower() const { return power; }
+	/* propeller thrust in N at the given true airspeed in m/s */
+	float thrust(float tas) const;
+
+private:
+	void updatePower();
+	float targetRpm() const;
+
+	Params params;
+	TurbineSpoolPlant gasGenerator;
+	float initialThrottle;
+	float power = 0;
+	float rpm = 0;
+	float torque = 0;
+};
+
+/*
+* Level flight speed: thrust of a turbofan or turboprop against quadratic
+* drag on a point mass. Input is the throttle, output the airspeed in kts
+* (sea level, so IAS = TAS). No heap, copies are cheap.
+*/
+class AirspeedPlant : public ClonablePlant<AirspeedPlant>
+{
+public:
+	enum class Engine
+	{
+		Turbofan,
+		Turboprop
+	};
+
+	struct Params
+	{
+		float mass;				/* kg */
+		float dragFactor;		/* N / (m/s)^2 */
+		float maxThrust;		/* N, turbofan only, all engines */
+		int engines;
+	};
+
+	static AirspeedPlant C90B(float initialIas = 150.0f, float initialThrottle = 0.5f);
+	static AirspeedPlant CitationX(float initialIas = 220.0f, float initialThrottle = 0.5f);
+
+	AirspeedPlant(const Params& p, const TurbineSpoolPlant& fan, float initialIas);
+	AirspeedPlant(const Params& p, const TurbopropPlant& prop, float initialIas);
+
+	/* input: throttle 0..1, output: airspeed in kts */
+	float step(float input, float dt) override;
+	float output() const override;
+	void reset() override;
+
+	float thrust() const;
+	float n1() const { return Engine::Turbofan == engine ? fan.output() : prop.ng(); }
+	const TurbopropPlant& turboprop() const { return prop; }
+
+	/* longitudinal acceleration of the last step, m/s^2 */
+	float acceleration() const { return accel; }
+
+private:
+	Params params;
+	Engine engine;
+	TurbineSpoolPlant fan;
+	TurbopropPlant prop;
+	float initialTas;
+	float tas;
+	float accel = 0;
+};
+
+/*
+* Speed under the lever as identified from flight logs (PlantIdentification.h):
+*
+*   dv/dt = -damping * v + gain * s + offset
+*   ds/dt = (u(t - deadTime) - s) / spoolTau
+*
+* v in kts, u and s in lever units. spoolTau = 0 is first order plus dead
+* time, K = gain / damping kts per lever unit and T = 1 / damping. The second
+* order model is the one of MPC.h: a model file stores it under the aircraft
+* ini's mpc_ keys, so the file can be appended to the ini as it is.
+*/
+class SpeedModelPlant : public ClonablePlant<SpeedModelPlant>
+{
+public:
+	struct Params
+	{
+		float gain;			/* kts/s per lever unit */
+		float damping;		/* 1/s, drag slope */
+		float spoolTau;		/* s, 0 = first order */
+		float deadTime;		/* s */
+		float offset;		/* kts/s, speed rate at lever 0 and v = 0 */
+	};
+
+	/* both models of a file written by save(), false if the file or a model is missing */
+	static bool load(const std::string& path, Params& firstOrder, Params& secondOrder);
+	static void save(std::ostream& out, const Params& firstOrder, const Params& secondOrder);
+
+	/* starts trimmed at initialSpeed, the delay line sampled every sampleTime seconds */
+	SpeedModelPlant(const Params& p, float initialSpeed, float sampleTime = 0.01f);
+
+	/* input: lever, output: airspeed in kts */
+	float step(float input, float dt) override;
+	float output() const override { return v; }
+	void reset() override;
+
+	/* lever holding speed v, unclamped */
+	float trimLever(float speed) const;
+
+private:
+	void advance(float lever, float dt);
+
+	Params params;
+	std::vector<float> delayLine;
+	std::size_t head = 0;
+	float sampleTime;
+	float sinceSample = 0;
+	float initialSpeed;
+	float v;
+	float spool;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "RelayTuner.h"
+
+#include <cmath>
+
+/* relative spread between consecutive cycles that still counts as agreeing */
+#define RELAY_TUNER_AGREEMENT 0.1f
+
+namespace
+{
+	struct RuleFactors
+	{
+		const char* name;
+		float kp;	/* of Ku */
+		float ti;	/* of Tu */
+		float td;	/* of Tu */
+	};
+
+	const RuleFactors rules[RelayTuner::Rules] = {
+		{ "ziegler-nichols", 0.6f, 0.5f, 0.125f },
+		{ "tyreus-luyben", 0.45f, 2.2f, 1.0f / 6.3f },
+		{ "no overshoot", 0.2f, 0.5f, 1.0f / 3.0f },
+		{ "some overshoot", 0.33f, 0.5f, 1.0f / 3.0f },
+	};
+
+	bool agree(float a, float b)
+	{
+		return std::fabs(a - b) <= RELAY_TUNER_AGREEMENT * std::fabs(b);
+	}
+}
+
+bool RelayTuner::start(float sp, float b, float lower, float upper, const Settings& s)
+{
+	settings = s;
+	setpoint = sp;
+	limMin = lower;
+	limMax = upper;
+
+	// the relay has to fit into the limits on both sides of the bias
+	bias = b < lower ? lower : (b > upper ? upper : b);
+	amplitude = s.amplitude;
+	if (bias - amplitude < lower)
+		amplitude = bias - lower;
+	if (bias + amplitude > upper)
+		amplitude = upper - bias;
+	if (amplitude <= 0 || s.hysteresis < 0 || s.cycles < 1)
+	{
+		state = Failed;
+		failure = "no room for the relay between the throttle limits";
+		return false;
+	}
+
+	state = Running;
+	failure = "";
+	high = true;
+	elapsed = 0;
+	cycle = 0;
+	cycleStart = 0;
+	highTime = 0;
+	maxSpeed = -1e9f;
+	minSpeed = 1e9f;
+	agreeing = 0;
+	lastPeriod = 0;
+	lastAmplitude = 0;
+	periodSum = 0;
+	amplitudeSum = 0;
+	Ku = 0;
+	Tu = 0;
+	return true;
+}
+
+float RelayTuner::update(float speed, float dt)
+{
+	if (Running != state)
+		return bias;
+
+	elapsed += dt;
+	if (elapsed > settings.timeout)
+	{
+		state = Failed;
+		failure = "no steady oscillation before the timeout";
+		return bias;
+	}
+
+	maxSpeed = speed > maxSpeed ? speed : maxSpeed;
+	minSpeed = speed < minSpeed ? speed : minSpeed;
+	if (high)
+		highTime += dt;
+
+	// switch when the speed leaves the band on the far side
+	float error = setpoint - speed;
+	if (high && error < -settings.hysteresis)
+		high = false;
+	else if (!high && error > settings.hysteresis)
+	{
+		high = true;
+		endCycle();
+		maxSpeed = minSpeed = speed;
+	}
+
+	return high ? bias + amplitude : bias - amplitude;
+}
+
+void RelayTuner::endCycle()
+{
+	float period = elapsed - cycleStart;
+	float speedAmplitude = 0.5f * (maxSpeed - minSpeed);
+
+	// a cycle is from one switch up to the next; the one cut off by the start does not count
+	if (cycle > 0 && period > 0)
+	{
+		if (cycle > SettleCycles)
+		{
+			if (agreeing > 0 && agree(period, lastPeriod) && agree(speedAmplitude, lastAmplitude))
+			{
+				++agreeing;
+				periodSum += period;
+				amplitudeSum += speedAmplitude;
+			} else
+			{
+				agreeing = 1;
+				periodSum = period;
+				amplitudeSum = speedAmplitude;
+			}
+			lastPeriod = period;
+			lastAmplitude = speedAmplitude;
+
+			if (agreeing >= settings.cycles)
+			{
+				Tu = periodSum / agreeing;
+				float a = amplitudeSum / agreeing;
+				float e = settings.hysteresis;
+				if (a <= e)
+				{
+					state = Failed;
+					failure = "speed swing inside the hysteresis, raise the amplitude";
+					return;
+				}
+				Ku = 4.0f * amplitude / (3.14159265f * std::sqrt(a * a - e * e));
+				state = Done;
+				return;
+			}
+		}
+
+		// more time up than down: the bias is short of trim
+		bias += 0.5f * amplitude * (2.0f * highTime - period) / period;
+		if (bias - amplitude < limMin)
+			bias = limMin + amplitude;
+		if (bias + amplitude > limMax)
+			bias = limMax - amplitude;
+	}
+
+	++cycle;
+	cycleStart = elapsed;
+	highTime = 0;
+}
+
+void RelayTuner::gains(Rule rule, float Ku, float Tu, PIDController& gains)
+{
+	auto& r = rules[rule];
+	gains.Kp = r.kp * Ku;
+	gains.Ki = gains.Kp / (r.ti * Tu);
+	gains.Kd = gains.Kp * r.td * Tu;
+}
+
+const char* RelayTuner::name(Rule rule)
+{
+	return rules[rule].name;
+}
@@ -0,0 +1,114 @@
+#ifndef RELAY_TUNER_H
+#define RELAY_TUNER_H
+
+#include "PID.h"
+
+/*
+* Relay auto-tuner after Astrom and Hagglund. The throttle is switched
+* between bias + amplitude and bias - amplitude whenever the speed leaves
+* the hysteresis band around the setpoint the other way, which drives the
+* loop into a limit cycle at its ultimate period. From the cycle
+*
+*   Ku = 4 d / (pi sqrt(a^2 - e^2))     Tu = period
+*
+* with d the relay amplitude, a the speed amplitude and e the hysteresis.
+* The bias is corrected every cycle so the relay spends equal time up and
+* down, otherwise an untrimmed throttle skews the cycle. The first cycles
+* are left to settle. The result is taken once 'cycles' consecutive periods
+* and amplitudes agree within 10 %.
+*
+* gains() turns Ku, Tu into a PID by one of the classic rules:
+*
+*   rule                Kp        Ti        Td
+*   Ziegler-Nichols     0.6  Ku   0.5 Tu    0.125 Tu
+*   Tyreus-Luyben       0.45 Ku   2.2 Tu    Tu / 6.3
+*   no overshoot        0.2  Ku   0.5 Tu    Tu / 3
+*   some overshoot      0.33 Ku   0.5 Tu    Tu / 3
+*
+* with Ki = Kp / Ti and Kd = Kp * Td. The presets in C90B.ini follow the
+* Kp and Ki of these rules.
+*/
+class RelayTuner
+{
+public:
+	enum Rule
+	{
+		ZieglerNichols,
+		TyreusLuyben,
+		NoOvershoot,
+		SomeOvershoot,
+		Rules
+	};
+
+	enum State
+	{
+		Idle,
+		Running,
+		Done,
+		Failed
+	};
+
+	struct Settings
+	{
+		float amplitude = 0.1f;		/* lever units, cut to the room between bias and the limits */
+		float hysteresis = 0.2f;	/* kts, just above the speed noise */
+		int cycles = 3;				/* consistent cycles wanted */
+		float timeout = 600;		/* s */
+	};
+
+	/* relay around 'bias' holding 'setpoint' [kts]; false if the limits leave no room for a relay */
+	bool start(float setpoint, float bias, float limMin, float limMax, const Settings& s);
+	void cancel() { state = Idle; }
+
+	/* returns the lever for this tick */
+	float update(float speed, float dt);
+
+	State status() const { return state; }
+	bool running() const { return Running == state; }
+	/* why the run failed */
+	const char* error() const { return failure; }
+
+	float ultimateGain() const { return Ku; }
+	float ultimatePeriod() const { return Tu; }
+
+	/* Kp, Ki, Kd of gains set by the rule, other members untouched */
+	static void gains(Rule rule, float Ku, float Tu, PIDController& gains);
+	/* lower case name, as in the log */
+	static const char* name(Rule rule);
+
+private:
+	static const int SettleCycles = 2;
+
+	Settings settings;
+	State state = Idle;
+	const char* failure = "";
+
+	float setpoint = 0;
+	float bias = 0;
+	float amplitude = 0;
+	float limMin = 0;
+	float limMax = 0;
+	bool high = true;
+	float elapsed = 0;
+
+	/* the cycle in progress: started at the last switch up */
+	int cycle = 0;
+	float cycleStart = 0;
+	float highTime = 0;
+	float maxSpeed = 0;
+	float minSpeed = 0;
+
+	/* consecutive agreeing cycles and their sums */
+	int agreeing = 0;
+	float lastPeriod = 0;
+	float lastAmplitude = 0;
+	float periodSum = 0;
+	float amplitudeSum = 0;
+
+	float Ku = 0;
+	float Tu = 0;
+
+	void endCycle();
+};
+
+#endif
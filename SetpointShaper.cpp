@@ -0,0 +1,72 @@
+#include "SetpointShaper.h"
+
+#include <cmath>
+
+void SetpointShaper::configure(float maxAccel, float maxJerk)
+{
+	accelLimit = maxAccel;
+	jerkLimit = maxJerk;
+}
+
+void SetpointShaper::reset(float value)
+{
+	reference = value;
+	referenceRate = 0;
+}
+
+float SetpointShaper::update(float target, float dt)
+{
+	if (!enabled() || dt <= 0)
+	{
+		reference = target;
+		referenceRate = 0;
+		return reference;
+	}
+
+	float distance = target - reference;
+	float desired;
+	if (jerkLimit > 0)
+	{
+		// rate n * jerk * dt that, reduced by jerk * dt per tick, covers the distance: n (n + 1) / 2 ticks' worth
+		float step = jerkLimit * dt;
+		float n = std::sqrt(0.25f + 2.0f * std::fabs(distance) / (step * dt)) - 0.5f;
+		desired = n * step;
+		if (distance < 0)
+			desired = -desired;
+	} else
+		desired = distance / dt;
+
+	if (desired > accelLimit)
+		desired = accelLimit;
+	else if (desired < -accelLimit)
+		desired = -accelLimit;
+
+	if (jerkLimit > 0)
+	{
+		float step = jerkLimit * dt;
+		if (referenceRate < desired - step)
+			referenceRate += step;
+		else if (referenceRate > desired + step)
+			referenceRate -= step;
+		else
+			referenceRate = desired;
+	} else
+		referenceRate = desired;
+
+	// the last tick covers just the rest, the rate is back to zero on the next one
+	float next = reference + referenceRate * dt;
+	if ((target - reference) * (target - next) <= 0)
+	{
+		referenceRate = distance / dt;
+		reference = target;
+	} else
+		reference = next;
+
+	return reference;
+}
+
+void SetpointShaper::scale(float factor)
+{
+	reference *= factor;
+	referenceRate *= factor;
+}
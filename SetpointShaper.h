@@ -0,0 +1,41 @@
+#ifndef SETPOINT_SHAPER_H
+#define SETPOINT_SHAPER_H
+
+/*
+* Reference trajectory between the held speed and the controller: the
+* reference moves towards the target with its rate of change (the commanded
+* acceleration) limited to maxAccel and the change of that rate (jerk) to
+* maxJerk. A setpoint step, a reload or a held speed command thus becomes a
+* smooth S-curve the aircraft can actually fly, instead of a step that
+* saturates the controller and winds up its integrator.
+*
+* The rate aims at about sqrt(2 * jerk * distance), in its discrete form:
+* braking at the jerk limit from there ends exactly at the target with zero
+* rate.
+*/
+class SetpointShaper
+{
+public:
+	/* units of the setpoint per s and per s^2; maxAccel <= 0 passes the target through, maxJerk <= 0 = no jerk limit */
+	void configure(float maxAccel, float maxJerk);
+	bool enabled() const { return accelLimit > 0; }
+
+	/* start at value, at rest */
+	void reset(float value);
+	/* returns the reference for this tick */
+	float update(float target, float dt);
+
+	float value() const { return reference; }
+	float rate() const { return referenceRate; }
+
+	/* the setpoint changes units, reference and rate are multiplied by factor */
+	void scale(float factor);
+
+private:
+	float accelLimit = 0;
+	float jerkLimit = 0;
+	float reference = 0;
+	float referenceRate = 0;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "SmithPredictor.h"
+
+#include <cmath>
+
+bool SmithPredictor::configure(const Model& m, float loopStep)
+{
+	if (!(m.gain > 0) || !(m.damping >= 0) || !(m.spoolTau >= 0) || !(m.deadTime >= 0) || !(loopStep > 0))
+		return false;
+
+	model = m;
+	// one sample per update, room for updates twice as fast as nominal, plus both ends
+	float needed = std::ceil(2 * m.deadTime / loopStep) + 2;
+	capacity = needed < SMITH_PREDICTOR_MAX_SAMPLES ? static_cast<int>(needed) : SMITH_PREDICTOR_MAX_SAMPLES;
+	reset();
+	return true;
+}
+
+void SmithPredictor::reset()
+{
+	started = false;
+	baseLever = 0;
+	spool = 0;
+	speed = 0;
+	rate = 0;
+	time = 0;
+
+	// at rest before engaging
+	head = 0;
+	count = 0;
+	push();
+	delayedSpeed = 0;
+	delayedRate = 0;
+}
+
+void SmithPredictor::push()
+{
+	if (count == capacity)
+	{
+		head = (head + 1) % capacity;
+		--count;
+	}
+	samples[(head + count) % capacity] = { time, speed, rate };
+	++count;
+}
+
+void SmithPredictor::update(float lever, float dt)
+{
+	if (!(dt > 0) || !std::isfinite(lever))
+		return;
+	if (!started)
+	{
+		baseLever = lever;
+		started = true;
+	}
+
+	// spool exact for a lever held over dt, speed implicit in the damping
+	float u = lever - baseLever;
+	if (model.spoolTau > 0)
+		spool += (u - spool) * (1.0f - std::exp(-dt / model.spoolTau));
+	else
+		spool = u;
+	speed = (speed + dt * model.gain * spool) / (1.0f + dt * model.damping);
+	rate = model.gain * spool - model.damping * speed;
+	time += dt;
+	push();
+
+	// oldest sample at or before t - deadTime first; the target only moves forward
+	double target = time - model.deadTime;
+	while (count > 1 && samples[(head + 1) % capacity].time <= target)
+	{
+		head = (head + 1) % capacity;
+		--count;
+	}
+
+	const Sample& older = samples[head];
+	if (count > 1 && older.time < target)
+	{
+		const Sample& newer = samples[(head + 1) % capacity];
+		float f = static_cast<float>((target - older.time) / (newer.time - older.time));
+		delayedSpeed = older.speed + f * (newer.speed - older.speed);
+		delayedRate = older.rate + f * (newer.rate - older.rate);
+	} else
+	{
+		delayedSpeed = older.speed;
+		delayedRate = older.rate;
+	}
+}
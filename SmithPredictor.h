@@ -0,0 +1,88 @@
+#ifndef SMITH_PREDICTOR_H
+#define SMITH_PREDICTOR_H
+
+/* fixed maximum length of the delay line, nothing is allocated */
+#define SMITH_PREDICTOR_MAX_SAMPLES 512
+
+/*
+* Smith predictor for the PID: the lever reaches the speed only after the
+* engine's dead time, and a loop that sees the delayed speed has to be
+* detuned for it. An internal model of the delay-free plant, in the
+* notation of MPC.h
+*
+*   dv/dt = -damping * v + gain * s
+*   ds/dt = (u - s) / spoolTau
+*
+* (v, s, u deviations from engaging) is run on the levers applied, and its
+* output is delayed by 'deadTime' in a delay line. The controller is fed
+*
+*   speed + v(t) - v(t - deadTime)
+*
+* which with a matching model is the speed the aircraft will have once the
+* levers applied so far have arrived: the dead time is out of the loop and
+* the gains can be tuned for the plant without it. Model errors come back
+* through the measured speed, so the loop stays offset free. The rate for
+* the derivative is corrected the same way.
+*
+* The delay line holds time stamped samples, one per update, so jitter in
+* the loop rate does not shift the delay; the delayed value is interpolated
+* between the samples around t - deadTime. Its length is sized from the
+* dead time and the nominal loop step with room for updates twice as fast,
+* up to SMITH_PREDICTOR_MAX_SAMPLES; if the loop runs faster still, the
+* oldest sample is read and the delay comes out shorter.
+*/
+class SmithPredictor
+{
+public:
+	struct Model
+	{
+		float gain = 4;				/* kts/s per unit of engine output */
+		float damping = 0.03f;		/* 1/s, speed stability from drag */
+		float spoolTau = 1.5f;		/* s, 0 = no lag */
+		float deadTime = 1;			/* s */
+	};
+
+	/* loopStep: nominal seconds between updates; false if the model is unusable */
+	bool configure(const Model& m, float loopStep);
+	const Model& configuration() const { return model; }
+
+	/* engaging: the model at rest, the delay line holds no change yet */
+	void reset();
+
+	/* 'lever' the output applied over the last dt */
+	void update(float lever, float dt);
+
+	/* to add to the measured speed [kts] and its rate [kts/s] */
+	float correction() const { return speed - delayedSpeed; }
+	float rateCorrection() const { return rate - delayedRate; }
+
+private:
+	struct Sample
+	{
+		double time;
+		float speed;
+		float rate;
+	};
+
+	void push();
+
+	Model model;
+	int capacity = 2;
+
+	/* the delay-free model, deviations from engaging */
+	bool started = false;
+	float baseLever = 0;
+	float spool = 0;
+	float speed = 0;
+	float rate = 0;
+	double time = 0;
+
+	/* the last 'count' samples, oldest at 'head' */
+	Sample samples[SMITH_PREDICTOR_MAX_SAMPLES] = {};
+	int head = 0;
+	int count = 0;
+	float delayedSpeed = 0;
+	float delayedRate = 0;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "SpeedFilter.h"
+
+/* time constant of the IAS/TAS ratio filter, s */
+#define SPEED_FILTER_RATIO_TAU 10.0f
+/* below this TAS and groundspeed are not used, kts */
+#define SPEED_FILTER_MIN_SPEED 30.0f
+/* initial uncertainty of rate [kts/s] and offset [kts] */
+#define SPEED_FILTER_RATE_SD 1.0f
+#define SPEED_FILTER_OFFSET_SD 5.0f
+
+void SpeedFilter::reset(const Inputs& in)
+{
+	if (in.tas > SPEED_FILTER_MIN_SPEED)
+		iasPerTas = in.ias / in.tas;
+
+	x[Speed] = in.ias;
+	x[Rate] = 0;
+	x[Offset] = in.groundspeed > SPEED_FILTER_MIN_SPEED ? in.ias - iasPerTas * in.groundspeed : 0.0f;
+
+	for (int i = 0; i < States; ++i)
+		for (int j = 0; j < States; ++j)
+			P[i][j] = 0;
+	P[Speed][Speed] = noise.ias * noise.ias;
+	P[Rate][Rate] = SPEED_FILTER_RATE_SD * SPEED_FILTER_RATE_SD;
+	P[Offset][Offset] = SPEED_FILTER_OFFSET_SD * SPEED_FILTER_OFFSET_SD;
+}
+
+float SpeedFilter::update(const Inputs& in, float dt)
+{
+	if (dt <= 0)
+		return x[Speed];
+
+	// predict: speed integrates the rate, F = [1 dt 0; 0 1 0; 0 0 1]
+	x[Speed] += x[Rate] * dt;
+
+	// F P F' written out
+	float pss = P[Speed][Speed] + dt * (2.0f * P[Speed][Rate] + dt * P[Rate][Rate]);
+	float psr = P[Speed][Rate] + dt * P[Rate][Rate];
+	float pso = P[Speed][Offset] + dt * P[Rate][Offset];
+	P[Speed][Speed] = pss;
+	P[Speed][Rate] = P[Rate][Speed] = psr;
+	P[Speed][Offset] = P[Offset][Speed] = pso;
+
+	// white jerk into speed and rate, random walk offset
+	float q = noise.jerk * noise.jerk;
+	float dt2 = dt * dt;
+	P[Speed][Speed] += q * dt2 * dt / 3.0f;
+	P[Speed][Rate] += q * dt2 / 2.0f;
+	P[Rate][Speed] = P[Speed][Rate];
+	P[Rate][Rate] += q * dt;
+	P[Offset][Offset] += noise.wind * noise.wind * dt;
+
+	// correct, one sensor at a time
+	static const float iasRow[States] = { 1, 0, 0 };
+	static const float groundspeedRow[States] = { 1, 0, -1 };
+	static const float accelRow[States] = { 0, 1, 0 };
+
+	correct(iasRow, in.ias, noise.ias * noise.ias);
+
+	if (in.tas > SPEED_FILTER_MIN_SPEED)
+		iasPerTas += (in.ias / in.tas - iasPerTas) * dt / (SPEED_FILTER_RATIO_TAU + dt);
+	if (in.groundspeed > SPEED_FILTER_MIN_SPEED)
+	{
+		correct(groundspeedRow, iasPerTas * in.groundspeed, noise.groundspeed * noise.groundspeed);
+		correct(accelRow, iasPerTas * in.accel, noise.accel * noise.accel);
+	}
+
+	return x[Speed];
+}
+
+void SpeedFilter::correct(const float (&h)[States], float z, float variance)
+{
+	// Ph = P h', innovation variance s = h P h' + r
+	float ph[States];
+	float innovation = z;
+	for (int i = 0; i < States; ++i)
+	{
+		ph[i] = 0;
+		for (int j = 0; j < States; ++j)
+			ph[i] += P[i][j] * h[j];
+		innovation -= h[i] * x[i];
+	}
+	float s = variance;
+	for (int i = 0; i < States; ++i)
+		s += h[i] * ph[i];
+	if (s <= 0)
+		return;
+
+	// x += K innovation, P -= K h P with K = Ph / s; P stays symmetric
+	for (int i = 0; i < States; ++i)
+		x[i] += ph[i] / s * innovation;
+	for (int i = 0; i < States; ++i)
+		for (int j = 0; j < States; ++j)
+			P[i][j] -= ph[i] * ph[j] / s;
+}
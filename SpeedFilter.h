@@ -0,0 +1,74 @@
+#ifndef SPEED_FILTER_H
+#define SPEED_FILTER_H
+
+/*
+* Kalman filter for the speed the controller holds. The state is
+*
+*   IAS [kts], its rate [kts/s], and the offset between IAS and the scaled
+*   groundspeed [kts]
+*
+* with the rate as a random walk driven by jerk and the offset (wind) as a
+* slow random walk. Three sensors are fused, each as a scalar update so there
+* is no matrix inverse:
+*
+*   IAS          noisy and quantised, the only one that sees the air mass
+*   groundspeed  smooth, differs from IAS by the wind and the density
+*   acceleration along the track, inertial, the cleanest rate
+*
+* Groundspeed and acceleration are scaled to indicated knots with the IAS/TAS
+* ratio (low-pass filtered), so with a steady wind they move like IAS does.
+* A sensor that is not available (value <= 0 for TAS and groundspeed) is
+* skipped, the filter then runs on IAS alone.
+*
+* All sizes are fixed, update() does not allocate.
+*/
+class SpeedFilter
+{
+public:
+	enum State
+	{
+		Speed,
+		Rate,
+		Offset,
+		States
+	};
+
+	struct Inputs
+	{
+		float ias;			/* kts */
+		float tas;			/* kts, <= 0 = unknown */
+		float groundspeed;	/* kts, <= 0 = unknown */
+		float accel;		/* along the track, kts/s; ignored without groundspeed */
+	};
+
+	/* standard deviations */
+	struct Noise
+	{
+		float ias = 0.5f;			/* kts, measurement */
+		float groundspeed = 0.1f;	/* kts, measurement */
+		float accel = 0.02f;		/* kts/s, measurement */
+		float jerk = 0.5f;			/* kts/s^2, process: how fast the rate may change */
+		float wind = 0.05f;			/* kts/sqrt(s), process: how fast the offset may change */
+	};
+
+	void configure(const Noise& n) { noise = n; }
+
+	/* at rest at the current speed, offset from the current groundspeed */
+	void reset(const Inputs& in);
+	/* predict by dt, then correct with the inputs; returns the filtered speed */
+	float update(const Inputs& in, float dt);
+
+	float speed() const { return x[Speed]; }
+	float rate() const { return x[Rate]; }
+	float offset() const { return x[Offset]; }
+
+private:
+	void correct(const float (&h)[States], float z, float variance);
+
+	Noise noise;
+	float x[States] = {};
+	float P[States][States] = {};
+	float iasPerTas = 1;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/*
+* Fixed-size single producer / single consumer ring of trivially copyable
+* records. push() and pop() are wait-free: one relaxed load of the own index,
+* one acquire load of the other side's index and one release store. Head and
+* tail live on separate cache lines so producer and consumer do not share one.
+*/
+template <class T, std::size_t Capacity>
+class SpscRing
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SpscRing holds plain records");
+	static_assert(Capacity >= 2 && 0 == (Capacity & (Capacity - 1)), "Capacity must be a power of two");
+
+	alignas(64) std::atomic<std::size_t> head{ 0 };		/* next slot to write, producer owned */
+	alignas(64) std::atomic<std::size_t> tail{ 0 };		/* next slot to read, consumer owned */
+	alignas(64) T slots[Capacity];
+
+public:
+	/* producer thread only, false if the ring is full */
+	bool push(const T& item)
+	{
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		slots[h & (Capacity - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* consumer thread only, false if the ring is empty */
+	bool pop(T& item)
+	{
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (head.load(std::memory_order_acquire) == t)
+			return false;
+
+		item = slots[t & (Capacity - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* approximate unless called from one of the two threads with the other idle */
+	std::size_t size() const
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+	static constexpr std::size_t capacity() { return Capacity; }
+};
+
+#endif
@@ -0,0 +1,235 @@
+// Sweep/main.cpp : closed-loop gain sweep of the PID class against a plant model.
+//
+// usage: sweep [--aircraft C90B|Cessna_CitationX] [--ini FILE]
+//              [--kp MIN:MAX:STEPS] [--ki ...] [--kd ...] [--tau ...]
+//              [--limMin ...] [--limMax ...] [--limIntMin ...] [--limIntMax ...]
+//              [--random N] [--seed N] [--from KTS] [--to KTS] [--setpoint SEC=KTS ...]
+//              [--duration SEC] [--T SEC] [--band KTS] [--threads N] [--top N] [--out FILE]
+//              [--model FILE] [--model-order 1|2]
+//
+// Every candidate flies the same scenario: the plant starts at --from with the
+// controller cold and --to as hold speed, optional further --setpoint changes
+// follow. Values not swept come from --ini (the plugin's <aircraft>.ini) or the
+// defaults below. Without --random the ranges are expanded as a full grid, with
+// --random N each range is sampled uniformly and STEPS only has to be non-zero.
+// --model flies a model file written by Identify instead of the built-in
+// airframe, starting trimmed at --from; --model-order 1 picks its first order
+// plus dead time model over the second order one.
+//
+// Build:
+//   g++ -std=c++17 -O2 -pthread -I.. main.cpp ../GainSweep.cpp ../WorkStealingPool.cpp ../PlantModel.cpp ../PID.cpp -o sweep
+//   cl /std:c++17 /O2 /EHsc /I.. main.cpp ..\GainSweep.cpp ..\WorkStealingPool.cpp ..\PlantModel.cpp ..\PID.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "GainSweep.h"
+#include "PlantModel.h"
+#include "WorkStealingPool.h"
+
+/* same key=value format and comment rules as the plugin's loader */
+static bool loadIni(const std::string& fileName, PIDController& ctrl, SweepScenario& scenario)
+{
+	std::ifstream fs{ fileName };
+	if (!fs.is_open())
+		return false;
+
+	std::map<std::string, float> cfg;
+	std::string str;
+	while (fs >> str)
+	{
+		if (str.substr(0, 2) == "//" || str.substr(0, 1) == "#")
+			continue;
+
+		auto pos = str.find('=');
+		if (std::string::npos == pos)
+			continue;
+		cfg[str.substr(0, pos)] = static_cast<float>(atof(str.substr(pos + 1).c_str()));
+	}
+
+	ctrl.Kp = cfg["kp"];
+	ctrl.Ki = cfg["ki"];
+	ctrl.Kd = cfg["kd"];
+	ctrl.tau = cfg["tau"];
+	ctrl.limMin = cfg["limMin"];
+	ctrl.limMax = cfg["limMax"];
+	ctrl.limMinInt = cfg["limIntMin"];
+	ctrl.limMaxInt = cfg["limIntMax"];
+	ctrl.denormalMode = static_cast<int>(cfg["denormal_mode"]);
+	if (cfg["setpoint"] > 0)
+		scenario.setpoint = cfg["setpoint"];
+	if (cfg["pid_time"] > 0)
+		scenario.T = cfg["pid_time"];
+
+	return true;
+}
+
+static bool parseRange(const std::string& value, SweepRange& range)
+{
+	float min, max;
+	unsigned steps;
+
+	if (3 != sscanf(value.c_str(), "%f:%f:%u", &min, &max, &steps) || 0 == steps)
+		return false;
+
+	range = SweepRange{ min, max, steps };
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string aircraft = "C90B";
+	std::string iniFile;
+	std::string outFile;
+	float from = 0;
+	std::size_t randomCount = 0;
+	unsigned seed = 1;
+	unsigned threads = 0;
+	std::size_t top = 20;
+	std::string modelFile;
+	int modelOrder = 2;
+
+	PIDController base{ 0 };
+	base.Kp = 0.17f;
+	base.Ki = 0.1f;
+	base.Kd = 0.06f;
+	base.tau = 0.008f;
+	base.limMin = 0.05f;
+	base.limMax = 0.765f;
+	base.limMinInt = 0.05f;
+	base.limMaxInt = 0.555f;
+
+	SweepScenario scenario;
+	SweepSpace space;
+	std::map<std::string, SweepRange*> ranges{
+		{ "--kp", &space.kp }, { "--ki", &space.ki }, { "--kd", &space.kd }, { "--tau", &space.tau },
+		{ "--limMin", &space.limMin }, { "--limMax", &space.limMax },
+		{ "--limIntMin", &space.limMinInt }, { "--limIntMax", &space.limMaxInt }
+	};
+	float toOverride = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (ranges.count(arg) && hasValue)
+		{
+			if (!parseRange(argv[++i], *ranges[arg]))
+			{
+				fprintf(stderr, "%s expects MIN:MAX:STEPS, got %s\n", arg.c_str(), argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if ("--aircraft" == arg && hasValue)
+			aircraft = argv[++i];
+		else if ("--ini" == arg && hasValue)
+			iniFile = argv[++i];
+		else if ("--random" == arg && hasValue)
+			randomCount = strtoul(argv[++i], nullptr, 10);
+		else if ("--seed" == arg && hasValue)
+			seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if ("--from" == arg && hasValue)
+			from = static_cast<float>(atof(argv[++i]));
+		else if ("--to" == arg && hasValue)
+			toOverride = static_cast<float>(atof(argv[++i]));
+		else if ("--duration" == arg && hasValue)
+			scenario.duration = static_cast<float>(atof(argv[++i]));
+		else if ("--T" == arg && hasValue)
+			scenario.T = static_cast<float>(atof(argv[++i]));
+		else if ("--band" == arg && hasValue)
+			scenario.settleBand = static_cast<float>(atof(argv[++i]));
+		else if ("--threads" == arg && hasValue)
+			threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if ("--top" == arg && hasValue)
+			top = strtoul(argv[++i], nullptr, 10);
+		else if ("--out" == arg && hasValue)
+			outFile = argv[++i];
+		else if ("--model" == arg && hasValue)
+			modelFile = argv[++i];
+		else if ("--model-order" == arg && hasValue)
+			modelOrder = atoi(argv[++i]);
+		else if ("--setpoint" == arg && hasValue)
+		{
+			std::string sp = argv[++i];
+			auto pos = sp.find('=');
+			if (std::string::npos == pos)
+			{
+				fprintf(stderr, "--setpoint expects SEC=KTS, got %s\n", sp.c_str());
+				return EXIT_FAILURE;
+			}
+			scenario.steps.push_back({ static_cast<float>(atof(sp.substr(0, pos).c_str())),
+				static_cast<float>(atof(sp.substr(pos + 1).c_str())) });
+		} else
+		{
+			fprintf(stderr, "unknown argument: %s\n", arg.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!iniFile.empty() && !loadIni(iniFile, base, scenario))
+	{
+		fprintf(stderr, "failed to load %s\n", iniFile.c_str());
+		return EXIT_FAILURE;
+	}
+	if (toOverride > 0)
+		scenario.setpoint = toOverride;
+
+	bool citation = "Cessna_CitationX" == aircraft || "CitationX" == aircraft;
+	if (!citation && "C90B" != aircraft)
+	{
+		fprintf(stderr, "unknown aircraft: %s\n", aircraft.c_str());
+		return EXIT_FAILURE;
+	}
+	if (0 == from)
+		from = citation ? 220.0f : 150.0f;
+
+	std::unique_ptr<PlantModel> plant;
+	if (modelFile.empty())
+		plant = std::make_unique<AirspeedPlant>(citation ? AirspeedPlant::CitationX(from) : AirspeedPlant::C90B(from));
+	else
+	{
+		SpeedModelPlant::Params firstOrder, secondOrder;
+		if (!SpeedModelPlant::load(modelFile, firstOrder, secondOrder))
+		{
+			fprintf(stderr, "failed to load model %s\n", modelFile.c_str());
+			return EXIT_FAILURE;
+		}
+		plant = std::make_unique<SpeedModelPlant>(1 == modelOrder ? firstOrder : secondOrder, from);
+	}
+
+	auto candidates = randomCount > 0
+		? GainSweep::expandRandom(space, base, randomCount, seed)
+		: GainSweep::expandGrid(space, base);
+	if (candidates.empty())
+	{
+		fprintf(stderr, "no valid candidates, check the limit ranges\n");
+		return EXIT_FAILURE;
+	}
+
+	WorkStealingPool pool{ threads };
+	GainSweep sweep{ *plant, scenario };
+
+	auto start = std::chrono::steady_clock::now();
+	auto results = sweep.run(candidates, pool);
+	auto stop = std::chrono::steady_clock::now();
+	double wall = std::chrono::duration<double>(stop - start).count();
+
+	if (outFile.empty())
+		GainSweep::writeTable(std::cout, results, top);
+	else
+	{
+		std::ofstream out{ outFile };
+		GainSweep::writeTable(out, results, top);
+	}
+
+	fprintf(stderr, "%zu candidates, %.0f s each, on %u threads in %.3f s (%.0f simulated s per wall s)\n",
+		results.size(), scenario.duration, pool.size(), wall, results.size() * scenario.duration / wall);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,271 @@
+#include "TrimTable.h"
+
+#include <cmath>
+#include <limits>
+
+/* conjugate gradient iterations per unknown, and the relative residual it stops at */
+#define TRIM_CG_ITERATIONS_PER_VALUE 4
+#define TRIM_CG_TOLERANCE 1e-10
+
+namespace
+{
+	/* grid offsets and weights of the (up to 8) table values a point blends */
+	struct Stencil
+	{
+		int count;
+		int offset[OperatingGrid::Corners];
+		float weight[OperatingGrid::Corners];
+	};
+
+	float mean(const std::vector<float>& v, std::size_t first, std::size_t last)
+	{
+		if (v.empty())
+			return std::numeric_limits<float>::quiet_NaN();
+		double sum = 0;
+		for (std::size_t i = first; i <= last; ++i)
+			sum += v[i];
+		return static_cast<float>(sum / (last - first + 1));
+	}
+}
+
+void TrimTable::clear()
+{
+	grid.clear();
+	levers.clear();
+}
+
+bool TrimTable::configure(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<float>& values)
+{
+	clear();
+	if (!grid.configure(breakpoints))
+	{
+		lastError = grid.error();
+		return false;
+	}
+	if (static_cast<int>(values.size()) != grid.size())
+	{
+		lastError = "number of lever values does not match the breakpoints";
+		clear();
+		return false;
+	}
+	levers = values;
+	lastError = "";
+	return true;
+}
+
+float TrimTable::lever(const float (&point)[OperatingGrid::Axes]) const
+{
+	int offset[OperatingGrid::Corners];
+	float weight[OperatingGrid::Corners];
+	int count = grid.corners(point, offset, weight);
+	return OperatingGrid::blend(levers.data(), offset, weight, count);
+}
+
+std::size_t TrimTable::steadyPoints(const std::vector<float>& t, const std::vector<float>& speed, const std::vector<float>& lever,
+	const std::vector<float>& altitude, const std::vector<float>& weight, const Steady& steady, std::vector<TrimPoint>& points)
+{
+	std::size_t n = t.size();
+	std::size_t added = 0;
+	if (speed.size() != n || lever.size() != n || !(steady.window > 0)
+		|| (!altitude.empty() && altitude.size() != n) || (!weight.empty() && weight.size() != n))
+		return 0;
+
+	auto finite = [&](std::size_t i) { return std::isfinite(t[i]) && std::isfinite(speed[i]) && std::isfinite(lever[i]); };
+
+	std::size_t first = 0;
+	while (first < n)
+	{
+		if (!finite(first))
+		{
+			++first;
+			continue;
+		}
+
+		// longest stretch from first within both bands, without pauses
+		float minSpeed = speed[first], maxSpeed = speed[first];
+		float minLever = lever[first], maxLever = lever[first];
+		std::size_t last = first;
+		while (last + 1 < n && finite(last + 1) && t[last + 1] > t[last] && t[last + 1] - t[last] <= steady.maxGap)
+		{
+			float v = speed[last + 1], u = lever[last + 1];
+			float lowSpeed = v < minSpeed ? v : minSpeed, highSpeed = v > maxSpeed ? v : maxSpeed;
+			float lowLever = u < minLever ? u : minLever, highLever = u > maxLever ? u : maxLever;
+			if (highSpeed - lowSpeed > steady.speedBand || highLever - lowLever > steady.leverBand)
+				break;
+			minSpeed = lowSpeed, maxSpeed = highSpeed;
+			minLever = lowLever, maxLever = highLever;
+			++last;
+		}
+
+		float length = t[last] - t[first];
+		if (length < steady.window)
+		{
+			// a steady stretch may still start further on
+			++first;
+			continue;
+		}
+
+		// pieces of 'window' seconds, the last one takes the rest
+		int pieces = static_cast<int>(length / steady.window);
+		std::size_t begin = first;
+		for (int k = 1; k <= pieces; ++k)
+		{
+			std::size_t end = begin;
+			if (k == pieces)
+				end = last;
+			else
+			{
+				while (end < last && t[end + 1] < t[first] + k * steady.window)
+					++end;
+			}
+
+			TrimPoint p;
+			p.ias = mean(speed, begin, end);
+			p.altitude = mean(altitude, begin, end);
+			p.weight = mean(weight, begin, end);
+			p.lever = mean(lever, begin, end);
+			p.duration = t[end] - t[begin];
+			points.push_back(p);
+			++added;
+			begin = end + 1;
+		}
+		first = last + 1;
+	}
+	return added;
+}
+
+bool TrimTable::fit(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<TrimPoint>& points,
+	float smoothing, float& rms, std::size_t& used)
+{
+	clear();
+	rms = 0;
+	used = 0;
+
+	// the fit blends with the weights the lookup will use
+	if (!grid.configure(breakpoints))
+	{
+		lastError = grid.error();
+		return false;
+	}
+	int size = grid.size();
+
+	// the table values each point blends, with its weight in the fit
+	std::vector<Stencil> stencils;
+	std::vector<double> targets, durations;
+	for (auto& p : points)
+	{
+		float x[OperatingGrid::Axes] = { p.ias, p.altitude, p.weight };
+		bool usable = std::isfinite(p.lever) && p.duration > 0;
+		for (int a = 0; a < OperatingGrid::Axes; ++a)
+			usable = usable && (!grid.uses(static_cast<OperatingGrid::Axis>(a)) || std::isfinite(x[a]));
+		if (!usable)
+			continue;
+
+		Stencil s;
+		s.count = grid.corners(x, s.offset, s.weight);
+		stencils.push_back(s);
+		targets.push_back(p.lever);
+		durations.push_back(p.duration);
+	}
+	if (stencils.empty())
+	{
+		lastError = "";
+		clear();
+		return false;
+	}
+
+	// normal equations (A' D A + smoothing L) x = A' D y, L the first difference Laplacian of the grid
+	double lambda = smoothing > 0 ? smoothing : 0.0;
+	auto multiply = [&](const std::vector<double>& x, std::vector<double>& y) {
+		y.assign(size, 0.0);
+		for (std::size_t i = 0; i < stencils.size(); ++i)
+		{
+			auto& s = stencils[i];
+			double v = 0;
+			for (int c = 0; c < s.count; ++c)
+				v += s.weight[c] * x[s.offset[c]];
+			v *= durations[i];
+			for (int c = 0; c < s.count; ++c)
+				y[s.offset[c]] += s.weight[c] * v;
+		}
+		if (lambda > 0)
+		{
+			for (int g = 0; g < size; ++g)
+			{
+				for (int a = 0; a < OperatingGrid::Axes; ++a)
+				{
+					auto axis = static_cast<OperatingGrid::Axis>(a);
+					int points = grid.points(axis), stride = grid.stride(axis);
+					if (points < 2 || (g / stride) % points == points - 1)
+						continue;
+					double d = lambda * (x[g] - x[g + stride]);
+					y[g] += d;
+					y[g + stride] -= d;
+				}
+			}
+		}
+	};
+
+	std::vector<double> b(size, 0.0);
+	double meanLever = 0, total = 0;
+	for (std::size_t i = 0; i < stencils.size(); ++i)
+	{
+		auto& s = stencils[i];
+		for (int c = 0; c < s.count; ++c)
+			b[s.offset[c]] += s.weight[c] * durations[i] * targets[i];
+		meanLever += durations[i] * targets[i];
+		total += durations[i];
+	}
+	meanLever /= total;
+
+	// conjugate gradients from the mean lever everywhere; without smoothing, grid points without data keep it
+	std::vector<double> x(size, meanLever), r, p, q;
+	multiply(x, r);
+	for (int g = 0; g < size; ++g)
+		r[g] = b[g] - r[g];
+	p = r;
+	double rr = 0, bb = 0;
+	for (int g = 0; g < size; ++g)
+	{
+		rr += r[g] * r[g];
+		bb += b[g] * b[g];
+	}
+	for (int it = 0; it < TRIM_CG_ITERATIONS_PER_VALUE * size && rr > TRIM_CG_TOLERANCE * TRIM_CG_TOLERANCE * bb; ++it)
+	{
+		multiply(p, q);
+		double pq = 0;
+		for (int g = 0; g < size; ++g)
+			pq += p[g] * q[g];
+		if (!(pq > 0))
+			break;
+		double alpha = rr / pq;
+		double next = 0;
+		for (int g = 0; g < size; ++g)
+		{
+			x[g] += alpha * p[g];
+			r[g] -= alpha * q[g];
+			next += r[g] * r[g];
+		}
+		for (int g = 0; g < size; ++g)
+			p[g] = r[g] + next / rr * p[g];
+		rr = next;
+	}
+
+	levers.resize(size);
+	for (int g = 0; g < size; ++g)
+		levers[g] = static_cast<float>(x[g]);
+	lastError = "";
+
+	double sum = 0;
+	for (std::size_t i = 0; i < stencils.size(); ++i)
+	{
+		auto& s = stencils[i];
+		double v = 0;
+		for (int c = 0; c < s.count; ++c)
+			v += s.weight[c] * x[s.offset[c]];
+		sum += (v - targets[i]) * (v - targets[i]);
+	}
+	rms = static_cast<float>(std::sqrt(sum / stencils.size()));
+	used = stencils.size();
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef TRIM_TABLE_H
+#define TRIM_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "OperatingGrid.h"
+
+/* one steady segment of a log: speed, altitude and weight held, and the lever that held them */
+struct TrimPoint
+{
+	float ias;			/* kts */
+	float altitude;		/* pressure altitude, ft, NaN if the log has none */
+	float weight;		/* gross weight, kg, NaN if the log has none */
+	float lever;
+	float duration;		/* s, the fit weights the point by it */
+};
+
+/*
+* Steady state lever over IAS, pressure altitude and gross weight: the
+* lever that holds the speed against the drag, used as the PID's
+* feedforward so the PID only corrects the residual (gusts, trim and
+* configuration changes the table does not know).
+*
+* The table lies on an OperatingGrid like the gain schedule (any axis can
+* be left out, edge values hold outside the breakpoints); the lookup is the
+* grid's, O(1) and without allocating.
+*
+* It is learned from flight logs: steadyPoints() picks the segments where
+* speed and lever both stayed within a band for a while, fit() solves the
+* table values by least squares on the interpolated table at those points.
+* A first difference penalty between neighbouring table values fills grid
+* points no segment came near and keeps sparse data from bending the
+* table; where the data is dense it hardly matters.
+*/
+class TrimTable
+{
+public:
+	/* what counts as steady */
+	struct Steady
+	{
+		float window = 20;			/* s, shortest steady segment */
+		float speedBand = 1.0f;		/* kts, max - min of the speed within a segment */
+		float leverBand = 0.02f;	/* lever units, max - min of the lever within a segment */
+		float maxGap = 1.0f;		/* s, a longer pause in the log ends a segment */
+	};
+
+	/*
+	* breakpoints: as GainSchedule, strictly increasing per axis, empty =
+	* axis not used. levers: one value per grid point, IAS fastest. Returns
+	* false and stays disabled if the sizes do not fit.
+	*/
+	bool configure(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<float>& levers);
+	void clear();
+
+	bool enabled() const { return !levers.empty(); }
+	bool uses(OperatingGrid::Axis a) const { return grid.uses(a); }
+	/* interpolated steady lever at the operating point; only valid if enabled() */
+	float lever(const float (&point)[OperatingGrid::Axes]) const;
+
+	/* why the last configure() or fit() failed */
+	const char* error() const { return lastError; }
+
+	/*
+	* appends the steady segments of one logged run (samples of time [s],
+	* speed [kts], lever; altitude and weight empty or one per sample) to
+	* points, each segment cut into pieces of 'window' seconds; returns how
+	* many were added
+	*/
+	static std::size_t steadyPoints(const std::vector<float>& t, const std::vector<float>& speed, const std::vector<float>& lever,
+		const std::vector<float>& altitude, const std::vector<float>& weight, const Steady& steady, std::vector<TrimPoint>& points);
+
+	/*
+	* fits the table on the breakpoints to the points and configures it;
+	* points without a value on a used axis are left out. smoothing weights
+	* the squared difference of neighbouring values against one second of
+	* steady data. rms: lever units, of the table at the points used. False
+	* if no point is usable or the breakpoints are not.
+	*/
+	bool fit(const std::vector<float> (&breakpoints)[OperatingGrid::Axes], const std::vector<TrimPoint>& points,
+		float smoothing, float& rms, std::size_t& used);
+
+	/* the fitted or configured values, IAS fastest */
+	const std::vector<float>& values() const { return levers; }
+
+private:
+	OperatingGrid grid;
+	std::vector<float> levers;	/* per grid point, empty = disabled */
+	const char* lastError = "";
+};
+
+#endif
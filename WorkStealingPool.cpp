@@ -0,0 +1,105 @@
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+	if (0 == threads)
+		threads = std::thread::hardware_concurrency();
+	if (0 == threads)
+		threads = 1;
+
+	for (unsigned i = 0; i < threads; ++i)
+		queues.emplace_back(new Queue);
+
+	for (unsigned i = 0; i < threads; ++i)
+		workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> guard{ sleepLock };
+		stopping = true;
+	}
+	wakeUp.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+}
+
+void WorkStealingPool::submit(std::function<void()> task)
+{
+	/* round robin over the worker deques, stealing evens out the rest */
+	unsigned index = nextQueue.fetch_add(1, std::memory_order_relaxed) % size();
+
+	/* counted before it can be popped, so a worker's decrement never runs ahead of it */
+	pending.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> guard{ sleepLock };
+		queued.fetch_add(1);
+	}
+	{
+		std::lock_guard<std::mutex> guard{ queues[index]->lock };
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	wakeUp.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> guard{ sleepLock };
+	allDone.wait(guard, [this]() { return 0 == pending.load(); });
+}
+
+bool WorkStealingPool::popOrSteal(unsigned index, std::function<void()>& task)
+{
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> guard{ own.lock };
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	for (unsigned n = 1; n < size(); ++n)
+	{
+		Queue& victim = *queues[(index + n) % size()];
+		std::lock_guard<std::mutex> guard{ victim.lock };
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned index)
+{
+	std::function<void()> task;
+
+	for (;;)
+	{
+		if (popOrSteal(index, task))
+		{
+			queued.fetch_sub(1);
+			task();
+			task = nullptr;
+
+			if (1 == pending.fetch_sub(1))
+			{
+				std::lock_guard<std::mutex> guard{ sleepLock };
+				allDone.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard{ sleepLock };
+		wakeUp.wait(guard, [this]() { return stopping || queued.load() > 0; });
+		if (stopping && 0 == queued.load())
+			return;
+	}
+}
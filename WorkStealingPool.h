@@ -0,0 +1,78 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Fixed set of worker threads, one task deque each. A worker pops its own
+* deque from the back and steals from the front of the others when it runs
+* dry, so uneven task cost (e.g. simulations that diverge early) balances
+* itself without a central queue.
+*/
+class WorkStealingPool
+{
+public:
+	/* 0 = one worker per hardware thread */
+	explicit WorkStealingPool(unsigned threads = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	/* the queues are complete before the first worker starts, workers still grows then */
+	unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+	void submit(std::function<void()> task);
+
+	/* blocks until every submitted task has finished */
+	void wait();
+
+	/* f(i) for i in [begin, end), in chunks of grain indices per task */
+	template <class F>
+	void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F f)
+	{
+		if (0 == grain)
+			grain = 1;
+
+		for (std::size_t first = begin; first < end; first += grain)
+		{
+			std::size_t last = first + grain < end ? first + grain : end;
+			submit([first, last, &f]() {
+				for (std::size_t i = first; i < last; ++i)
+					f(i);
+			});
+		}
+		wait();
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void workerLoop(unsigned index);
+	bool popOrSteal(unsigned index, std::function<void()>& task);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+	std::condition_variable allDone;
+	std::atomic<std::size_t> queued{ 0 };		/* submitted, not yet picked up */
+	std::atomic<std::size_t> pending{ 0 };		/* submitted, not yet finished */
+	std::atomic<unsigned> nextQueue{ 0 };
+	bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "DataRefSnapshot.h"
+
+bool DataRefSnapshot::add(const char* name, Kind kind, void* target, int count)
+{
+	XPLMDataRef ref = XPLMFindDataRef(name);
+	if (nullptr == ref)
+		return false;
+
+	inputs.push_back({ ref, kind, target, count });
+	return true;
+}
+
+bool DataRefSnapshot::addFloat(const char* name, float* target)
+{
+	return add(name, Kind::Float, target, 1);
+}
+
+bool DataRefSnapshot::addInt(const char* name, int* target)
+{
+	return add(name, Kind::Int, target, 1);
+}
+
+bool DataRefSnapshot::addFloatArray(const char* name, float* target, int count)
+{
+	return add(name, Kind::FloatArray, target, count);
+}
+
+bool DataRefSnapshot::addIntArray(const char* name, int* target, int count)
+{
+	return add(name, Kind::IntArray, target, count);
+}
+
+void DataRefSnapshot::read()
+{
+	for (auto& in : inputs)
+	{
+		switch (in.kind)
+		{
+			case Kind::Float:
+				*static_cast<float*>(in.target) = XPLMGetDataf(in.ref);
+				break;
+
+			case Kind::Int:
+				*static_cast<int*>(in.target) = XPLMGetDatai(in.ref);
+				break;
+
+			case Kind::FloatArray:
+				XPLMGetDatavf(in.ref, static_cast<float*>(in.target), 0, in.count);
+				break;
+
+			case Kind::IntArray:
+				XPLMGetDatavi(in.ref, static_cast<int*>(in.target), 0, in.count);
+				break;
+		}
+	}
+}
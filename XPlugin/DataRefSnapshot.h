@@ -0,0 +1,49 @@
+#pragma once
+
+#include <XPLMDataAccess.h>
+
+#include <cstddef>
+#include <vector>
+
+///
+/// Reads every registered input dataref once per frame into caller owned
+/// storage (usually one plain struct), so controller, logging and UI code
+/// read plain memory instead of crossing the XPLM API boundary per access.
+/// Array datarefs are fetched with one XPLMGetDatavf/XPLMGetDatavi call.
+///
+class DataRefSnapshot
+{
+public:
+	/// false if the dataref does not exist; target is left untouched by read() then
+	bool addFloat(const char* name, float* target);
+	bool addInt(const char* name, int* target);
+	bool addFloatArray(const char* name, float* target, int count);
+	bool addIntArray(const char* name, int* target, int count);
+	void clear() { inputs.clear(); }
+
+	/// one XPLM call per registered dataref
+	void read();
+
+	std::size_t size() const { return inputs.size(); }
+
+private:
+	enum class Kind
+	{
+		Float,
+		Int,
+		FloatArray,
+		IntArray
+	};
+
+	struct Input
+	{
+		XPLMDataRef ref;
+		Kind kind;
+		void* target;
+		int count;
+	};
+
+	std::vector<Input> inputs;
+
+	bool add(const char* name, Kind kind, void* target, int count);
+};
@@ -9,17 +9,39 @@
 #include <XPStandardWidgets.h>
 #include <XPLMGraphics.h>
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <iomanip>
 #include <map>
 #include <sstream>
 
+#include "../ADRC.h"
+#include "../AdaptiveGains.h"
+#include "../EngineSync.h"
+#include "../EnvelopeLimiter.h"
+#include "../FlightLog.h"
+#include "../FlightPhase.h"
+#include "../GainSchedule.h"
+#include "../MachHold.h"
+#include "../MPC.h"
+#include "../OperatingGrid.h"
 #include "../PID.h"
+#include "../PlantEstimator.h"
+#include "../RelayTuner.h"
+#include "../SetpointShaper.h"
+#include "../SmithPredictor.h"
+#include "../SpeedFilter.h"
+#include "../TrimTable.h"
+#include "DataRefSnapshot.h"
 
 ///
 /// ideas: 
-///  - disable AT and set idle when 100 ft above ground (AGL)
+///  - disable AT and set idle when 100 ft above ground (AGL) (idle: FlightPhase retard)
 ///  - minimum setable speeds per aircraft
 ///	 - take into account ITT / max Torque when setting max output value
 
@@ -30,6 +52,16 @@
 /// <param name="itemRef"></param>
 void AutoThrottleMenuHandler(void* menuRef, void* itemRef);
 float getAutoSpeed(void* ref);
+float getHoldMach(void* ref);
+void setHoldMach(void* ref, float val);
+int getMachMode(void* ref);
+int getLogDropped(void* ref);
+float getEnvelopeLimit(void* ref);
+int getFlightPhase(void* ref);
+int getMpcFallbacks(void* ref);
+float getPlantEstimate(void* ref);
+float getGain(void* ref);
+float getFeedForward(void* ref);
 void setAutoSpeed(void* ref, float val);
 int holdSpeedUpHandler(XPLMCommandRef cmd, XPLMCommandPhase phase, void* ref);
 int holdSpeedDownHandler(XPLMCommandRef cmd, XPLMCommandPhase phase, void* ref);
@@ -37,6 +69,33 @@ int autoThrottleToggleHandler(XPLMCommandRef cmd, XPLMCommandPhase phase, void*
 
 int controllerWidgetCb(XPWidgetMessage msg, XPWidgetID widget, intptr_t param1, intptr_t param2);
 void CreateControllerWidget();
+void setupInputs();
+SpeedFilter::Inputs speedFilterInputs();
+void applyFlightPhase(FlightPhase::Phase phase);
+void schedulePoint(float (&point)[OperatingGrid::Axes]);
+void scheduledGains(PIDController& block);
+void effectiveGains(PIDController& block);
+void syncApSpeed(bool crossed);
+void switchSpeedMode();
+void configureShaper();
+void stepHoldSpeed(int direction);
+void startAutoTune();
+void finishAutoTune();
+bool writeTunedGains(const std::string& fileName, const std::string& rule, float Ku, float Tu, const PIDController& gains);
+
+#if IBM
+const std::string PathSeparator = "\\";
+#else
+const std::string PathSeparator = "/";
+#endif
+
+#ifndef _MSC_VER
+// strcpy_s is MSVC only; needed for the Linux headless runtime (see Headless/)
+static void strcpy_s(char* dst, size_t size, const char* src)
+{
+	snprintf(dst, size, "%s", src);
+}
+#endif
 
 const std::string PluginName = "AutoThrottle";
 const std::string Signature = "com.v8judd.AutoThrottle";
@@ -51,11 +110,141 @@ struct globals_t
 	std::string pluginPath{ "" };
 	std::string plane = { "" };
 
-	XPLMDataRef timeRef = nullptr;
 	XPLMDataRef throttleRef = nullptr;
-	XPLMDataRef iasRef = nullptr;
-	XPLMDataRef apSpeedRef = nullptr; // Autopilot set speed
+	XPLMDataRef engineThrottleRef = nullptr; // throttle_ratio[], used with engine sync
+	XPLMDataRef apSpeedRef = nullptr; // Autopilot set speed, kts or Mach
+	XPLMDataRef apIsMachRef = nullptr;
+	XPLMDataRef holdMachRef = nullptr;
+	XPLMDataRef machModeRef = nullptr;
 	XPLMDataRef holdSpeedRef = nullptr;
+	XPLMDataRef logDroppedRef = nullptr;
+	XPLMDataRef envelopeLimitRef = nullptr;
+	XPLMDataRef flightPhaseRef = nullptr;
+	XPLMDataRef mpcFallbacksRef = nullptr;
+	XPLMDataRef plantEstimateRefs[3] = {};	// gain, damping, gain standard deviation
+	XPLMDataRef gainRefs[3] = {};			// Kp, Ki, Kd running
+	XPLMDataRef feedForwardRef = nullptr;
+
+	/// sim inputs, read once per frame by snapshot.read()
+	struct frame_t
+	{
+		float time = 0;	// sim/time/total_running_time_sec
+		float ias = 0;	// sim/cockpit2/gauges/indicators/airspeed_kts_pilot
+		// per engine, only read while engine sync / envelope protection are enabled
+		float throttle[ENGINE_SYNC_MAX_ENGINES] = {};
+		float n1[ENGINE_SYNC_MAX_ENGINES] = {};
+		float torque[ENGINE_SYNC_MAX_ENGINES] = {};
+		float itt[ENGINE_SYNC_MAX_ENGINES] = {};
+		// only read while flight phases are enabled
+		float agl = 0;		// sim/flightmodel/position/y_agl [m]
+		float vs = 0;		// sim/flightmodel/position/vh_ind_fpm
+		int onGround = 0;	// sim/flightmodel/failures/onground_any
+		int gearDown = 0;	// sim/cockpit2/controls/gear_handle_down
+		// read every frame, the log has them; the gain schedule and the trim table look up on them
+		float pressureAltitude = 0;	// sim/flightmodel2/position/pressure_altitude [ft]
+		float weight = 0;			// sim/flightmodel/weight/m_total [kg]
+		// only read with Mach hold / autopilot speed sync
+		float mach = 0;				// sim/flightmodel/misc/machno
+		float apDial = 0;			// sim/cockpit2/autopilot/airspeed_dial_kts_mach
+		int apIsMach = 0;			// sim/cockpit2/autopilot/airspeed_is_mach
+		// only read with the speed filter, SI units as published
+		float tas = 0;				// sim/flightmodel/position/true_airspeed [m/s]
+		float groundspeed = 0;		// sim/flightmodel/position/groundspeed [m/s]
+		float velocity[2] = {};		// sim/flightmodel/position/local_vx, local_vz [m/s]
+		float accel[2] = {};		// sim/flightmodel/position/local_ax, local_az [m/s^2]
+		// only read with the MPC or ADRC engine or the plant estimator, on engaging
+		float lever = 0;			// sim/cockpit2/engine/actuators/throttle_ratio_all
+	} frame;
+	int engines = 0;
+	DataRefSnapshot snapshot;
+
+	/// per-engine trim on top of the speed controller, ini: engine_sync (0 off, 1 N1, 2 torque), sync_kp, sync_ki, sync_authority
+	EngineSync sync;
+	int syncParam = 0;
+	float syncKp = 0;
+	float syncKi = 0;
+	float syncAuthority = 0;
+	float engineThrottle[ENGINE_SYNC_MAX_ENGINES] = {};
+
+	/// dynamic limMax from ITT/torque/N1 redlines, ini: envelope (0/1), envelope_lookahead [s],
+	/// envelope_gain, envelope_tracking [1/s], itt_max [deg C]/torque_max [ft-lb]/n1_max [%] override the sim's redlines
+	EnvelopeLimiter envelope;
+	bool envelopeOn = false;
+	float envelopeLookahead = 0;
+	float envelopeGain = 0;
+	float envelopeTracking = 0;
+	float redlineOverride[EnvelopeLimiter::Count] = {};
+
+	/// gain and limit block per flight phase, ini: phases (0/1), <phase>.kp, .ki, .kd, .tau, .limMin, .limMax,
+	/// .limIntMin, .limIntMax (missing keys take the plain value, retard.limMax defaults to limMin = idle),
+	/// phase_climb_vs [ft/min], phase_takeoff_agl, phase_approach_agl, phase_retard_agl [ft], phase_dwell [s]
+	FlightPhase phase;
+	bool phasesOn = false;
+	PIDController phaseCtrl[FlightPhase::Count] = {};
+
+	/// kp/ki/kd over IAS, pressure altitude and weight, ini: sched_ias, sched_alt, sched_weight (breakpoints),
+	/// sched_kp, sched_ki, sched_kd (IAS fastest); overrides the gains of the phase blocks
+	GainSchedule schedule;
+
+	/// steady lever over IAS, pressure altitude and weight as the PID's feedforward, the PID corrects the residual;
+	/// ini: trim_ias, trim_alt, trim_weight (breakpoints), trim_lever (IAS fastest), learned by identify --trim
+	TrimTable trim;
+
+	/// gain block in use, before scheduling and Mach scaling: the plain gains or the flight phase's block
+	PIDController gains = {};
+
+	/// IAS/Mach hold, ini: mach_hold (0/1), mach_crossover_alt [ft] (0 = no automatic crossover),
+	/// mach_crossover_band [ft], ap_speed_sync (0/1) takes the setpoint and IAS/Mach mode from the autopilot dial
+	MachHold machHold;
+	bool machHoldOn = false;
+	bool apSpeedSync = false;
+	float holdMach = 0.7f;
+
+	/// reference trajectory towards the held speed and setpoint weights, ini: shape_accel [kts/s] (0 = off),
+	/// shape_jerk [kts/s^2], sp_weight_p (b, default 1), sp_weight_d (c, default 0)
+	SetpointShaper shaper;
+	float shapeAccel = 0;
+	float shapeJerk = 0;
+	float weightP = 1;
+	float weightD = 0;
+
+	/// Kalman filtered IAS and IAS rate for the controller, ini: speed_filter (0/1), speed_filter_ias [kts],
+	/// speed_filter_gs [kts], speed_filter_accel [kts/s], speed_filter_jerk [kts/s^2], speed_filter_wind (standard deviations)
+	SpeedFilter speedFilter;
+	bool speedFilterOn = false;
+
+	/// controller engine, ini: controller (0 PID, 1 MPC, 2 ADRC); MPC model mpc_gain [kts/s per lever], mpc_damping [1/s],
+	/// mpc_spool_tau [s]; tuning mpc_horizon, mpc_moves, mpc_step [s], mpc_speed_weight, mpc_move_weight,
+	/// mpc_rate [lever/s], mpc_disturbance_tau [s], mpc_budget [us]; the PID runs alongside and takes over a tick the MPC misses
+	MPC mpc;
+	bool mpcOn = false;
+	int mpcFallbacks = 0;
+
+	/// ADRC engine, ini: adrc_b0 [kts/s^2 per lever] (default mpc_gain / mpc_spool_tau), adrc_bandwidth [rad/s],
+	/// adrc_observer [rad/s]; the PID runs alongside and tracks its output
+	ADRC adrc;
+	bool adrcOn = false;
+
+	/// relay auto-tuner, started from the menu, ini: tune_rule (0 Ziegler-Nichols, 1 Tyreus-Luyben, 2 no overshoot,
+	/// 3 some overshoot), tune_amplitude [lever], tune_hysteresis [kts], tune_cycles, tune_timeout [s]
+	RelayTuner tuner;
+	RelayTuner::Settings tuneSettings;
+	RelayTuner::Rule tuneRule = RelayTuner::SomeOvershoot;
+
+	/// online plant estimate (RLS), ini: estimator (0/1), rls_memory [s], rls_spool_tau [s], rls_gain [kts/s per lever],
+	/// rls_damping [1/s] (start values, default the MPC model), rls_max_variance; published as v8judd/auto_throttle/plant_*
+	PlantEstimator estimator;
+	bool estimatorOn = false;
+
+	/// PID gains retuned from the plant estimate, ini: adaptive (0/1, turns the estimator on), adapt_lambda [s],
+	/// adapt_dead_time [s], adapt_confidence (relative sd of the gain), adapt_rate [1/s], adapt_range (factor on the ini gains)
+	AdaptiveGains adaptive;
+	bool adaptiveOn = false;
+
+	/// dead time taken out of the PID's loop, ini: smith (0/1), smith_dead_time [s]; model smith_gain [kts/s per lever],
+	/// smith_damping [1/s], smith_spool_tau [s] (default the MPC model)
+	SmithPredictor smith;
+	bool smithOn = false;
 
 	XPWidgetID controllerWidget = nullptr;
 	XPWidgetID lblHoldSpeed = nullptr;
@@ -67,17 +256,19 @@ struct globals_t
 
 	bool autoThrEnabled = false;
 	XPLMFlightLoopID fltLoopId = nullptr;
-	std::ofstream log;
+	FlightLog log; // written by its own thread, the flight loop only queues samples
 	int logCnt = 0;
+	bool logBinary = false; // <plane>_logN.atlog instead of .csv, see BinaryLog.h
 	float holdSpeed = 200;
 	float pidT = 0;
+	float pidTimeTolerance = 0; // relative frame time jitter before PID coefficients are recomputed
 	float limMin = 0;
 	float limMax = 0;
 }globals;
 
 bool loadControllerConfig(const std::string& fileName, PIDController& ctrl)
 {
-	std::ifstream fs{ globals.pluginPath + "\\" + fileName };
+	std::ifstream fs{ globals.pluginPath + PathSeparator + fileName };
 	std::string str;
 	std::vector<std::string> lines;
 
@@ -90,27 +281,39 @@ bool loadControllerConfig(const std::string& fileName, PIDController& ctrl)
 		return false;
 	}
 
-	while (!fs.eof())
+	// one key=value per line; a comment line is skipped as a whole, so none of its words can shadow a key
+	while (std::getline(fs, str))
 	{
-		fs >> str;
-		if (str.empty()) // filter empty lines
+		auto first = str.find_first_not_of(" \t\r");
+		if (std::string::npos == first) // filter empty lines
 			continue;
+		str = str.substr(first, str.find_last_not_of(" \t\r") + 1 - first);
 
 		if (str.substr(0, 2) == "//" || str.substr(0, 1) == "#") // filter comments
 			continue;
+		auto eq = str.find('=');
+		if (std::string::npos == eq || 0 == eq) // no key
+			continue;
 
 		lines.push_back(str);
 	}
 
 	std::map<std::string, float> cfg;
+	std::map<std::string, std::vector<float>> lists; // comma separated, e.g. sched_ias=120,150,180
 
 	// parse values
 	for (auto& l : lines)
 	{
 		auto pos = l.find('=');
-		auto key = l.substr(0, pos);
+		auto key = l.substr(0, l.find_last_not_of(" \t", pos - 1) + 1);
 		auto val = l.substr(pos + 1);
 		cfg.emplace(std::make_pair(key, atof(val.c_str())));
+
+		auto& list = lists[key];
+		std::istringstream vs{ val };
+		std::string item;
+		while (std::getline(vs, item, ','))
+			list.push_back(static_cast<float>(atof(item.c_str())));
 	}
 	ctrl.Kp = cfg["kp"];
 	ctrl.Ki = cfg["ki"];
@@ -120,12 +323,258 @@ bool loadControllerConfig(const std::string& fileName, PIDController& ctrl)
 	ctrl.limMax = cfg["limMax"];
 	ctrl.limMinInt = cfg["limIntMin"];
 	ctrl.limMaxInt = cfg["limIntMax"];
+	ctrl.denormalMode = static_cast<int>(cfg["denormal_mode"]);
 	globals.holdSpeed = cfg["setpoint"];
 	globals.pidT = cfg["pid_time"];
+	globals.pidTimeTolerance = cfg["pid_time_tolerance"];
+	globals.logBinary = cfg["log_binary"] != 0;
+	globals.syncParam = static_cast<int>(cfg["engine_sync"]);
+	globals.syncKp = cfg["sync_kp"];
+	globals.syncKi = cfg["sync_ki"];
+	globals.syncAuthority = cfg["sync_authority"];
+	globals.envelopeOn = cfg["envelope"] != 0;
+	globals.envelopeLookahead = cfg.count("envelope_lookahead") ? cfg["envelope_lookahead"] : 2.0f;
+	globals.envelopeGain = cfg.count("envelope_gain") ? cfg["envelope_gain"] : 0.2f;
+	globals.envelopeTracking = cfg["envelope_tracking"];
+	globals.redlineOverride[EnvelopeLimiter::ITT] = cfg["itt_max"];
+	globals.redlineOverride[EnvelopeLimiter::Torque] = cfg["torque_max"];
+	globals.redlineOverride[EnvelopeLimiter::N1] = cfg["n1_max"];
 	globals.limMax = cfg["limMax"];
 	globals.limMin = cfg["limMin"];
 	ctrl.T = globals.pidT;
 
+	globals.machHoldOn = cfg["mach_hold"] != 0;
+	globals.apSpeedSync = cfg["ap_speed_sync"] != 0;
+	globals.machHold.configure(globals.machHoldOn ? cfg["mach_crossover_alt"] : 0.0f,
+		cfg.count("mach_crossover_band") ? cfg["mach_crossover_band"] : 500.0f);
+	globals.gains = ctrl;
+
+	globals.shapeAccel = cfg["shape_accel"];
+	globals.shapeJerk = cfg["shape_jerk"];
+	configureShaper();
+	globals.weightP = cfg.count("sp_weight_p") ? cfg["sp_weight_p"] : 1.0f;
+	globals.weightD = cfg["sp_weight_d"];
+
+	globals.speedFilterOn = cfg["speed_filter"] != 0;
+	SpeedFilter::Noise noise;
+	if (cfg.count("speed_filter_ias"))
+		noise.ias = cfg["speed_filter_ias"];
+	if (cfg.count("speed_filter_gs"))
+		noise.groundspeed = cfg["speed_filter_gs"];
+	if (cfg.count("speed_filter_accel"))
+		noise.accel = cfg["speed_filter_accel"];
+	if (cfg.count("speed_filter_jerk"))
+		noise.jerk = cfg["speed_filter_jerk"];
+	if (cfg.count("speed_filter_wind"))
+		noise.wind = cfg["speed_filter_wind"];
+	globals.speedFilter.configure(noise);
+
+	if (cfg.count("tune_rule"))
+	{
+		int rule = static_cast<int>(cfg["tune_rule"]);
+		globals.tuneRule = rule >= 0 && rule < RelayTuner::Rules ? static_cast<RelayTuner::Rule>(rule) : RelayTuner::SomeOvershoot;
+	}
+	if (cfg.count("tune_amplitude"))
+		globals.tuneSettings.amplitude = cfg["tune_amplitude"];
+	if (cfg.count("tune_hysteresis"))
+		globals.tuneSettings.hysteresis = cfg["tune_hysteresis"];
+	if (cfg.count("tune_cycles"))
+		globals.tuneSettings.cycles = static_cast<int>(cfg["tune_cycles"]);
+	if (cfg.count("tune_timeout"))
+		globals.tuneSettings.timeout = cfg["tune_timeout"];
+
+	int engine = static_cast<int>(cfg["controller"]);
+	globals.mpcOn = 1 == engine;
+	if (globals.mpcOn)
+	{
+		MPC::Model model;
+		MPC::Tuning tuning;
+		if (cfg.count("mpc_gain"))
+			model.gain = cfg["mpc_gain"];
+		if (cfg.count("mpc_damping"))
+			model.damping = cfg["mpc_damping"];
+		if (cfg.count("mpc_spool_tau"))
+			model.spoolTau = cfg["mpc_spool_tau"];
+		if (cfg.count("mpc_horizon"))
+			tuning.horizon = static_cast<int>(cfg["mpc_horizon"]);
+		if (cfg.count("mpc_moves"))
+			tuning.moves = static_cast<int>(cfg["mpc_moves"]);
+		if (cfg.count("mpc_step"))
+			tuning.step = cfg["mpc_step"];
+		if (cfg.count("mpc_speed_weight"))
+			tuning.speedWeight = cfg["mpc_speed_weight"];
+		if (cfg.count("mpc_move_weight"))
+			tuning.moveWeight = cfg["mpc_move_weight"];
+		if (cfg.count("mpc_rate"))
+			tuning.rateLimit = cfg["mpc_rate"];
+		if (cfg.count("mpc_disturbance_tau"))
+			tuning.disturbanceTau = cfg["mpc_disturbance_tau"];
+		if (cfg.count("mpc_budget"))
+			tuning.budget = cfg["mpc_budget"] * 1e-6f;
+		if (!globals.mpc.configure(model, tuning))
+		{
+			std::ostringstream ss;
+			ss << "[TK] MPC settings in " << fileName << " not usable, running the PID" << std::endl;
+			XPLMDebugString(ss.str().c_str());
+			globals.mpcOn = false;
+		}
+	}
+
+	globals.adrcOn = 2 == engine;
+	if (globals.adrcOn)
+	{
+		ADRC::Settings adrc;
+		if (cfg.count("mpc_gain") && cfg["mpc_spool_tau"] > 0)
+			adrc.b0 = cfg["mpc_gain"] / cfg["mpc_spool_tau"];
+		if (cfg.count("adrc_b0"))
+			adrc.b0 = cfg["adrc_b0"];
+		if (cfg.count("adrc_bandwidth"))
+			adrc.bandwidth = cfg["adrc_bandwidth"];
+		if (cfg.count("adrc_observer"))
+			adrc.observer = cfg["adrc_observer"];
+		if (!globals.adrc.configure(adrc))
+		{
+			std::ostringstream ss;
+			ss << "[TK] ADRC settings in " << fileName << " not usable, running the PID" << std::endl;
+			XPLMDebugString(ss.str().c_str());
+			globals.adrcOn = false;
+		}
+	}
+
+	// the estimator starts from the MPC model where there is one
+	globals.estimatorOn = cfg["estimator"] != 0;
+	PlantEstimator::Settings estimate;
+	if (cfg.count("mpc_gain"))
+		estimate.gain = cfg["mpc_gain"];
+	if (cfg.count("mpc_damping"))
+		estimate.damping = cfg["mpc_damping"];
+	if (cfg.count("mpc_spool_tau"))
+		estimate.spoolTau = cfg["mpc_spool_tau"];
+	if (cfg.count("rls_gain"))
+		estimate.gain = cfg["rls_gain"];
+	if (cfg.count("rls_damping"))
+		estimate.damping = cfg["rls_damping"];
+	if (cfg.count("rls_spool_tau"))
+		estimate.spoolTau = cfg["rls_spool_tau"];
+	if (cfg.count("rls_memory"))
+		estimate.memory = cfg["rls_memory"];
+	if (cfg.count("rls_max_variance"))
+		estimate.maxVariance = cfg["rls_max_variance"];
+	globals.estimator.configure(estimate);
+
+	globals.smithOn = cfg["smith"] != 0;
+	if (globals.smithOn)
+	{
+		SmithPredictor::Model model;
+		if (cfg.count("mpc_gain"))
+			model.gain = cfg["mpc_gain"];
+		if (cfg.count("mpc_damping"))
+			model.damping = cfg["mpc_damping"];
+		if (cfg.count("mpc_spool_tau"))
+			model.spoolTau = cfg["mpc_spool_tau"];
+		if (cfg.count("smith_gain"))
+			model.gain = cfg["smith_gain"];
+		if (cfg.count("smith_damping"))
+			model.damping = cfg["smith_damping"];
+		if (cfg.count("smith_spool_tau"))
+			model.spoolTau = cfg["smith_spool_tau"];
+		if (cfg.count("smith_dead_time"))
+			model.deadTime = cfg["smith_dead_time"];
+		if (!globals.smith.configure(model, globals.pidT))
+		{
+			std::ostringstream ss;
+			ss << "[TK] Smith predictor settings in " << fileName << " not usable, the PID runs on the measured speed" << std::endl;
+			XPLMDebugString(ss.str().c_str());
+			globals.smithOn = false;
+		}
+	}
+
+	globals.adaptiveOn = cfg["adaptive"] != 0;
+	if (globals.adaptiveOn)
+	{
+		AdaptiveGains::Settings adapt;
+		if (cfg.count("adapt_lambda"))
+			adapt.lambda = cfg["adapt_lambda"];
+		if (cfg.count("adapt_dead_time"))
+			adapt.deadTime = cfg["adapt_dead_time"];
+		if (cfg.count("adapt_confidence"))
+			adapt.confidence = cfg["adapt_confidence"];
+		if (cfg.count("adapt_rate"))
+			adapt.rate = cfg["adapt_rate"];
+		if (cfg.count("adapt_range"))
+			adapt.range = cfg["adapt_range"];
+		if (globals.adaptive.configure(adapt))
+			globals.estimatorOn = true;
+		else
+		{
+			std::ostringstream ss;
+			ss << "[TK] adaptive settings in " << fileName << " not usable, running the ini gains" << std::endl;
+			XPLMDebugString(ss.str().c_str());
+			globals.adaptiveOn = false;
+		}
+	} else
+		globals.adaptive.reset();
+
+	globals.phasesOn = cfg["phases"] != 0;
+	FlightPhase::Thresholds thresholds;
+	if (cfg.count("phase_climb_vs"))
+		thresholds.climbVs = cfg["phase_climb_vs"];
+	if (cfg.count("phase_takeoff_agl"))
+		thresholds.takeoffAgl = cfg["phase_takeoff_agl"];
+	if (cfg.count("phase_approach_agl"))
+		thresholds.approachAgl = cfg["phase_approach_agl"];
+	if (cfg.count("phase_retard_agl"))
+		thresholds.retardAgl = cfg["phase_retard_agl"];
+	if (cfg.count("phase_dwell"))
+		thresholds.dwell = cfg["phase_dwell"];
+	globals.phase.configure(thresholds);
+
+	// e.g. approach.kp, keys a phase does not set keep the plain value
+	for (int p = 0; p < FlightPhase::Count; ++p)
+	{
+		std::string prefix = std::string{ FlightPhase::name(static_cast<FlightPhase::Phase>(p)) } + ".";
+		auto value = [&](const char* key, float plain) {
+			auto it = cfg.find(prefix + key);
+			return it != cfg.end() ? it->second : plain;
+		};
+
+		auto& block = globals.phaseCtrl[p];
+		block = ctrl;
+		block.Kp = value("kp", ctrl.Kp);
+		block.Ki = value("ki", ctrl.Ki);
+		block.Kd = value("kd", ctrl.Kd);
+		block.tau = value("tau", ctrl.tau);
+		block.limMin = value("limMin", ctrl.limMin);
+		block.limMax = value("limMax", FlightPhase::Retard == p ? ctrl.limMin : ctrl.limMax);
+		block.limMinInt = value("limIntMin", ctrl.limMinInt);
+		block.limMaxInt = value("limIntMax", ctrl.limMaxInt);
+	}
+
+	globals.schedule.clear();
+	if (lists.count("sched_kp") || lists.count("sched_ki") || lists.count("sched_kd"))
+	{
+		std::vector<float> breakpoints[OperatingGrid::Axes] = { lists["sched_ias"], lists["sched_alt"], lists["sched_weight"] };
+		std::vector<float> gains[GainSchedule::Gains] = { lists["sched_kp"], lists["sched_ki"], lists["sched_kd"] };
+		if (!globals.schedule.configure(breakpoints, gains))
+		{
+			std::ostringstream ss;
+			ss << "[TK] gain schedule in " << fileName << " ignored: " << globals.schedule.error() << std::endl;
+			XPLMDebugString(ss.str().c_str());
+		}
+	}
+
+	globals.trim.clear();
+	if (lists.count("trim_lever"))
+	{
+		std::vector<float> breakpoints[OperatingGrid::Axes] = { lists["trim_ias"], lists["trim_alt"], lists["trim_weight"] };
+		if (!globals.trim.configure(breakpoints, lists["trim_lever"]))
+		{
+			std::ostringstream ss;
+			ss << "[TK] trim table in " << fileName << " ignored: " << globals.trim.error() << std::endl;
+			XPLMDebugString(ss.str().c_str());
+		}
+	}
+
 	return true;
 }
 
@@ -137,9 +586,19 @@ XPLMCreateFlightLoop_t controllerLoop{
 		static float lastTime = 0;
 		static float t = 0;
 		static float lastLogTime = 0;
+		static float lastSpeed = 0;	// kts, for the speed rate without the speed filter
 
-		std::string lv = std::to_string(globals.holdSpeed);
-		XPSetWidgetDescriptor(globals.lblHoldSpeed, lv.c_str());
+		static XPWidgetID shownLabel = nullptr;
+		static float shownHoldSpeed = 0;
+
+		// only touch the label when there is one and its value changed
+		if (nullptr != globals.lblHoldSpeed && (shownLabel != globals.lblHoldSpeed || shownHoldSpeed != globals.holdSpeed))
+		{
+			std::string lv = std::to_string(globals.holdSpeed);
+			XPSetWidgetDescriptor(globals.lblHoldSpeed, lv.c_str());
+			shownLabel = globals.lblHoldSpeed;
+			shownHoldSpeed = globals.holdSpeed;
+		}
 
 		if (!globals.autoThrEnabled)
 		{
@@ -148,48 +607,215 @@ XPLMCreateFlightLoop_t controllerLoop{
 			return globals.pidT;
 		}
 
+		globals.snapshot.read();
+		auto& frame = globals.frame;
+
 		if (0 == lastTime)
 		{
-			if (globals.log.is_open())
+			if (globals.log.isOpen())
+				globals.log.beginRun(globals.holdSpeed);
+			if (globals.sync.enabled())
+				globals.sync.start(frame.throttle);
+			globals.envelope.reset();
+			if (globals.phasesOn)
+				applyFlightPhase(globals.phase.reset({ frame.agl * 3.28084f, frame.vs, frame.onGround != 0, frame.gearDown != 0 }));
+			if (globals.machHoldOn || globals.apSpeedSync)
 			{
-				globals.log << "setpoint: " << globals.holdSpeed << std::endl;
-				globals.log << "t;error;speed;out;setpoint;Int;Diff" << std::endl;
+				// the autopilot's mode, else IAS; the first update applies the crossover
+				bool wasMach = globals.machHold.machMode();
+				bool mach = globals.machHoldOn && globals.apSpeedSync && frame.apIsMach != 0;
+				globals.machHold.reset(mach, frame.ias, frame.mach);
+				if (mach != wasMach)
+					switchSpeedMode();
 			}
-
-			lastTime = XPLMGetDataf(globals.timeRef);
+			if (globals.speedFilterOn)
+				globals.speedFilter.reset(speedFilterInputs());
+			// engaging: the reference starts at the current speed
+			configureShaper();
+			globals.shaper.reset(globals.machHold.machMode() ? frame.mach : frame.ias);
+			if (globals.mpcOn)
+			{
+				// both engines continue from the lever as it is
+				globals.mpc.reset(frame.ias, frame.lever);
+				globals.pid->trackOutput(frame.lever);
+			}
+			if (globals.adrcOn)
+			{
+				globals.adrc.reset(frame.ias, frame.lever);
+				globals.pid->trackOutput(frame.lever);
+			}
+			if (globals.estimatorOn)
+				globals.estimator.reset(frame.ias, frame.lever);
+			if (globals.smithOn)
+				globals.smith.reset();
+			// the estimate starts over, so do the gains
+			if (globals.adaptiveOn)
+				globals.adaptive.reset();
+			lastSpeed = frame.ias;
+
+			lastTime = frame.time;
 			t = 0;
 		}
-		auto deltaT = XPLMGetDataf(globals.timeRef) - lastTime;
+		auto deltaT = frame.time - lastTime;
 		if (deltaT <= 0.000001f)
 			return globals.pidT;
 
 		globals.pid->setTime(deltaT);
-		auto ias = XPLMGetDataf(globals.iasRef);
+		auto ias = globals.speedFilterOn ? globals.speedFilter.update(speedFilterInputs(), deltaT) : frame.ias;
 
 		auto prevErr = globals.pid->data().prevError;
-		globals.pid->setMaxLimit(globals.limMax);
+		if (globals.phasesOn)
+		{
+			auto phase = globals.phase.update({ frame.agl * 3.28084f, frame.vs, frame.onGround != 0, frame.gearDown != 0 }, deltaT);
+			if (globals.phase.changed())
+				applyFlightPhase(phase);
+		}
+
+		// held speed: IAS or Mach, setpoint from the autopilot dial when synced
+		if (globals.machHoldOn || globals.apSpeedSync)
+		{
+			bool wasMach = globals.machHold.machMode();
+			bool crossed = globals.machHold.update(frame.pressureAltitude, ias, frame.mach, deltaT);
+			if (globals.apSpeedSync)
+				syncApSpeed(crossed);
+			if (globals.machHold.machMode() != wasMach)
+				switchSpeedMode();
+		}
+		bool mach = globals.machHold.machMode();
+
+		if (globals.adaptiveOn)
+		{
+			// factors against the gains that would run without adaptation, in knots
+			PIDController base = globals.gains;
+			scheduledGains(base);
+			auto& estimator = globals.estimator;
+			globals.adaptive.update(base, estimator.estimate(PlantEstimator::Gain), estimator.deviation(PlantEstimator::Gain),
+				estimator.estimate(PlantEstimator::Damping), estimator.configuration().spoolTau, deltaT);
+		}
+		if (globals.schedule.enabled() || globals.machHoldOn || globals.adaptiveOn)
+		{
+			PIDController block = globals.gains;
+			effectiveGains(block);
+			if (globals.adaptiveOn)
+			{
+				// the integrator takes up the change of the P and D terms; limits follow below
+				globals.pid->switchGains(block);
+			} else
+			{
+				auto& data = globals.pid->data();
+				data.Kp = block.Kp;
+				data.Ki = block.Ki;
+				data.Kd = block.Kd;
+			}
+		}
+
+		float limMax = globals.limMax;
+		if (globals.envelope.enabled())
+		{
+			// the hottest engine limits the collective
+			float values[EnvelopeLimiter::Count];
+			values[EnvelopeLimiter::ITT] = EnvelopeLimiter::highest(frame.itt, globals.engines);
+			values[EnvelopeLimiter::Torque] = EnvelopeLimiter::highest(frame.torque, globals.engines);
+			values[EnvelopeLimiter::N1] = EnvelopeLimiter::highest(frame.n1, globals.engines);
+
+			float limit = globals.envelope.update(values, globals.pid->data().out, deltaT);
+			if (limit < limMax)
+				limMax = limit > globals.limMin ? limit : globals.limMin;
+		}
+
+		globals.pid->setMaxLimit(limMax);
 		globals.pid->setMinLimit(globals.limMin);
 
-			auto err = globals.pid->update(globals.holdSpeed, ias);
+			float reference = mach ? globals.holdMach : globals.holdSpeed;
+			if (globals.shaper.enabled())
+				reference = globals.shaper.update(reference, deltaT);
+			if (globals.trim.enabled())
+			{
+				// steady lever for the speed asked for, at this altitude and weight
+				float point[OperatingGrid::Axes] = { mach ? globals.machHold.toIas(reference) : reference, frame.pressureAltitude, frame.weight };
+				globals.pid->setFeedForward(globals.trim.lever(point));
+			}
+			float applied = globals.pid->data().out;	// over the last frame
+			// the PID sees the speed the levers applied so far will give, in knots
+			float predicted = 0;
+			float predictedRate = 0;
+			if (globals.smithOn)
+			{
+				globals.smith.update(applied, deltaT);
+				predicted = globals.smith.correction();
+				predictedRate = globals.smith.rateCorrection();
+			}
+			float err;
+			if (globals.speedFilterOn)
+			{
+				// the filter runs in knots, Mach at the hold's ratio
+				float speed = ias + predicted;
+				float rate = globals.speedFilter.rate() + predictedRate;
+				if (mach)
+					err = globals.pid->update(reference, globals.machHold.toMach(speed), globals.machHold.toMach(rate));
+				else
+					err = globals.pid->update(reference, speed, rate);
+			} else
+				err = globals.pid->update(reference, mach ? frame.mach + globals.machHold.toMach(predicted) : ias + predicted);
+
+			float out = globals.pid->data().out;
+			// knots per second, the MPC's model and the estimate are in knots
+			float rate = globals.speedFilterOn ? globals.speedFilter.rate() : (ias - lastSpeed) / deltaT;
+			lastSpeed = ias;
+			if (globals.estimatorOn)
+				globals.estimator.update(ias, rate, applied, deltaT);
+			if (globals.mpcOn)
+			{
+				float target = mach ? globals.machHold.toIas(reference) : reference;
+				if (globals.mpc.update(target, ias, rate, applied, globals.limMin, limMax, deltaT))
+				{
+					out = globals.mpc.output();
+					globals.pid->trackOutput(out);
+				} else
+					++globals.mpcFallbacks;
+			}
+			if (globals.adrcOn)
+			{
+				float target = mach ? globals.machHold.toIas(reference) : reference;
+				if (globals.speedFilterOn)
+					out = globals.adrc.update(target, ias, rate, applied, globals.limMin, limMax, deltaT);
+				else
+					out = globals.adrc.update(target, ias, applied, globals.limMin, limMax, deltaT);
+				globals.pid->trackOutput(out);
+			}
 
-			XPLMSetDataf(globals.throttleRef, globals.pid->data().out);
+			if (globals.tuner.running())
+			{
+				// the relay has the throttle, the PID follows it
+				out = globals.tuner.update(ias, deltaT);
+				out = out > limMax ? limMax : (out < globals.limMin ? globals.limMin : out);
+				globals.pid->trackOutput(out);
+				if (!globals.tuner.running())
+					finishAutoTune();
+			}
 
-			lastTime = XPLMGetDataf(globals.timeRef);
+			if (globals.sync.enabled())
+			{
+				// one write for all levers
+				globals.sync.update(out, frame.n1, frame.torque, globals.engineThrottle, deltaT);
+				XPLMSetDatavf(globals.engineThrottleRef, globals.engineThrottle, 0, globals.sync.engines());
+			} else
+				XPLMSetDataf(globals.throttleRef, out);
+
+			lastTime = frame.time;
 			t += deltaT;
 			if (0 == lastLogTime)
 				lastLogTime = t;
 			if (t - lastLogTime > 0.1f)
 			{
 				lastLogTime = t;
-				if (globals.log.is_open())
+				if (globals.log.isOpen())
 				{
-					globals.log << t << ";";
-					globals.log << err << ";";
-					globals.log << ias << ";";
-					globals.log << globals.pid->data().out << ";";
-					globals.log << globals.holdSpeed << ";";
-					globals.log << globals.pid->data().integrator << ";";
-					globals.log << globals.pid->data().differentiator << std::endl;
+					auto& data = globals.pid->data();
+					// the log stays in knots, Mach setpoint and error at the current ratio; the setpoint is the reference tracked
+					float setpoint = mach ? globals.machHold.toIas(reference) : reference;
+					float error = mach ? globals.machHold.toIas(err) : err;
+					globals.log.push({ t, error, ias, data.out, setpoint, data.integrator, data.differentiator, frame.pressureAltitude, frame.weight });
 				}
 			}
 			return globals.pidT;
@@ -210,14 +836,29 @@ PLUGIN_API int XPluginStart(char* name, char* sig, char* desc)
 	XPLMAppendMenuItem(autoThrottleMenuID, "Enable", (void*)"enable", 0);
 	XPLMAppendMenuItem(autoThrottleMenuID, "Disable", (void*)"disable", 0);
 	XPLMAppendMenuItem(autoThrottleMenuID, "Reload Config", (void*)"reload", 0);
+	XPLMAppendMenuItem(autoThrottleMenuID, "Auto Tune", (void*)"tune", 0);
 	XPLMAppendMenuSeparator(autoThrottleMenuID);
 	XPLMAppendMenuItem(autoThrottleMenuID, "Show Config", (void*)"config", 0);
 
-	globals.timeRef = XPLMFindDataRef("sim/time/total_running_time_sec");
+	setupInputs();
 	globals.throttleRef = XPLMFindDataRef("sim/cockpit2/engine/actuators/throttle_ratio_all");
-	globals.iasRef = XPLMFindDataRef("sim/cockpit2/gauges/indicators/airspeed_kts_pilot");
-	globals.apSpeedRef = XPLMFindDataRef("sim/cockpit2/autopilot/airspeed_dial_kts");
+	globals.engineThrottleRef = XPLMFindDataRef("sim/cockpit2/engine/actuators/throttle_ratio");
+	globals.apSpeedRef = XPLMFindDataRef("sim/cockpit2/autopilot/airspeed_dial_kts_mach");
+	globals.apIsMachRef = XPLMFindDataRef("sim/cockpit2/autopilot/airspeed_is_mach");
+	globals.holdMachRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/hold_mach", xplmType_Float, true, nullptr, nullptr, getHoldMach, setHoldMach, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	globals.machModeRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/mach_mode", xplmType_Int, false, getMachMode, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
 	globals.holdSpeedRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/hold_speed", xplmType_Float, true, nullptr, nullptr, getAutoSpeed, setAutoSpeed, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	globals.flightPhaseRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/flight_phase", xplmType_Int, false, getFlightPhase, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	globals.mpcFallbacksRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/mpc_fallbacks", xplmType_Int, false, getMpcFallbacks, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	const char* plantEstimateNames[3] = { "v8judd/auto_throttle/plant_gain", "v8judd/auto_throttle/plant_damping", "v8judd/auto_throttle/plant_gain_sd" };
+	for (int i = 0; i < 3; ++i)
+		globals.plantEstimateRefs[i] = XPLMRegisterDataAccessor(plantEstimateNames[i], xplmType_Float, false, nullptr, nullptr, getPlantEstimate, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, reinterpret_cast<void*>(static_cast<intptr_t>(i)), nullptr);
+	const char* gainNames[3] = { "v8judd/auto_throttle/kp", "v8judd/auto_throttle/ki", "v8judd/auto_throttle/kd" };
+	for (int i = 0; i < 3; ++i)
+		globals.gainRefs[i] = XPLMRegisterDataAccessor(gainNames[i], xplmType_Float, false, nullptr, nullptr, getGain, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, reinterpret_cast<void*>(static_cast<intptr_t>(i)), nullptr);
+	globals.feedForwardRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/feedforward", xplmType_Float, false, nullptr, nullptr, getFeedForward, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	globals.envelopeLimitRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/envelope_limit", xplmType_Float, false, nullptr, nullptr, getEnvelopeLimit, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+	globals.logDroppedRef = XPLMRegisterDataAccessor("v8judd/auto_throttle/log_dropped", xplmType_Int, false, getLogDropped, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
 	globals.holdSpeedUpCmd = XPLMCreateCommand("v8judd/auto_throttle/hold_speed_up", "Hold speed up");
 	globals.holdSpeedDownCmd = XPLMCreateCommand("v8judd/auto_throttle/hold_speed_down", "Hold speed down");
 	globals.autoThrottleToggleCmd = XPLMCreateCommand("v8judd/auto_throttle/ATtoggle", "AutoThrottle toggle");
@@ -229,7 +870,7 @@ PLUGIN_API int XPluginStart(char* name, char* sig, char* desc)
 	char filePath[512] = { 0 };
 	XPLMGetPluginInfo(XPLMGetMyID(), nullptr, filePath, nullptr, nullptr);
 	std::string tmp{ filePath };
-	auto pos = tmp.find_last_of('\\');
+	auto pos = tmp.find_last_of("\\/");
 	globals.pluginPath = tmp.substr(0, pos);
 
 	controllerLoop.refcon = nullptr;
@@ -248,6 +889,7 @@ PLUGIN_API void XPluginStop()
 		globals.controllerWidget = nullptr;
 	}
 	XPLMDestroyMenu(autoThrottleMenuID);
+	globals.log.shutdown();
 
 	//delete globals.pid;
 }
@@ -271,7 +913,7 @@ PLUGIN_API void XPluginReceiveMessage(XPLMPluginID from, int msg, void* param)
 	switch (msg)
 	{
 		case XPLM_MSG_PLANE_LOADED:
-			if (reinterpret_cast<int>(param) == 0)
+			if (reinterpret_cast<intptr_t>(param) == 0)
 			{
 				char file[256] = { 0 }, path[512] = { 0 };
 
@@ -293,6 +935,10 @@ PLUGIN_API void XPluginReceiveMessage(XPLMPluginID from, int msg, void* param)
 
 				// re-initialize new pointer to PID 
 				globals.pid.reset(new PID{ ctrl });
+				globals.pid->setTimeTolerance(globals.pidTimeTolerance);
+				globals.pid->setTrackingGain(globals.envelopeTracking);
+				globals.pid->setSetpointWeights(globals.weightP, globals.weightD);
+				setupInputs();
 
 				if (globals.plane.compare("Cessna_CitationX") == 0)
 					XPLMScheduleFlightLoop(globals.fltLoopId, globals.pidT, 0);
@@ -308,46 +954,370 @@ PLUGIN_API void XPluginReceiveMessage(XPLMPluginID from, int msg, void* param)
 	}
 }
 
-void enableAutoThrottle()
+/// (re)builds the per-frame input snapshot, per-engine arrays only when engine sync or envelope protection use them
+void setupInputs()
 {
-	// NEW: start new log when auto throttle enabled
-	if (globals.log.is_open())
+	auto& frame = globals.frame;
+	auto& snapshot = globals.snapshot;
+
+	int engines = 0;
+	if (auto enginesRef = XPLMFindDataRef("sim/aircraft/engine/acf_num_engines"))
+		engines = XPLMGetDatai(enginesRef);
+	globals.engines = engines < ENGINE_SYNC_MAX_ENGINES ? engines : ENGINE_SYNC_MAX_ENGINES;
+	globals.sync.configure(engines, static_cast<EngineSync::Parameter>(globals.syncParam), globals.syncKp, globals.syncKi, globals.syncAuthority);
+
+	// redlines are static per aircraft, read once here
+	float redlines[EnvelopeLimiter::Count] = {};
+	if (globals.envelopeOn)
 	{
-		globals.log.flush();
-		globals.log.close();
+		const char* redlineRefs[EnvelopeLimiter::Count] = { "sim/aircraft/limits/red_hi_ITT", "sim/aircraft/limits/red_hi_TRQ", "sim/aircraft/limits/red_hi_N1" };
+		for (int p = 0; p < EnvelopeLimiter::Count; ++p)
+		{
+			auto ref = XPLMFindDataRef(redlineRefs[p]);
+			redlines[p] = globals.redlineOverride[p] > 0 ? globals.redlineOverride[p] : (ref ? XPLMGetDataf(ref) : 0.0f);
+		}
+		// the torque redline (and torque_max) is in ft-lb as Plane Maker gives it, the indicator in N m
+		redlines[EnvelopeLimiter::Torque] *= 1.3558179f;
 	}
+	globals.envelope.configure(redlines, globals.envelopeLookahead, globals.envelopeGain);
 
-	globals.log.open(globals.pluginPath + "\\" + globals.plane + "_log" + std::to_string(globals.logCnt) + ".csv");
-	++globals.logCnt;
+	snapshot.clear();
+	snapshot.addFloat("sim/time/total_running_time_sec", &frame.time);
+	snapshot.addFloat("sim/cockpit2/gauges/indicators/airspeed_kts_pilot", &frame.ias);
+
+	// one XPLMGetDatavf each
+	if (globals.sync.enabled())
+		snapshot.addFloatArray("sim/cockpit2/engine/actuators/throttle_ratio", frame.throttle, globals.engines);
+	if (globals.sync.enabled() || globals.envelope.enabled())
+	{
+		snapshot.addFloatArray("sim/flightmodel/engine/ENGN_N1_", frame.n1, globals.engines);
+		snapshot.addFloatArray("sim/cockpit2/engine/indicators/torque_n_mtr", frame.torque, globals.engines);
+	}
+	if (globals.envelope.enabled())
+		snapshot.addFloatArray("sim/cockpit2/engine/indicators/ITT_deg_C", frame.itt, globals.engines);
+	if (globals.phasesOn)
+	{
+		snapshot.addFloat("sim/flightmodel/position/y_agl", &frame.agl);
+		snapshot.addFloat("sim/flightmodel/position/vh_ind_fpm", &frame.vs);
+		snapshot.addInt("sim/flightmodel/failures/onground_any", &frame.onGround);
+		snapshot.addInt("sim/cockpit2/controls/gear_handle_down", &frame.gearDown);
+	}
+	snapshot.addFloat("sim/flightmodel2/position/pressure_altitude", &frame.pressureAltitude);
+	snapshot.addFloat("sim/flightmodel/weight/m_total", &frame.weight);
+	if (globals.machHoldOn || globals.apSpeedSync)
+		snapshot.addFloat("sim/flightmodel/misc/machno", &frame.mach);
+	if (globals.apSpeedSync)
+	{
+		snapshot.addFloat("sim/cockpit2/autopilot/airspeed_dial_kts_mach", &frame.apDial);
+		snapshot.addInt("sim/cockpit2/autopilot/airspeed_is_mach", &frame.apIsMach);
+	}
+	if (globals.mpcOn || globals.adrcOn || globals.estimatorOn)
+		snapshot.addFloat("sim/cockpit2/engine/actuators/throttle_ratio_all", &frame.lever);
+	if (globals.speedFilterOn)
+	{
+		snapshot.addFloat("sim/flightmodel/position/true_airspeed", &frame.tas);
+		snapshot.addFloat("sim/flightmodel/position/groundspeed", &frame.groundspeed);
+		snapshot.addFloat("sim/flightmodel/position/local_vx", &frame.velocity[0]);
+		snapshot.addFloat("sim/flightmodel/position/local_vz", &frame.velocity[1]);
+		snapshot.addFloat("sim/flightmodel/position/local_ax", &frame.accel[0]);
+		snapshot.addFloat("sim/flightmodel/position/local_az", &frame.accel[1]);
+	}
+}
+
+/// speed filter inputs from this frame, in knots
+SpeedFilter::Inputs speedFilterInputs()
+{
+	const float KtsPerMs = 1.943844f;
+	auto& frame = globals.frame;
+
+	// the horizontal acceleration along the ground track
+	float accel = 0;
+	if (frame.groundspeed > 0)
+		accel = (frame.accel[0] * frame.velocity[0] + frame.accel[1] * frame.velocity[1]) / frame.groundspeed;
+	return { frame.ias, frame.tas * KtsPerMs, frame.groundspeed * KtsPerMs, accel * KtsPerMs };
+}
+
+/// operating point of the gain schedule from this frame's inputs
+void schedulePoint(float (&point)[OperatingGrid::Axes])
+{
+	point[OperatingGrid::Ias] = globals.frame.ias;
+	point[OperatingGrid::Altitude] = globals.frame.pressureAltitude;
+	point[OperatingGrid::Weight] = globals.frame.weight;
+}
+
+/// the block's gains at this operating point if the schedule is on, in knots
+void scheduledGains(PIDController& block)
+{
+	if (globals.schedule.enabled())
+	{
+		float point[OperatingGrid::Axes];
+		schedulePoint(point);
+		globals.schedule.apply(block, point);
+	}
+}
+
+/// gains that run for the block: scheduled, adapted to the plant estimate, then scaled to the speed unit held (kts or Mach)
+void effectiveGains(PIDController& block)
+{
+	scheduledGains(block);
+	if (globals.adaptiveOn)
+		globals.adaptive.apply(block);
+	globals.machHold.scaleGains(block);
+}
+
+/// bumpless switch to the phase's gains and limits, the integrator takes over the current output
+void applyFlightPhase(FlightPhase::Phase phase)
+{
+	// effective gains first, so the integrator is re-initialised for the gains that will run
+	globals.gains = globals.phaseCtrl[phase];
+	PIDController block = globals.gains;
+	effectiveGains(block);
+	globals.pid->switchGains(block);
+	globals.limMin = block.limMin;
+	globals.limMax = block.limMax;
+
+	std::string msg = std::string{ "[TK] flight phase: " } + FlightPhase::name(phase) + "\n";
+	XPLMDebugString(msg.c_str());
+}
+
+/// setpoint and IAS/Mach mode from the autopilot; at a crossover the autopilot is switched instead
+void syncApSpeed(bool crossed)
+{
+	auto& frame = globals.frame;
+	auto& machHold = globals.machHold;
+
+	if (crossed)
+	{
+		// the dial still holds the old unit
+		frame.apDial = machHold.machMode() ? machHold.toMach(frame.apDial) : machHold.toIas(frame.apDial);
+		frame.apIsMach = machHold.machMode() ? 1 : 0;
+		XPLMSetDatai(globals.apIsMachRef, frame.apIsMach);
+		XPLMSetDataf(globals.apSpeedRef, frame.apDial);
+	} else
+		machHold.setMode(globals.machHoldOn && frame.apIsMach != 0);
+
+	if (frame.apIsMach)
+	{
+		if (machHold.machMode())
+			globals.holdMach = frame.apDial;
+		else
+			globals.holdSpeed = machHold.toIas(frame.apDial); // Mach on the dial without Mach hold
+	} else
+		globals.holdSpeed = frame.apDial;
+}
+
+/// shaper limits from the ini (knots) in the unit of the current speed mode; on load, engaging and a mode switch
+void configureShaper()
+{
+	float unit = globals.machHold.machMode() ? 1.0f / globals.machHold.ratio() : 1.0f;
+	globals.shaper.configure(globals.shapeAccel * unit, globals.shapeJerk * unit);
+}
+
+/// the controller changes between knots and Mach; gains are rescaled every tick, state and setpoint here
+void switchSpeedMode()
+{
+	// the filtered ratio lags in a climb, converting with it would kick the derivative
+	auto& machHold = globals.machHold;
+	machHold.snapRatio(globals.frame.ias, globals.frame.mach);
+	machHold.convertState(globals.pid->data(), machHold.machMode() ? globals.frame.mach : globals.frame.ias);
+	if (!globals.apSpeedSync)
+	{
+		if (machHold.machMode())
+			globals.holdMach = machHold.toMach(globals.holdSpeed);
+		else
+			globals.holdSpeed = machHold.toIas(globals.holdMach);
+	}
+	globals.shaper.scale(machHold.machMode() ? 1.0f / machHold.ratio() : machHold.ratio());
+	configureShaper();
+	globals.pid->holdSetpoint(globals.shaper.enabled() ? globals.shaper.value() : (machHold.machMode() ? globals.holdMach : globals.holdSpeed));
+
+	std::ostringstream ss;
+	ss << "[TK] speed hold: " << (machHold.machMode() ? "Mach" : "IAS") << " at " << machHold.ratio() << " kts per Mach" << std::endl;
+	XPLMDebugString(ss.str().c_str());
+}
 
+void enableAutoThrottle()
+{
+	// NEW: start new log when auto throttle enabled
 	auto& ctrl = globals.pid->data();
+	FlightLogHeader header{ globals.plane, ctrl.Kp, ctrl.Ki, ctrl.Kd, ctrl.tau,
+		ctrl.limMin, ctrl.limMax, ctrl.limMinInt, ctrl.limMaxInt, globals.holdSpeed, globals.pidT };
+	auto format = globals.logBinary ? FlightLogFormat::Binary : FlightLogFormat::Csv;
+	std::string ext = globals.logBinary ? ".atlog" : ".csv";
 
-	globals.log << "Airframe: " << globals.plane << std::endl;
-	globals.log << "Kp: " << ctrl.Kp << std::endl;
-	globals.log << "Ki: " << ctrl.Ki << std::endl;
-	globals.log << "Kd: " << ctrl.Kd << std::endl;
-	globals.log << "tau: " << ctrl.tau << std::endl;
-	globals.log << "limMin: " << ctrl.limMin << std::endl;
-	globals.log << "limMax: " << ctrl.limMax << std::endl;
-	globals.log << "intLimMin: " << ctrl.limMinInt << std::endl;
-	globals.log << "intLimMax: " << ctrl.limMaxInt << std::endl;
-	globals.log << "holdSpeed: " << globals.holdSpeed << std::endl;
-	globals.log << "T: " << globals.pidT << std::endl;
+	// the writer thread finishes the previous log before switching files
+	globals.log.open(globals.pluginPath + PathSeparator + globals.plane + "_log" + std::to_string(globals.logCnt) + ext, header, format);
+	++globals.logCnt;
 
 	globals.autoThrEnabled = true;
 }
 
 void disableAutoThrottle()
 {
-	if (globals.log.is_open())
+	if (globals.log.isOpen())
 	{
-		globals.log.flush();
 		globals.log.close();
+		if (globals.log.dropped() > 0)
+		{
+			std::ostringstream ss;
+			ss << "[TK] flight log dropped " << globals.log.dropped() << " samples" << std::endl;
+			XPLMDebugString(ss.str().c_str());
+		}
 	}
 
+	if (globals.tuner.running())
+	{
+		globals.tuner.cancel();
+		XPLMDebugString("[TK] auto tune cancelled\n");
+	}
 	globals.autoThrEnabled = false;
 }
 
+/// relay around the current lever at the hold speed; selecting it again while running cancels
+void startAutoTune()
+{
+	if (globals.tuner.running())
+	{
+		globals.tuner.cancel();
+		XPLMDebugString("[TK] auto tune cancelled\n");
+		return;
+	}
+
+	// a scheduled gain is overwritten from the table every tick, a tuned one would never run
+	if (globals.schedule.enabled())
+	{
+		XPLMDebugString("[TK] auto tune not started: the gain schedule sets the gains, remove sched_kp/ki/kd to tune\n");
+		return;
+	}
+
+	// relay in knots, the gains are tuned in knots
+	float setpoint = globals.machHold.machMode() ? globals.machHold.toIas(globals.holdMach) : globals.holdSpeed;
+	float lever = globals.autoThrEnabled ? globals.pid->data().out : XPLMGetDataf(globals.throttleRef);
+	if (!globals.tuner.start(setpoint, lever, globals.limMin, globals.limMax, globals.tuneSettings))
+	{
+		std::string msg = std::string{ "[TK] auto tune not started: " } + globals.tuner.error() + "\n";
+		XPLMDebugString(msg.c_str());
+		return;
+	}
+	if (!globals.autoThrEnabled)
+		enableAutoThrottle();
+
+	std::ostringstream ss;
+	ss << "[TK] auto tune (" << RelayTuner::name(globals.tuneRule) << ") at " << setpoint << " kts" << std::endl;
+	XPLMDebugString(ss.str().c_str());
+}
+
+/// the relay finished: new gains into the controller and the aircraft's ini
+void finishAutoTune()
+{
+	auto& tuner = globals.tuner;
+	if (RelayTuner::Done != tuner.status())
+	{
+		std::string msg = std::string{ "[TK] auto tune failed: " } + tuner.error() + "\n";
+		XPLMDebugString(msg.c_str());
+		return;
+	}
+
+	// the block in use takes them; with phases that is the current phase's, which keeps them over phase switches until a reload
+	PIDController tuned = globals.gains;
+	RelayTuner::gains(globals.tuneRule, tuner.ultimateGain(), tuner.ultimatePeriod(), tuned);
+	globals.gains.Kp = tuned.Kp;
+	globals.gains.Ki = tuned.Ki;
+	globals.gains.Kd = tuned.Kd;
+	if (globals.phasesOn)
+	{
+		auto& phaseBlock = globals.phaseCtrl[globals.phase.phase()];
+		phaseBlock.Kp = tuned.Kp;
+		phaseBlock.Ki = tuned.Ki;
+		phaseBlock.Kd = tuned.Kd;
+	}
+	PIDController block = globals.gains;
+	effectiveGains(block);
+	globals.pid->switchGains(block);
+
+	std::string fileName = globals.plane + ".ini";
+	bool written = writeTunedGains(fileName, RelayTuner::name(globals.tuneRule), tuner.ultimateGain(), tuner.ultimatePeriod(), tuned);
+
+	std::ostringstream ss;
+	ss << "[TK] auto tune: Ku " << tuner.ultimateGain() << ", Tu " << tuner.ultimatePeriod() << " s -> kp " << tuned.Kp
+		<< ", ki " << tuned.Ki << ", kd " << tuned.Kd << (written ? ", written to " : ", failed to write ") << fileName << std::endl;
+	XPLMDebugString(ss.str().c_str());
+}
+
+/// kp, ki and kd in the ini replaced in place, with a comment block on the tuning above them
+bool writeTunedGains(const std::string& fileName, const std::string& rule, float Ku, float Tu, const PIDController& gains)
+{
+	std::string path = globals.pluginPath + PathSeparator + fileName;
+	std::vector<std::string> lines;
+	{
+		std::ifstream in{ path };
+		if (!in.is_open())
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+			lines.push_back(line);
+	}
+
+	auto number = [](float v) {
+		std::ostringstream ss;
+		ss << std::setprecision(10) << v;
+		return ss.str();
+	};
+	const char* keys[3] = { "kp", "ki", "kd" };
+	float values[3] = { gains.Kp, gains.Ki, gains.Kd };
+
+	// the previous run's block is replaced, not stacked up
+	const std::string frame = "######################";
+	for (size_t i = 0; i + 3 < lines.size(); )
+	{
+		if (lines[i] != frame || lines[i + 1].compare(0, 12, "# auto tune,") != 0
+			|| lines[i + 2].compare(0, 6, "# Ku: ") != 0 || lines[i + 3] != frame)
+		{
+			++i;
+			continue;
+		}
+		size_t end = i + 4 < lines.size() && lines[i + 4].empty() ? i + 5 : i + 4;
+		lines.erase(lines.begin() + i, lines.begin() + end);
+	}
+
+	// the block goes above the first gain, or above the appended ones
+	bool found[3] = {};
+	size_t first = lines.size();
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		auto& line = lines[i];
+		for (int k = 0; k < 3; ++k)
+		{
+			if (line.compare(0, 3, std::string{ keys[k] } + "=") != 0)
+				continue;
+			line = std::string{ keys[k] } + "=" + number(values[k]);
+			found[k] = true;
+			first = i < first ? i : first;
+		}
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		if (!found[k])
+			lines.push_back(std::string{ keys[k] } + "=" + number(values[k]));
+	}
+
+	std::vector<std::string> block = {
+		frame,
+		"# auto tune, " + rule,
+		"# Ku: " + number(Ku) + ", Tu: " + number(Tu) + " s",
+		frame,
+		""
+	};
+	lines.insert(lines.begin() + first, block.begin(), block.end());
+
+	std::ofstream out{ path, std::ios::trunc };
+	if (!out.is_open())
+		return false;
+	for (size_t i = 0; i < lines.size(); ++i)
+		out << lines[i] << (i + 1 < lines.size() ? "\n" : "");
+	return out.good();
+}
+
 void AutoThrottleMenuHandler(void* menuRef, void* itemRef)
 {
 	if (nullptr == itemRef)
@@ -362,6 +1332,10 @@ void AutoThrottleMenuHandler(void* menuRef, void* itemRef)
 	{
 		disableAutoThrottle();
 
+	} else if ("tune" == str)
+	{
+		startAutoTune();
+
 	} else if ("reload" == str)
 	{
 		globals.autoThrEnabled = false;
@@ -369,6 +1343,14 @@ void AutoThrottleMenuHandler(void* menuRef, void* itemRef)
 		PIDController ctrl{ 0 };
 		loadControllerConfig(globals.plane + ".ini", ctrl);
 		globals.pid->updateConfig(ctrl);
+		globals.pid->setTimeTolerance(globals.pidTimeTolerance);
+		globals.pid->setTrackingGain(globals.envelopeTracking);
+		globals.pid->setSetpointWeights(globals.weightP, globals.weightD);
+		globals.pid->setFeedForward(0);
+		// the load put back the plain gains and limits, the phase's block takes over again
+		if (globals.phasesOn)
+			applyFlightPhase(globals.phase.phase());
+		setupInputs();
 	} else if ("config" == str)
 	{
 		if (globals.controllerWnd == nullptr)
@@ -392,28 +1374,110 @@ float getAutoSpeed(void* ref)
 	return globals.holdSpeed;
 }
 
-void setAutoSpeed(void* ref, float val)
+int getLogDropped(void* ref)
 {
-	if (nullptr == ref)
-		return;
+	return static_cast<int>(globals.log.dropped());
+}
+
+float getEnvelopeLimit(void* ref)
+{
+	return globals.envelope.limit();
+}
+
+int getFlightPhase(void* ref)
+{
+	// FlightPhase::Phase, -1 while phases are disabled
+	return globals.phasesOn ? static_cast<int>(globals.phase.phase()) : -1;
+}
+
+int getMpcFallbacks(void* ref)
+{
+	return globals.mpcFallbacks;
+}
+
+float getPlantEstimate(void* ref)
+{
+	// ref: 0 gain, 1 damping, 2 standard deviation of the gain; 0 while the estimator is off
+	if (!globals.estimatorOn)
+		return 0;
+	switch (reinterpret_cast<intptr_t>(ref))
+	{
+		case 0:
+			return globals.estimator.estimate(PlantEstimator::Gain);
+		case 1:
+			return globals.estimator.estimate(PlantEstimator::Damping);
+		default:
+			return globals.estimator.deviation(PlantEstimator::Gain);
+	}
+}
+
+float getGain(void* ref)
+{
+	// ref: 0 Kp, 1 Ki, 2 Kd as the PID runs them, scheduled, adapted and in the speed unit held; 0 before a config is loaded
+	if (!globals.pid)
+		return 0;
+	auto& data = globals.pid->data();
+	switch (reinterpret_cast<intptr_t>(ref))
+	{
+		case 0:
+			return data.Kp;
+		case 1:
+			return data.Ki;
+		default:
+			return data.Kd;
+	}
+}
+
+float getFeedForward(void* ref)
+{
+	// lever the trim table adds to the PID's terms, 0 without a table
+	return globals.pid ? globals.pid->feedForwardValue() : 0.0f;
+}
+
+float getHoldMach(void* ref)
+{
+	return globals.holdMach;
+}
 
+void setHoldMach(void* ref, float val)
+{
+	globals.holdMach = val;
+}
+
+int getMachMode(void* ref)
+{
+	return globals.machHold.machMode() ? 1 : 0;
+}
+
+void setAutoSpeed(void* ref, float val)
+{
 	globals.holdSpeed = val;
 }
 
+/// one step of the hold speed commands: 1 kt, or 0.01 in Mach hold
+void stepHoldSpeed(int direction)
+{
+	if (globals.machHold.machMode())
+	{
+		float mach = globals.holdMach + 0.01f * direction;
+		if (mach >= 0.4f && mach <= 0.95f)
+			globals.holdMach = mach;
+	} else if (direction > 0 ? globals.holdSpeed <= 320 : globals.holdSpeed >= 120)
+		globals.holdSpeed += direction;
+}
+
 int holdSpeedUpHandler(XPLMCommandRef cmd, XPLMCommandPhase phase, void* ref)
 {
 	static float startTime = 0;
 
 	if (phase == xplm_CommandBegin)
 	{
-		if (globals.holdSpeed <= 320)
-			globals.holdSpeed++;
+		stepHoldSpeed(1);
 
 		startTime = XPLMGetElapsedTime();
 	} else if (phase == xplm_CommandContinue && XPLMGetElapsedTime() - startTime > 0.5)
 	{
-		if (globals.holdSpeed <= 320)
-			globals.holdSpeed++;
+		stepHoldSpeed(1);
 	}
 	return 0;
 }
@@ -424,14 +1488,12 @@ int holdSpeedDownHandler(XPLMCommandRef cmd, XPLMCommandPhase phase, void* ref)
 
 	if (phase == xplm_CommandBegin)
 	{
-		if (globals.holdSpeed >= 120)
-			globals.holdSpeed--;
+		stepHoldSpeed(-1);
 
 		startTime = XPLMGetElapsedTime();
 	} else if (phase == xplm_CommandContinue && XPLMGetElapsedTime() - startTime > 0.5)
 	{
-		if (globals.holdSpeed >= 120)
-			globals.holdSpeed--;
+		stepHoldSpeed(-1);
 	}
 	return 0;
 }
@@ -488,6 +1550,12 @@ void wndDrawFn(XPLMWindowID wndId, void* ref)
 	XPLMGetFontDimensions(xplmFont_Proportional, nullptr, &textHeight, nullptr);
 
 	std::string s = std::to_string(static_cast<int>(globals.holdSpeed));
+	if (globals.machHold.machMode())
+	{
+		char mach[16];
+		snprintf(mach, sizeof(mach), "M%.2f", globals.holdMach);
+		s = mach;
+	}
 	int lblWidth = XPLMMeasureString(xplmFont_Proportional, lblText, strlen(lblText));
 	int valPos = l + 5 + lblWidth + 5;
 	XPLMDrawString(color, l + 5, b + ((h / 2) - (textHeight / 2)), const_cast<char*>(lblText), nullptr, xplmFont_Proportional);
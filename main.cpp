@@ -8,23 +8,15 @@
 #include <map>
 
 #include "PID.h"
+#include "PlantModel.h"
 
 #define SAMPLE_TIME_S 0.01f
 
 /* Maximum run-time of simulation */
 #define SIMULATION_TIME_MAX 3.0f
 
-
-float TestSystem_Update(float inp)
-{
-
-	static float output = 0.0f;
-	static const float alpha = 0.02f;
-
-	output = (SAMPLE_TIME_S * inp + output) / (1.0f + alpha * SAMPLE_TIME_S);
-
-	return output;
-}
+/* Simulated dynamical system: y' = u - alpha * y */
+#define TEST_SYSTEM_ALPHA 0.02f
 
 void loadControllerConfig(PIDController& ctrl)
 {
@@ -71,6 +63,7 @@ int main()
 	loadControllerConfig(pc);
 
 	PID pid{ pc };
+	FirstOrderPlant testSystem{ 1.0f / TEST_SYSTEM_ALPHA, 1.0f / TEST_SYSTEM_ALPHA };
 
 	/* Simulate response using test system */
 	float setpoint = 252.0f;
@@ -81,7 +74,7 @@ int main()
 	for (float t = 0.0f; t <= SIMULATION_TIME_MAX; t += SAMPLE_TIME_S)
 	{
 		/* Get measurement from system */
-		float measurement = /*250 + (i * SAMPLE_TIME_S)*/TestSystem_Update(250.0f + i);
+		float measurement = /*250 + (i * SAMPLE_TIME_S)*/testSystem.step(250.0f + i, SAMPLE_TIME_S);
 
 		/* Compute new control signal */
 		out = pid.update(setpoint, measurement);